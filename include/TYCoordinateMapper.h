@@ -27,6 +27,14 @@ typedef struct TY_PIXEL_COLOR_DESC
 	uint8_t rsvd;
 }TY_PIXEL_COLOR_DESC;
 
+typedef struct TY_IMAGE_ROI
+{
+  uint32_t x;     // left column
+  uint32_t y;     // top row
+  uint32_t w;     // width in pixels
+  uint32_t h;     // height in pixels
+}TY_IMAGE_ROI;
+
 // ------------------------------
 //  base convertion
 // ------------------------------
@@ -204,6 +212,7 @@ static inline TY_STATUS TYMapRGBPixelsToDepthCoordinate(
 /// @param  [in]  inRgb                 Current RGB image.
 /// @param  [out] mappedRgb             Output RGB image.
 /// @retval TY_STATUS_OK        Succeed.
+/// @retval TY_STATUS_NO_BUFFER Out of memory.
 static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -223,6 +232,7 @@ static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
 /// @param  [in]  inRgb                 Current RGB48 image.
 /// @param  [out] mappedRgb             Output RGB48 image.
 /// @retval TY_STATUS_OK        Succeed.
+/// @retval TY_STATUS_NO_BUFFER Out of memory.
 static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -242,6 +252,7 @@ static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
 /// @param  [in]  gray                  Current MONO16 image.
 /// @param  [out] mappedGray            Output MONO16 image.
 /// @retval TY_STATUS_OK        Succeed.
+/// @retval TY_STATUS_NO_BUFFER Out of memory.
 static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -262,6 +273,7 @@ static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
 /// @param  [in]  inMono                Current MONO8 image.
 /// @param  [out] mappedMono            Output MONO8 image.
 /// @retval TY_STATUS_OK        Succeed.
+/// @retval TY_STATUS_NO_BUFFER Out of memory.
 static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -420,41 +432,158 @@ inline void TYPixelsOverlapRemove(TY_PIXEL_DESC* lut, uint32_t count, uint32_t i
   free(mappedDepth);
 }
 
-static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
+/// @brief Bilinear entry of an image to depth registration scale table.
+typedef struct TY_MAP_BILINEAR_ENTRY
+{
+  uint16_t i0;    // first source index
+  uint16_t i1;    // second source index
+  uint16_t w;     // weight of i1, 0..256
+  uint16_t rsvd;
+}TY_MAP_BILINEAR_ENTRY;
+
+/// @brief Create nearest scale table from lookup table coordinate to source image coordinate.
+/// @param  [in]  lutN                  Lookup table width (or height).
+/// @param  [in]  srcN                  Source image width (or height).
+/// @param  [out] table                 Output table, lutN entries.
+static inline void TYCreateMapScaleTable(uint32_t lutN, uint32_t srcN, uint16_t* table)
+{
+  for(uint32_t i = 0; i < lutN; i++) {
+    uint16_t s = (uint16_t)(1.f * i * srcN / lutN + 0.5);
+    table[i] = s >= srcN ? srcN - 1 : s;
+  }
+}
+
+/// @brief Create bilinear scale table from lookup table coordinate to source image coordinate.
+/// @param  [in]  lutN                  Lookup table width (or height).
+/// @param  [in]  srcN                  Source image width (or height).
+/// @param  [out] table                 Output table, lutN entries.
+static inline void TYCreateMapBilinearTable(uint32_t lutN, uint32_t srcN, TY_MAP_BILINEAR_ENTRY* table)
+{
+  for(uint32_t i = 0; i < lutN; i++) {
+    float f = 1.f * i * srcN / lutN;
+    uint32_t i0 = (uint32_t)f;
+    if(i0 >= srcN - 1) {
+      table[i].i0 = table[i].i1 = srcN - 1;
+      table[i].w = 0;
+    } else {
+      table[i].i0 = i0;
+      table[i].i1 = i0 + 1;
+      table[i].w = (uint16_t)((f - i0) * 256 + 0.5f);
+    }
+    table[i].rsvd = 0;
+  }
+}
+
+/// @brief Sample rows [rowBegin, rowEnd) of an image to depth coordinate, nearest.
+///        Rows are independent, callers may split them across threads.
+/// @param  [in]  lut                   Lookup table at depth resolution, overlap removed.
+/// @param  [in]  lutW                  Width of lookup table and output, depthW unless
+///                                     the table covers a region of the depth image.
+/// @param  [in]  depthW                Width of depth image.
+/// @param  [in]  depthH                Height of depth image.
+/// @param  [in]  in                    Source image, CN channels of T.
+/// @param  [in]  inW                   Width of source image.
+/// @param  [in]  tabX                  Scale table from TYCreateMapScaleTable(depthW, inW).
+/// @param  [in]  tabY                  Scale table from TYCreateMapScaleTable(depthH, inH).
+/// @param  [out] out                   Output image, lutW columns.
+/// @param  [in]  rowBegin              First row.
+/// @param  [in]  rowEnd                Last row + 1.
+template <typename T, int CN>
+static inline void TYMapImageToDepthCoordinateRows(
+                  const TY_PIXEL_DESC* lut, uint32_t lutW, uint32_t depthW, uint32_t depthH,
+                  const T* in, uint32_t inW,
+                  const uint16_t* tabX, const uint16_t* tabY,
+                  T* out, uint32_t rowBegin, uint32_t rowEnd)
+{
+  for(uint32_t depthr = rowBegin; depthr < rowEnd; depthr++) {
+    const TY_PIXEL_DESC* plut = &lut[(size_t)depthr * lutW];
+    T* outPtr = &out[(size_t)lutW * depthr * CN];
+    for(uint32_t depthc = 0; depthc < lutW; depthc++, plut++, outPtr += CN) {
+      if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH) {
+        for(int c = 0; c < CN; c++) outPtr[c] = 0;
+      } else {
+        const T* inPtr = &in[((size_t)inW * tabY[plut->y] + tabX[plut->x]) * CN];
+        for(int c = 0; c < CN; c++) outPtr[c] = inPtr[c];
+      }
+    }
+  }
+}
+
+/// @brief Sample rows [rowBegin, rowEnd) of an image to depth coordinate, bilinear.
+///        Same as TYMapImageToDepthCoordinateRows with TY_MAP_BILINEAR_ENTRY tables
+///        from TYCreateMapBilinearTable, T must be uint8_t or uint16_t.
+template <typename T, int CN>
+static inline void TYMapImageToDepthCoordinateRowsBilinear(
+                  const TY_PIXEL_DESC* lut, uint32_t lutW, uint32_t depthW, uint32_t depthH,
+                  const T* in, uint32_t inW,
+                  const TY_MAP_BILINEAR_ENTRY* tabX, const TY_MAP_BILINEAR_ENTRY* tabY,
+                  T* out, uint32_t rowBegin, uint32_t rowEnd)
+{
+  for(uint32_t depthr = rowBegin; depthr < rowEnd; depthr++) {
+    const TY_PIXEL_DESC* plut = &lut[(size_t)depthr * lutW];
+    T* outPtr = &out[(size_t)lutW * depthr * CN];
+    for(uint32_t depthc = 0; depthc < lutW; depthc++, plut++, outPtr += CN) {
+      if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH) {
+        for(int c = 0; c < CN; c++) outPtr[c] = 0;
+      } else {
+        const TY_MAP_BILINEAR_ENTRY& ex = tabX[plut->x];
+        const TY_MAP_BILINEAR_ENTRY& ey = tabY[plut->y];
+        const T* r0 = &in[(size_t)inW * ey.i0 * CN];
+        const T* r1 = &in[(size_t)inW * ey.i1 * CN];
+        const uint32_t wx = ex.w, wy = ey.w;
+        for(int c = 0; c < CN; c++) {
+          uint32_t top = r0[ex.i0 * CN + c] * (256 - wx) + r0[ex.i1 * CN + c] * wx;
+          uint32_t bot = r1[ex.i0 * CN + c] * (256 - wx) + r1[ex.i1 * CN + c] * wx;
+          outPtr[c] = (T)((top * (256 - wy) + bot * wy + (1 << 15)) >> 16);
+        }
+      }
+    }
+  }
+}
+
+/// @brief Map an image of CN channels of T to depth coordinate, nearest sampling.
+///        Common implementation of TYMapRGBImageToDepthCoordinate and friends.
+template <typename T, int CN>
+static inline TY_STATUS TYMapImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
                   const TY_CAMERA_CALIB_INFO* color_calib,
-                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
-                  uint8_t* mappedRgb, float f_scale_unit)
+                  uint32_t inW, uint32_t inH, const T* in,
+                  T* mapped, float f_scale_unit)
 {
   TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
+  if(!lut) {
+    return TY_STATUS_NO_BUFFER;
+  }
   TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
                     depth_calib, depthW, depthH, depth,
                     color_calib, depthW, depthH, lut, f_scale_unit), lut);
   TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
 
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint8_t* outPtr = &mappedRgb[depthW * depthr * 3 + depthc * 3];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = outPtr[1] = outPtr[2] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint8_t* inPtr = &inRgb[rgbW * scale_y * 3 + scale_x * 3];
-      outPtr[0] = inPtr[0];
-      outPtr[1] = inPtr[1];
-      outPtr[2] = inPtr[2];
-    }
+  uint16_t* tab = (uint16_t*)malloc(sizeof(uint16_t) * (depthW + depthH));
+  if(!tab) {
+    free(lut);
+    return TY_STATUS_NO_BUFFER;
   }
+  TYCreateMapScaleTable(depthW, inW, tab);
+  TYCreateMapScaleTable(depthH, inH, tab + depthW);
+  TYMapImageToDepthCoordinateRows<T, CN>(lut, depthW, depthW, depthH, in, inW, tab, tab + depthW, mapped, 0, depthH);
+  free(tab);
   free(lut);
   return TY_STATUS_OK;
 }
 
+static inline TY_STATUS TYMapRGBImageToDepthCoordinate(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t rgbW, uint32_t rgbH, const uint8_t* inRgb,
+                  uint8_t* mappedRgb, float f_scale_unit)
+{
+  return TYMapImageToDepthCoordinate<uint8_t, 3>(depth_calib, depthW, depthH, depth,
+                    color_calib, rgbW, rgbH, inRgb, mappedRgb, f_scale_unit);
+}
+
 static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
                   const TY_CAMERA_CALIB_INFO* depth_calib,
                   uint32_t depthW, uint32_t depthH, const uint16_t* depth,
@@ -462,32 +591,8 @@ static inline TY_STATUS TYMapRGB48ImageToDepthCoordinate(
                   uint32_t rgbW, uint32_t rgbH, const uint16_t* inRgb,
                   uint16_t* mappedRgb, float f_scale_unit)
 {
-  TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
-  TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
-                    depth_calib, depthW, depthH, depth,
-                    color_calib, depthW, depthH, lut, f_scale_unit), lut);
-  TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
-
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint16_t* outPtr = &mappedRgb[depthW * depthr * 3 + depthc * 3];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = outPtr[1] = outPtr[2] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint16_t* inPtr = &inRgb[rgbW * scale_y * 3 + scale_x * 3];
-      outPtr[0] = inPtr[0];
-      outPtr[1] = inPtr[1];
-      outPtr[2] = inPtr[2];
-    }
-  }
-  free(lut);
-  return TY_STATUS_OK;
+  return TYMapImageToDepthCoordinate<uint16_t, 3>(depth_calib, depthW, depthH, depth,
+                    color_calib, rgbW, rgbH, inRgb, mappedRgb, f_scale_unit);
 }
 
 static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
@@ -497,30 +602,8 @@ static inline TY_STATUS TYMapMono16ImageToDepthCoordinate(
                   uint32_t rgbW, uint32_t rgbH, const uint16_t* gray,
                   uint16_t* mappedGray, float f_scale_unit)
 {
-  TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
-  TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
-                    depth_calib, depthW, depthH, depth,
-                    color_calib, depthW, depthH, lut, f_scale_unit), lut);
-  TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
-
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint16_t* outPtr = &mappedGray[depthW * depthr + depthc];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * rgbW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * rgbH / depthH + 0.5);
-      if(scale_x >= rgbW) scale_x = rgbW - 1;
-      if(scale_y >= rgbH) scale_y = rgbH - 1;
-      const uint16_t* inPtr = &gray[rgbW * scale_y + scale_x];
-      outPtr[0] = inPtr[0];
-    }
-  }
-  free(lut);
-  return TY_STATUS_OK;
+  return TYMapImageToDepthCoordinate<uint16_t, 1>(depth_calib, depthW, depthH, depth,
+                    color_calib, rgbW, rgbH, gray, mappedGray, f_scale_unit);
 }
 
 static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
@@ -530,29 +613,119 @@ static inline TY_STATUS TYMapMono8ImageToDepthCoordinate(
                   uint32_t monoW, uint32_t monoH, const uint8_t* inMono,
                   uint8_t* mappedMono, float f_scale_unit)
 {
-  TY_PIXEL_DESC* lut = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * depthW * depthH);
-  TYMAP_CHECKRET(TYCreateDepthToColorCoordinateLookupTable(
-                    depth_calib, depthW, depthH, depth,
-                    color_calib, depthW, depthH, lut, f_scale_unit), lut);
-  TYPixelsOverlapRemove(lut, depthW * depthH, depthW, depthH);
+  return TYMapImageToDepthCoordinate<uint8_t, 1>(depth_calib, depthW, depthH, depth,
+                    color_calib, monoW, monoH, inMono, mappedMono, f_scale_unit);
+}
 
-  for(uint32_t depthr = 0; depthr < depthH; depthr++)
-  for(uint32_t depthc = 0; depthc < depthW; depthc++)
-  {
-    TY_PIXEL_DESC* plut = &lut[depthr * depthW + depthc];
-    uint8_t* outPtr = &mappedMono[depthW * depthr + depthc];
-    if(plut->x < 0 || plut->x >= (int)depthW || plut->y < 0 || plut->y >= (int)depthH){
-      outPtr[0] = 0;
-    } else {
-      uint16_t scale_x =  (uint16_t)(1.f * plut->x * monoW / depthW + 0.5);
-      uint16_t scale_y =  (uint16_t)(1.f * plut->y * monoH / depthH + 0.5);
-      if(scale_x >= monoW) scale_x = monoW - 1;
-      if(scale_y >= monoH) scale_y = monoH - 1;
-      const uint8_t* inPtr = &inMono[monoW * scale_y + scale_x];
-      outPtr[0] = inPtr[0];
+
+/// @brief Whether a region is non empty and inside a w x h image, without uint32 overflow.
+static inline bool TYImageROIInside(const TY_IMAGE_ROI* roi, uint32_t w, uint32_t h)
+{
+  return roi->w && roi->h && roi->x < w && roi->y < h && roi->w <= w - roi->x && roi->h <= h - roi->y;
+}
+
+/// @brief Map a region of depth image to 3D points. 0 depth pixels maps to (NAN, NAN, NAN).
+///        Only pixels inside the region are unprojected.
+/// @param  [in]  src_calib             Depth image's calibration data.
+/// @param  [in]  depthW                Width of depth image.
+/// @param  [in]  depthH                Height of depth image.
+/// @param  [in]  depth                 Depth image, depthW x depthH.
+/// @param  [in]  roi                   Region of depth image.
+/// @param  [out] point3d               Output point3D image, roi->w x roi->h.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_INVALID_PARAMETER Region outside of depth image.
+/// @retval TY_STATUS_NO_BUFFER         Out of memory.
+static inline TY_STATUS TYMapDepthImageToPoint3dROI(
+                  const TY_CAMERA_CALIB_INFO* src_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_IMAGE_ROI* roi, TY_VECT_3F* point3d,
+                  float f_scale_unit = 1.0f)
+{
+  if(!TYImageROIInside(roi, depthW, depthH)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  TY_PIXEL_DESC* pixels = (TY_PIXEL_DESC*)malloc(sizeof(TY_PIXEL_DESC) * roi->w);
+  if(!pixels) {
+    return TY_STATUS_NO_BUFFER;
+  }
+  for(uint32_t r = 0; r < roi->h; r++) {
+    const uint16_t* src = &depth[(size_t)(roi->y + r) * depthW + roi->x];
+    for(uint32_t c = 0; c < roi->w; c++) {
+      pixels[c].x = (int16_t)(roi->x + c);
+      pixels[c].y = (int16_t)(roi->y + r);
+      pixels[c].depth = src[c];
+      pixels[c].rsvd = 0;
     }
+    TYMAP_CHECKRET(TYMapDepthToPoint3d(src_calib, depthW, depthH, pixels, roi->w,
+                      &point3d[(size_t)r * roi->w], f_scale_unit), pixels);
   }
-  free(lut);
+  free(pixels);
+  return TY_STATUS_OK;
+}
+
+/// @brief Calibration of a region of an image, as if the region were the whole image.
+///        Intrinsic is moved to imageW x imageH resolution and shifted by the region origin.
+/// @param  [in]  calib                 Calibration data.
+/// @param  [in]  imageW                Width of image.
+/// @param  [in]  imageH                Height of image.
+/// @param  [in]  roi                   Region of image.
+/// @param  [out] roiCalib              Calibration data of the region.
+static inline void TYCalibrationROI(const TY_CAMERA_CALIB_INFO* calib,
+                  uint32_t imageW, uint32_t imageH, const TY_IMAGE_ROI* roi,
+                  TY_CAMERA_CALIB_INFO* roiCalib)
+{
+  *roiCalib = *calib;
+  const float sx = 1.f * imageW / calib->intrinsicWidth;
+  const float sy = 1.f * imageH / calib->intrinsicHeight;
+  roiCalib->intrinsic.data[0] = calib->intrinsic.data[0] * sx;
+  roiCalib->intrinsic.data[2] = calib->intrinsic.data[2] * sx - roi->x;
+  roiCalib->intrinsic.data[4] = calib->intrinsic.data[4] * sy;
+  roiCalib->intrinsic.data[5] = calib->intrinsic.data[5] * sy - roi->y;
+  roiCalib->intrinsicWidth = roi->w;
+  roiCalib->intrinsicHeight = roi->h;
+}
+
+/// @brief Map a region of depth image to a region of color coordinate depth image.
+///        Only depth pixels inside depthRoi are mapped, output is sized to colorRoi.
+/// @param  [in]  depth_calib           Depth image's calibration data.
+/// @param  [in]  depthW                Width of current depth image.
+/// @param  [in]  depthH                Height of current depth image.
+/// @param  [in]  depth                 Depth image, depthW x depthH.
+/// @param  [in]  depthRoi              Region of depth image to map.
+/// @param  [in]  color_calib           Color image's calibration data.
+/// @param  [in]  mappedW               Width of target depth image.
+/// @param  [in]  mappedH               Height of target depth image.
+/// @param  [in]  colorRoi              Region of target depth image to output.
+/// @param  [out] mappedDepth           Output pixels, colorRoi->w x colorRoi->h.
+/// @retval TY_STATUS_OK                Succeed.
+/// @retval TY_STATUS_INVALID_PARAMETER Region outside of image.
+/// @retval TY_STATUS_NO_BUFFER         Out of memory.
+static inline TY_STATUS TYMapDepthImageToColorCoordinateROI(
+                  const TY_CAMERA_CALIB_INFO* depth_calib,
+                  uint32_t depthW, uint32_t depthH, const uint16_t* depth,
+                  const TY_IMAGE_ROI* depthRoi,
+                  const TY_CAMERA_CALIB_INFO* color_calib,
+                  uint32_t mappedW, uint32_t mappedH,
+                  const TY_IMAGE_ROI* colorRoi, uint16_t* mappedDepth,
+                  float f_scale_unit = 1.0f)
+{
+  if(!TYImageROIInside(depthRoi, depthW, depthH) || !TYImageROIInside(colorRoi, mappedW, mappedH)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  const uint32_t count = depthRoi->w * depthRoi->h;
+  TY_VECT_3F* p3d = (TY_VECT_3F*)malloc(sizeof(TY_VECT_3F) * count);
+  if(!p3d) {
+    return TY_STATUS_NO_BUFFER;
+  }
+  TYMAP_CHECKRET(TYMapDepthImageToPoint3dROI(depth_calib, depthW, depthH, depth, depthRoi, p3d, f_scale_unit), p3d);
+  TY_CAMERA_EXTRINSIC extri_inv;
+  TYMAP_CHECKRET(TYInvertExtrinsic(&color_calib->extrinsic, &extri_inv), p3d);
+  TYMAP_CHECKRET(TYMapPoint3dToPoint3d(&extri_inv, p3d, count, p3d), p3d);
+  TY_CAMERA_CALIB_INFO roi_calib;
+  TYCalibrationROI(color_calib, mappedW, mappedH, colorRoi, &roi_calib);
+  TYMAP_CHECKRET(TYMapPoint3dToDepthImage(
+        &roi_calib, p3d, count, colorRoi->w, colorRoi->h, mappedDepth, f_scale_unit), p3d);
+  free(p3d);
   return TY_STATUS_OK;
 }
 
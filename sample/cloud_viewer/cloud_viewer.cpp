@@ -747,28 +747,37 @@ namespace {
 
 
 
-    int GLPointCloudViewer::Update(int point_num, const TY_VECT_3F* points, const uint8_t* color){
+    int GLPointCloudViewer::Update(int point_num, const TY_VECT_3F* points, const uint8_t* color, bool dense){
         if (point_num < 0){
             return -1;
         }
         ScopeLocker lockit(data_lock);
         g_cloud.vertices.clear();
+        if (color){
+            g_cloud.colors.clear();
+        }
+        if (dense){
+            const float *pv = &points[0].x;
+            g_cloud.vertices.assign(pv, pv + point_num * 3);
+            if (color){
+                g_cloud.colors.assign(color, color + point_num * 3);
+            }
+            need_redraw = true;
+            return 0;
+        }
+
         g_cloud.vertices.reserve(point_num * 3);
+        if (color){
+            g_cloud.colors.reserve(point_num * 3);
+        }
         for (int idx = 0; idx < point_num; idx++){
             const TY_VECT_3F &p = points[idx];
             if ((!isnan(p.x)) && (!isnan(p.y)) && (!isnan(p.z))){
                 g_cloud.vertices.push_back(p.x);
                 g_cloud.vertices.push_back(p.y);
                 g_cloud.vertices.push_back(p.z);
-            }
-        }
-        if (color){
-            g_cloud.colors.clear();
-            g_cloud.colors.reserve(point_num * 3);
-            for (int idx = 0; idx < point_num; idx++){
-                const TY_VECT_3F &p = points[idx];
-                const uint8_t *pc = color + idx * 3;
-                if ((!isnan(p.x)) && (!isnan(p.y)) && (!isnan(p.z))){
+                if (color){
+                    const uint8_t *pc = color + idx * 3;
                     g_cloud.colors.push_back(pc[0]);
                     g_cloud.colors.push_back(pc[1]);
                     g_cloud.colors.push_back(pc[2]);
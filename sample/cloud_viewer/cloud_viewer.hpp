@@ -15,7 +15,8 @@ public:
     static int GlInit(const char* name = "CloudViewer", int w = 800, int h = 600);
     static int EnterMainLoop();
     static int LeaveMainLoop();
-    static int Update(int point_num, const TY_VECT_3F* points, const uint8_t* color);
+    /// dense: points (and colors) hold valid points only, no NaN test
+    static int Update(int point_num, const TY_VECT_3F* points, const uint8_t* color, bool dense = false);
     static int ResetViewTranslate();
     static int RegisterKeyCallback(bool(*callback)(int));
     static int Deinit();//destroy all & exit
@@ -0,0 +1,218 @@
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "NormalEstimator.hpp"
+#include "TYThread.hpp"
+
+// image rows per strip, strips are spread over the worker threads
+#define NE_STRIP_ROWS   (32)
+// count, x, y, z, xx, xy, xz, yy, yz, zz
+#define NE_CHANNELS     (10)
+
+struct NormalEstimator::Job
+{
+  const NormalEstimator* self;
+  const TY_VECT_3F* points;
+  uint32_t width;
+  uint32_t height;
+  TY_VECT_3F* normals;
+  float* curvature;
+};
+
+static inline bool validPoint(const TY_VECT_3F& p)
+{
+  return p.x == p.x && p.y == p.y && p.z == p.z;
+}
+
+// Unit eigenvector of the smallest eigenvalue of the symmetric matrix
+// C = (xx, xy, xz, yy, yz, zz).
+static void smallestEigenVector(const double* C, double* n, double* curvature)
+{
+  const double a00 = C[0], a01 = C[1], a02 = C[2], a11 = C[3], a12 = C[4], a22 = C[5];
+  const double trace = a00 + a11 + a22;
+  const double p1 = a01 * a01 + a02 * a02 + a12 * a12;
+  const double q = trace / 3;
+  const double p2 = (a00 - q) * (a00 - q) + (a11 - q) * (a11 - q) + (a22 - q) * (a22 - q) + 2 * p1;
+  double lambda;
+  if(p2 <= 0) {
+    lambda = q;
+  } else {
+    // eigenvalues are q + p t for the roots t of t^3 - 3t = 2r,
+    // r = det(C - qI) / (2 p^3)
+    const double p = sqrt(p2 / 6);
+    const double b00 = a00 - q, b11 = a11 - q, b22 = a22 - q;
+    const double det = b00 * (b11 * b22 - a12 * a12) - a01 * (a01 * b22 - a12 * a02)
+                     + a02 * (a01 * a12 - b11 * a02);
+    const double r = std::max(-1.0, std::min(1.0, det / (2 * p * p * p)));
+    // the smallest root is in [-2, -1], the cubic is increasing and concave
+    // there. Newton from the left closes in without overshoot, the start is
+    // the expansion of the root around r = 1 where it meets the middle one.
+    double t = std::max(-2.0, -1 - sqrt((1 - r) * (2.0 / 3)));
+    for(int k = 0; k < 8; k++) {
+      const double slope = 3 * (t * t - 1);
+      const double step = slope > 0 ? (t * (t * t - 3) - 2 * r) / slope : 0;
+      t -= step;
+      if(step > -1e-12) {
+        break;
+      }
+    }
+    lambda = q + p * t;
+  }
+  *curvature = trace > 0 ? std::max(0.0, lambda) / trace : 0;
+
+  // the eigenvector is normal to the rows of C - lambda I, take the best
+  // conditioned cross product
+  const double r00 = a00 - lambda, r11 = a11 - lambda, r22 = a22 - lambda;
+  const double c01[3] = {a01 * a12 - a02 * r11, a02 * a01 - r00 * a12, r00 * r11 - a01 * a01};
+  const double c02[3] = {a01 * r22 - a02 * a12, a02 * a02 - r00 * r22, r00 * a12 - a01 * a02};
+  const double c12[3] = {r11 * r22 - a12 * a12, a12 * a02 - a01 * r22, a01 * a12 - r11 * a02};
+  const double d01 = c01[0] * c01[0] + c01[1] * c01[1] + c01[2] * c01[2];
+  const double d02 = c02[0] * c02[0] + c02[1] * c02[1] + c02[2] * c02[2];
+  const double d12 = c12[0] * c12[0] + c12[1] * c12[1] + c12[2] * c12[2];
+  const double* c = c01;
+  double d = d01;
+  if(d02 > d) {
+    c = c02;
+    d = d02;
+  }
+  if(d12 > d) {
+    c = c12;
+    d = d12;
+  }
+  if(d > 0) {
+    const double s = 1 / sqrt(d);
+    n[0] = c[0] * s;
+    n[1] = c[1] * s;
+    n[2] = c[2] * s;
+  } else {
+    // isotropic, any direction is as good
+    n[0] = n[1] = 0;
+    n[2] = 1;
+  }
+}
+
+NormalEstimator::NormalEstimator()
+  : _radius(2)
+  , _minNeighbors(3)
+  , _threads(0)
+{
+  _viewPoint.x = _viewPoint.y = _viewPoint.z = 0.f;
+}
+
+void NormalEstimator::setViewPoint(float x, float y, float z)
+{
+  _viewPoint.x = x;
+  _viewPoint.y = y;
+  _viewPoint.z = z;
+}
+
+// Integral images of the strip rows plus the window radius above and below,
+// relative to a point of the strip to keep the sums small.
+void NormalEstimator::strips(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const NormalEstimator& self = *job.self;
+  const int W = (int)job.width, H = (int)job.height, R = self._radius;
+  const size_t stride = (size_t)(W + 1) * NE_CHANNELS;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<double> integral((size_t)(NE_STRIP_ROWS + 2 * R + 1) * stride);
+
+  for(int s = begin; s < end; s++) {
+    const int v0 = s * NE_STRIP_ROWS, v1 = std::min(v0 + NE_STRIP_ROWS, H);
+    const int top = std::max(0, v0 - R), bottom = std::min(H, v1 + R);
+
+    TY_VECT_3F origin = {0.f, 0.f, 0.f};
+    for(size_t i = (size_t)v0 * W; i < (size_t)v1 * W; i++) {
+      if(validPoint(job.points[i])) {
+        origin = job.points[i];
+        break;
+      }
+    }
+
+    std::fill(integral.begin(), integral.begin() + stride, 0.0);
+    for(int v = top; v < bottom; v++) {
+      const TY_VECT_3F* row = job.points + (size_t)v * W;
+      const double* above = &integral[(size_t)(v - top) * stride];
+      double* cur = &integral[(size_t)(v - top + 1) * stride];
+      double sum[NE_CHANNELS] = {0};
+      memset(cur, 0, sizeof(double) * NE_CHANNELS);
+      for(int u = 0; u < W; u++) {
+        const TY_VECT_3F& p = row[u];
+        if(validPoint(p)) {
+          const double x = p.x - origin.x, y = p.y - origin.y, z = p.z - origin.z;
+          sum[0] += 1;
+          sum[1] += x;
+          sum[2] += y;
+          sum[3] += z;
+          sum[4] += x * x;
+          sum[5] += x * y;
+          sum[6] += x * z;
+          sum[7] += y * y;
+          sum[8] += y * z;
+          sum[9] += z * z;
+        }
+        double* c = cur + (size_t)(u + 1) * NE_CHANNELS;
+        const double* a = above + (size_t)(u + 1) * NE_CHANNELS;
+        for(int k = 0; k < NE_CHANNELS; k++) {
+          c[k] = a[k] + sum[k];
+        }
+      }
+    }
+
+    for(int v = v0; v < v1; v++) {
+      const int ra = std::max(0, v - R) - top, rb = std::min(H, v + R + 1) - top;
+      const double* ia = &integral[(size_t)ra * stride];
+      const double* ib = &integral[(size_t)rb * stride];
+      for(int u = 0; u < W; u++) {
+        const size_t i = (size_t)v * W + u;
+        TY_VECT_3F& normal = job.normals[i];
+        const TY_VECT_3F& p = job.points[i];
+        if(!validPoint(p)) {
+          normal.x = normal.y = normal.z = nan;
+          if(job.curvature) job.curvature[i] = nan;
+          continue;
+        }
+        const size_t ca = (size_t)std::max(0, u - R) * NE_CHANNELS;
+        const size_t cb = (size_t)std::min(W, u + R + 1) * NE_CHANNELS;
+        double m[NE_CHANNELS];
+        for(int k = 0; k < NE_CHANNELS; k++) {
+          m[k] = ib[cb + k] - ib[ca + k] - ia[cb + k] + ia[ca + k];
+        }
+        if(m[0] < self._minNeighbors - 0.5) {
+          normal.x = normal.y = normal.z = nan;
+          if(job.curvature) job.curvature[i] = nan;
+          continue;
+        }
+        const double w = 1 / m[0];
+        const double mx = m[1] * w, my = m[2] * w, mz = m[3] * w;
+        const double C[6] = {m[4] * w - mx * mx, m[5] * w - mx * my, m[6] * w - mx * mz,
+                             m[7] * w - my * my, m[8] * w - my * mz, m[9] * w - mz * mz};
+        double n[3], curvature;
+        smallestEigenVector(C, n, &curvature);
+        const double d = n[0] * (self._viewPoint.x - p.x) + n[1] * (self._viewPoint.y - p.y)
+                       + n[2] * (self._viewPoint.z - p.z);
+        const double sign = d < 0 ? -1 : 1;
+        normal.x = (float)(n[0] * sign);
+        normal.y = (float)(n[1] * sign);
+        normal.z = (float)(n[2] * sign);
+        if(job.curvature) job.curvature[i] = (float)curvature;
+      }
+    }
+  }
+}
+
+TY_STATUS NormalEstimator::compute(const TY_VECT_3F* points, uint32_t width, uint32_t height,
+                                   TY_VECT_3F* normals, float* curvature) const
+{
+  if(!points || !normals) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!width || !height) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  Job job = {this, points, width, height, normals, curvature};
+  TYParallelFor((int)((height + NE_STRIP_ROWS - 1) / NE_STRIP_ROWS), _threads, strips, &job);
+  return TY_STATUS_OK;
+}
@@ -0,0 +1,56 @@
+#ifndef XYZ_NORMAL_ESTIMATOR_HPP_
+#define XYZ_NORMAL_ESTIMATOR_HPP_
+
+#include "TYCoordinateMapper.h"
+
+/// @brief Normals of organized clouds, e.g. from TYMapDepthImageToPoint3d or
+/// PointCloudGenerator::compute().
+///
+/// The neighbourhood of a pixel is a square window of the image. Integral
+/// images of the point count, x, y, z and their products give the
+/// covariance of any window in O(1), whatever its size; the normal is the
+/// eigenvector of its smallest eigenvalue. NaN points are holes, they count
+/// for nothing in the windows around them. Rows are split into strips, each
+/// with its own integral images in double, spread over worker threads.
+class NormalEstimator
+{
+public:
+    NormalEstimator();
+
+    /// @brief Side of the pixel window, odd, 3 or more. Larger windows smooth more.
+    void setWindowSize(int size) { _radius = size < 3 ? 1 : size / 2; }
+    int  windowSize() const { return 2 * _radius + 1; }
+
+    /// @brief Valid points a window needs for a normal, 3 or more.
+    void setMinNeighbors(int count) { _minNeighbors = count < 3 ? 3 : count; }
+
+    /// @brief Normals are flipped to face this point, the camera origin by default.
+    void setViewPoint(float x, float y, float z);
+
+    /// @brief Worker threads, 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Estimate the normal of every pixel.
+    /// @param  [in]  points                Organized cloud, width x height, NaN for no point.
+    /// @param  [in]  width                 Width of the cloud.
+    /// @param  [in]  height                Height of the cloud.
+    /// @param  [out] normals               Unit normals, width x height, NaN where the point is NaN
+    ///                                     or its window has too few points.
+    /// @param  [out] curvature             Optional, smallest eigenvalue over their sum, NaN as normals.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NULL_POINTER      points or normals is NULL.
+    /// @retval TY_STATUS_INVALID_PARAMETER Empty cloud.
+    TY_STATUS compute(const TY_VECT_3F* points, uint32_t width, uint32_t height,
+                      TY_VECT_3F* normals, float* curvature = NULL) const;
+
+private:
+    struct Job;
+    static void strips(int begin, int end, void* arg);
+
+    int        _radius;
+    int        _minNeighbors;
+    int        _threads;
+    TY_VECT_3F _viewPoint;
+};
+
+#endif
@@ -0,0 +1,522 @@
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include "PointCloudFormat.hpp"
+#include "TYThread.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TY_PCF_SSE2
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define TY_PCF_F16C
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TY_PCF_NEON
+#if defined(__aarch64__)
+#define TY_PCF_NEON_F16
+#endif
+#endif
+
+// xyz48 points per parallel task
+#define PCF_TASK_POINTS     (16384)
+
+static inline uint32_t floatBits(float f)
+{
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static inline float bitsFloat(uint32_t u)
+{
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+static inline int16_t toInt16(float v, float inv)
+{
+  v *= inv;
+  if(v != v) {
+    return 0;
+  }
+  v = v < -32768.f ? -32768.f : (v > 32767.f ? 32767.f : v);
+  return (int16_t)lrintf(v);
+}
+
+// round to nearest even, the bit trick of F. Giesen's float_to_half_fast3_rtne
+static inline uint16_t toHalf(float f)
+{
+  const uint32_t f32infty = 255u << 23;
+  const uint32_t f16max = (127u + 16) << 23;
+  const uint32_t denormMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+  uint32_t x = floatBits(f);
+  const uint32_t sign = x & 0x80000000u;
+  x ^= sign;
+
+  uint16_t o;
+  if(x >= f16max) {
+    o = x > f32infty ? 0x7e00 : 0x7c00;
+  } else if(x < (113u << 23)) {
+    // subnormal half, let the float adder do the rounding
+    o = (uint16_t)(floatBits(bitsFloat(x) + bitsFloat(denormMagic)) - denormMagic);
+  } else {
+    const uint32_t mantOdd = (x >> 13) & 1;
+    x += ((uint32_t)(15 - 127) << 23) + 0xfff;
+    x += mantOdd;
+    o = (uint16_t)(x >> 13);
+  }
+  return (uint16_t)(o | (sign >> 16));
+}
+
+static inline float fromHalf(uint16_t h)
+{
+  const uint32_t shiftedExp = 0x7c00u << 13;
+  uint32_t o = (h & 0x7fffu) << 13;
+  const uint32_t exp = shiftedExp & o;
+  o += (uint32_t)(127 - 15) << 23;
+  if(exp == shiftedExp) {
+    o += (uint32_t)(128 - 16) << 23;                // inf, NaN
+  } else if(exp == 0) {
+    o += 1u << 23;                                  // zero, subnormal
+    o = floatBits(bitsFloat(o) - bitsFloat(113u << 23));
+  }
+  return bitsFloat(o | ((uint32_t)(h & 0x8000u) << 16));
+}
+
+#if defined(TY_PCF_SSE2)
+
+// x0 x1 x2 x3, y.., z.. -> x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+static inline void storePoints4(__m128 vx, __m128 vy, __m128 vz, float* p)
+{
+  const __m128 xy01 = _mm_unpacklo_ps(vx, vy);
+  const __m128 xy23 = _mm_unpackhi_ps(vx, vy);
+  const __m128 t0 = _mm_shuffle_ps(vz, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+  const __m128 t1 = _mm_shuffle_ps(xy01, vz, _MM_SHUFFLE(1, 1, 3, 3));
+  const __m128 t2 = _mm_shuffle_ps(vz, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm_storeu_ps(p + 0, _mm_shuffle_ps(xy01, t0, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(p + 4, _mm_shuffle_ps(t1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(p + 8, _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(1, 3, 2, 0)));
+}
+
+#endif
+
+void TYFloatToInt16(const float* src, size_t n, float f_scale_unit, int16_t* dst)
+{
+  const float inv = 1.f / f_scale_unit;
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  const __m128 vinv = _mm_set1_ps(inv);
+  const __m128 lo = _mm_set1_ps(-32768.f), hi = _mm_set1_ps(32767.f);
+  for(; i + 8 <= n; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), vinv);
+    __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), vinv);
+    a = _mm_and_ps(a, _mm_cmpord_ps(a, a));
+    b = _mm_and_ps(b, _mm_cmpord_ps(b, b));
+    a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+    b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+  }
+#elif defined(TY_PCF_NEON) && defined(__aarch64__)
+  // armv7 has no round to nearest conversion, stays scalar to round as lrintf
+  const float32x4_t lo = vdupq_n_f32(-32768.f), hi = vdupq_n_f32(32767.f);
+  for(; i + 8 <= n; i += 8) {
+    float32x4_t a = vmulq_n_f32(vld1q_f32(src + i), inv);
+    float32x4_t b = vmulq_n_f32(vld1q_f32(src + i + 4), inv);
+    a = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vceqq_f32(a, a)));
+    b = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(b), vceqq_f32(b, b)));
+    a = vminq_f32(vmaxq_f32(a, lo), hi);
+    b = vminq_f32(vmaxq_f32(b, lo), hi);
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+  }
+#endif
+  for(; i < n; i++) {
+    dst[i] = toInt16(src[i], inv);
+  }
+}
+
+void TYInt16ToFloat(const int16_t* src, size_t n, float f_scale_unit, float* dst)
+{
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  const __m128 scale = _mm_set1_ps(f_scale_unit);
+  for(; i + 8 <= n; i += 8) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+  }
+#elif defined(TY_PCF_NEON)
+  for(; i + 8 <= n; i += 8) {
+    const int16x8_t v = vld1q_s16(src + i);
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), f_scale_unit));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), f_scale_unit));
+  }
+#endif
+  for(; i < n; i++) {
+    dst[i] = src[i] * f_scale_unit;
+  }
+}
+
+void TYFloatToHalf(const float* src, size_t n, uint16_t* dst)
+{
+  size_t i = 0;
+#if defined(TY_PCF_F16C)
+  for(; i + 8 <= n; i += 8) {
+    const __m128i a = _mm_cvtps_ph(_mm_loadu_ps(src + i), 0);
+    const __m128i b = _mm_cvtps_ph(_mm_loadu_ps(src + i + 4), 0);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi64(a, b));
+  }
+#elif defined(TY_PCF_NEON_F16)
+  for(; i + 4 <= n; i += 4) {
+    vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+  }
+#endif
+  for(; i < n; i++) {
+    dst[i] = toHalf(src[i]);
+  }
+}
+
+void TYHalfToFloat(const uint16_t* src, size_t n, float* dst)
+{
+  size_t i = 0;
+#if defined(TY_PCF_F16C)
+  for(; i + 8 <= n; i += 8) {
+    const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+    _mm_storeu_ps(dst + i, _mm_cvtph_ps(v));
+    _mm_storeu_ps(dst + i + 4, _mm_cvtph_ps(_mm_unpackhi_epi64(v, v)));
+  }
+#elif defined(TY_PCF_NEON_F16)
+  for(; i + 4 <= n; i += 4) {
+    vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+  }
+#endif
+  for(; i < n; i++) {
+    dst[i] = fromHalf(src[i]);
+  }
+}
+
+void TYPointsToPlanes(const TY_VECT_3F* points, size_t n, float* x, float* y, float* z)
+{
+  const float* p = (const float*)points;
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  for(; i + 4 <= n; i += 4, p += 12) {
+    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    const __m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+    const __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 ab0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m128 bc1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    const __m128 ab1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    _mm_storeu_ps(x + i, _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0)));
+    _mm_storeu_ps(y + i, _mm_shuffle_ps(ab0, bc1, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(z + i, _mm_shuffle_ps(ab1, c, _MM_SHUFFLE(3, 0, 2, 0)));
+  }
+#elif defined(TY_PCF_NEON)
+  for(; i + 4 <= n; i += 4, p += 12) {
+    const float32x4x3_t v = vld3q_f32(p);
+    vst1q_f32(x + i, v.val[0]);
+    vst1q_f32(y + i, v.val[1]);
+    vst1q_f32(z + i, v.val[2]);
+  }
+#endif
+  for(; i < n; i++) {
+    x[i] = points[i].x;
+    y[i] = points[i].y;
+    z[i] = points[i].z;
+  }
+}
+
+void TYPlanesToPoints(const float* x, const float* y, const float* z, size_t n, TY_VECT_3F* points)
+{
+  float* p = (float*)points;
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  for(; i + 4 <= n; i += 4, p += 12) {
+    storePoints4(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i), _mm_loadu_ps(z + i), p);
+  }
+#elif defined(TY_PCF_NEON)
+  for(; i + 4 <= n; i += 4, p += 12) {
+    float32x4x3_t v;
+    v.val[0] = vld1q_f32(x + i);
+    v.val[1] = vld1q_f32(y + i);
+    v.val[2] = vld1q_f32(z + i);
+    vst3q_f32(p, v);
+  }
+#endif
+  for(; i < n; i++) {
+    points[i].x = x[i];
+    points[i].y = y[i];
+    points[i].z = z[i];
+  }
+}
+
+void TYPointsToXYZ48(const TY_VECT_3F* points, size_t n, float f_scale_unit, int16_t* xyz48)
+{
+  TYFloatToInt16((const float*)points, 3 * n, f_scale_unit, xyz48);
+}
+
+#if defined(TY_PCF_SSE2)
+
+// Split 8 xyz48 points into x, y and z vectors with SSE2 unpacks only
+static inline void loadXYZ48(const int16_t* p, __m128i& x, __m128i& y, __m128i& z)
+{
+  const __m128i t00 = _mm_loadu_si128((const __m128i*)p);          // x0 y0 z0 x1 y1 z1 x2 y2
+  const __m128i t01 = _mm_loadu_si128((const __m128i*)(p + 8));    // z2 x3 y3 z3 x4 y4 z4 x5
+  const __m128i t02 = _mm_loadu_si128((const __m128i*)(p + 16));   // y5 z5 x6 y6 z6 x7 y7 z7
+
+  const __m128i t10 = _mm_unpacklo_epi16(t00, _mm_unpackhi_epi64(t01, t01));
+  const __m128i t11 = _mm_unpacklo_epi16(_mm_unpackhi_epi64(t00, t00), t02);
+  const __m128i t12 = _mm_unpacklo_epi16(t01, _mm_unpackhi_epi64(t02, t02));
+
+  const __m128i t20 = _mm_unpacklo_epi16(t10, _mm_unpackhi_epi64(t11, t11));
+  const __m128i t21 = _mm_unpacklo_epi16(_mm_unpackhi_epi64(t10, t10), t12);
+  const __m128i t22 = _mm_unpacklo_epi16(t11, _mm_unpackhi_epi64(t12, t12));
+
+  x = _mm_unpacklo_epi16(t20, _mm_unpackhi_epi64(t21, t21));
+  y = _mm_unpacklo_epi16(_mm_unpackhi_epi64(t20, t20), t22);
+  z = _mm_unpacklo_epi16(t21, _mm_unpackhi_epi64(t22, t22));
+}
+
+// 8 int16 to float, lanes of invalid set to NaN
+static inline void toFloat8(__m128i v, __m128 scale, __m128i invalid, __m128& a, __m128& b)
+{
+  const __m128 nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), scale);
+  b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), scale);
+  a = _mm_or_ps(a, _mm_and_ps(_mm_castsi128_ps(_mm_unpacklo_epi16(invalid, invalid)), nan));
+  b = _mm_or_ps(b, _mm_and_ps(_mm_castsi128_ps(_mm_unpackhi_epi16(invalid, invalid)), nan));
+}
+
+#endif
+
+static void xyz48ToDepth16(const int16_t* xyz48, size_t n, uint16_t* depth)
+{
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  for(; i + 8 <= n; i += 8) {
+    __m128i x, y, z;
+    loadXYZ48(xyz48 + 3 * i, x, y, z);
+    _mm_storeu_si128((__m128i*)(depth + i), z);
+  }
+#elif defined(TY_PCF_NEON)
+  for(; i + 8 <= n; i += 8) {
+    vst1q_u16(depth + i, vreinterpretq_u16_s16(vld3q_s16(xyz48 + 3 * i).val[2]));
+  }
+#endif
+  const StridedView<const int16_t> z = TYXYZ48ZView(xyz48, n);
+  for(; i < n; i++) {
+    depth[i] = (uint16_t)z[i];
+  }
+}
+
+static void xyz48ToPlanes(const int16_t* xyz48, size_t n, float f_scale_unit, float* x, float* y, float* z)
+{
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  const __m128 scale = _mm_set1_ps(f_scale_unit);
+  for(; i + 8 <= n; i += 8) {
+    __m128i vx, vy, vz;
+    loadXYZ48(xyz48 + 3 * i, vx, vy, vz);
+    const __m128i invalid = _mm_cmpeq_epi16(vz, _mm_setzero_si128());
+    __m128 a, b;
+    toFloat8(vx, scale, invalid, a, b);
+    _mm_storeu_ps(x + i, a);
+    _mm_storeu_ps(x + i + 4, b);
+    toFloat8(vy, scale, invalid, a, b);
+    _mm_storeu_ps(y + i, a);
+    _mm_storeu_ps(y + i + 4, b);
+    toFloat8(vz, scale, invalid, a, b);
+    _mm_storeu_ps(z + i, a);
+    _mm_storeu_ps(z + i + 4, b);
+  }
+#elif defined(TY_PCF_NEON)
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  for(; i + 8 <= n; i += 8) {
+    const int16x8x3_t v = vld3q_s16(xyz48 + 3 * i);
+    const uint16x8_t invalid = vceqq_s16(v.val[2], vdupq_n_s16(0));
+    const uint32x4_t mlo = vmovl_u16(vget_low_u16(invalid));
+    const uint32x4_t mhi = vmovl_u16(vget_high_u16(invalid));
+    float* dst[3] = {x + i, y + i, z + i};
+    for(int c = 0; c < 3; c++) {
+      const float32x4_t lo = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[c]))), f_scale_unit);
+      const float32x4_t hi = vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[c]))), f_scale_unit);
+      vst1q_f32(dst[c], vbslq_f32(vtstq_u32(mlo, mlo), nan, lo));
+      vst1q_f32(dst[c] + 4, vbslq_f32(vtstq_u32(mhi, mhi), nan, hi));
+    }
+  }
+#endif
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(; i < n; i++) {
+    const int16_t* p = xyz48 + 3 * i;
+    if(p[2]) {
+      x[i] = p[0] * f_scale_unit;
+      y[i] = p[1] * f_scale_unit;
+      z[i] = p[2] * f_scale_unit;
+    } else {
+      x[i] = y[i] = z[i] = nan;
+    }
+  }
+}
+
+#if defined(TY_PCF_SSE2)
+// (x, y, z) = M * (x, y, z, 1), M is 3x4 row major
+static inline void transform4(const __m128* m, __m128& x, __m128& y, __m128& z)
+{
+  const __m128 tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)),
+                               _mm_add_ps(_mm_mul_ps(m[2], z), m[3]));
+  const __m128 ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)),
+                               _mm_add_ps(_mm_mul_ps(m[6], z), m[7]));
+  z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)),
+                 _mm_add_ps(_mm_mul_ps(m[10], z), m[11]));
+  x = tx;
+  y = ty;
+}
+#endif
+
+// M is the 3x4 pose of the output frame, NULL to keep the camera frame.
+static void xyz48ToPoints(const int16_t* xyz48, size_t n, float f_scale_unit, const float* M, TY_VECT_3F* points)
+{
+  size_t i = 0;
+#if defined(TY_PCF_SSE2)
+  const __m128 scale = _mm_set1_ps(f_scale_unit);
+  __m128 m[12];
+  for(int k = 0; M && k < 12; k++) {
+    m[k] = _mm_set1_ps(M[k]);
+  }
+  for(; i + 8 <= n; i += 8) {
+    __m128i vx, vy, vz;
+    loadXYZ48(xyz48 + 3 * i, vx, vy, vz);
+    const __m128i invalid = _mm_cmpeq_epi16(vz, _mm_setzero_si128());
+    __m128 x0, x1, y0, y1, z0, z1;
+    toFloat8(vx, scale, invalid, x0, x1);
+    toFloat8(vy, scale, invalid, y0, y1);
+    toFloat8(vz, scale, invalid, z0, z1);
+    if(M) {
+      transform4(m, x0, y0, z0);
+      transform4(m, x1, y1, z1);
+    }
+    storePoints4(x0, y0, z0, (float*)(points + i));
+    storePoints4(x1, y1, z1, (float*)(points + i + 4));
+  }
+#elif defined(TY_PCF_NEON)
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  for(; i + 4 <= n; i += 4) {
+    const int16x4x3_t v = vld3_s16(xyz48 + 3 * i);
+    const uint32x4_t invalid = vceqq_s32(vmovl_s16(v.val[2]), vdupq_n_s32(0));
+    float32x4x3_t p;
+    for(int c = 0; c < 3; c++) {
+      p.val[c] = vbslq_f32(invalid, nan, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v.val[c])), f_scale_unit));
+    }
+    if(M) {
+      const float32x4_t x = p.val[0], y = p.val[1], z = p.val[2];
+      for(int r = 0; r < 3; r++) {
+        const float* R = M + 4 * r;
+        p.val[r] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(R[3]), x, R[0]), y, R[1]), z, R[2]);
+      }
+    }
+    vst3q_f32((float*)(points + i), p);
+  }
+#endif
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(; i < n; i++) {
+    const int16_t* p = xyz48 + 3 * i;
+    if(p[2]) {
+      const float x = p[0] * f_scale_unit, y = p[1] * f_scale_unit, z = p[2] * f_scale_unit;
+      if(M) {
+        points[i].x = M[0] * x + M[1] * y + M[2]  * z + M[3];
+        points[i].y = M[4] * x + M[5] * y + M[6]  * z + M[7];
+        points[i].z = M[8] * x + M[9] * y + M[10] * z + M[11];
+      } else {
+        points[i].x = x;
+        points[i].y = y;
+        points[i].z = z;
+      }
+    } else {
+      points[i].x = points[i].y = points[i].z = nan;
+    }
+  }
+}
+
+enum XYZ48Target {
+  XYZ48_POINTS,
+  XYZ48_PLANES,
+  XYZ48_DEPTH16,
+};
+
+struct XYZ48Job
+{
+  XYZ48Target target;
+  const int16_t* xyz48;
+  size_t n;
+  float scale;
+  const float* pose;
+  TY_VECT_3F* points;
+  float* x;
+  float* y;
+  float* z;
+  uint16_t* depth;
+};
+
+static void xyz48Tasks(int begin, int end, void* arg)
+{
+  const XYZ48Job& job = *(const XYZ48Job*)arg;
+  const size_t first = (size_t)begin * PCF_TASK_POINTS;
+  const size_t last = (size_t)end * PCF_TASK_POINTS < job.n ? (size_t)end * PCF_TASK_POINTS : job.n;
+  const int16_t* src = job.xyz48 + 3 * first;
+  switch(job.target) {
+  case XYZ48_POINTS:
+    xyz48ToPoints(src, last - first, job.scale, job.pose, job.points + first);
+    break;
+  case XYZ48_PLANES:
+    xyz48ToPlanes(src, last - first, job.scale, job.x + first, job.y + first, job.z + first);
+    break;
+  case XYZ48_DEPTH16:
+    xyz48ToDepth16(src, last - first, job.depth + first);
+    break;
+  }
+}
+
+static void runXYZ48(XYZ48Job& job, int threads)
+{
+  const int tasks = (int)((job.n + PCF_TASK_POINTS - 1) / PCF_TASK_POINTS);
+  TYParallelFor(tasks, threads, xyz48Tasks, &job);
+}
+
+void TYXYZ48ToPoints(const int16_t* xyz48, size_t n, float f_scale_unit, TY_VECT_3F* points, int threads)
+{
+  TYXYZ48ToPoints(xyz48, n, f_scale_unit, NULL, points, threads);
+}
+
+void TYXYZ48ToPoints(const int16_t* xyz48, size_t n, float f_scale_unit, const TY_CAMERA_EXTRINSIC* pose,
+                     TY_VECT_3F* points, int threads)
+{
+  XYZ48Job job = {XYZ48_POINTS, xyz48, n, f_scale_unit, pose ? pose->data : NULL, points, NULL, NULL, NULL, NULL};
+  runXYZ48(job, threads);
+}
+
+void TYXYZ48ToPlanes(const int16_t* xyz48, size_t n, float f_scale_unit, float* x, float* y, float* z,
+                     int threads)
+{
+  XYZ48Job job = {XYZ48_PLANES, xyz48, n, f_scale_unit, NULL, NULL, x, y, z, NULL};
+  runXYZ48(job, threads);
+}
+
+void TYXYZ48ToDepth16(const int16_t* xyz48, size_t n, uint16_t* depth, int threads)
+{
+  XYZ48Job job = {XYZ48_DEPTH16, xyz48, n, 0.f, NULL, NULL, NULL, NULL, NULL, depth};
+  runXYZ48(job, threads);
+}
+
+void TYPointsToHalf(const TY_VECT_3F* points, size_t n, uint16_t* half)
+{
+  TYFloatToHalf((const float*)points, 3 * n, half);
+}
+
+void TYHalfToPoints(const uint16_t* half, size_t n, TY_VECT_3F* points)
+{
+  TYHalfToFloat(half, 3 * n, (float*)points);
+}
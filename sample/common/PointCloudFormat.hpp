@@ -0,0 +1,84 @@
+#ifndef XYZ_POINT_CLOUD_FORMAT_HPP_
+#define XYZ_POINT_CLOUD_FORMAT_HPP_
+
+#include <stddef.h>
+#include "TYCoordinateMapper.h"
+
+/// Point cloud storage formats besides TY_VECT_3F (12 bytes per point):
+///   planes  three float planes x[n], y[n], z[n]
+///   xyz48   int16 x, y, z per point in scale units, the layout of
+///           TY_PIXEL_FORMAT_XYZ48, z == 0 for no point (6 bytes)
+///   half    IEEE 754 half float x, y, z per point, NaN for no point, about
+///           1/2048 relative precision (6 bytes)
+/// Invalid points of a TY_VECT_3F cloud are NaN, as TYMapDepthImageToPoint3d
+/// writes them.
+
+/// @brief Element conversions, any layout.
+/// dst = round(src / f_scale_unit) saturated to int16, NaN gives 0.
+void TYFloatToInt16(const float* src, size_t n, float f_scale_unit, int16_t* dst);
+/// dst = src * f_scale_unit.
+void TYInt16ToFloat(const int16_t* src, size_t n, float f_scale_unit, float* dst);
+/// Round to nearest even, out of range gives +-inf.
+void TYFloatToHalf(const float* src, size_t n, uint16_t* dst);
+void TYHalfToFloat(const uint16_t* src, size_t n, float* dst);
+
+/// @brief Split points into x, y and z planes of n floats.
+void TYPointsToPlanes(const TY_VECT_3F* points, size_t n, float* x, float* y, float* z);
+/// @brief Interleave x, y and z planes into points.
+void TYPlanesToPoints(const float* x, const float* y, const float* z, size_t n, TY_VECT_3F* points);
+
+/// @brief Points to xyz48, NaN points give (0, 0, 0).
+/// @param  [in]  points                Input points.
+/// @param  [in]  n                     Number of points.
+/// @param  [in]  f_scale_unit          Unit of the int16 values, e.g. the depth scale unit.
+/// @param  [out] xyz48                 Output, 3 x n values.
+void TYPointsToXYZ48(const TY_VECT_3F* points, size_t n, float f_scale_unit, int16_t* xyz48);
+
+/// @brief Unpack xyz48 to points, z == 0 gives a NaN point.
+/// @param  [in]  xyz48                 Input, 3 x n values.
+/// @param  [in]  n                     Number of points.
+/// @param  [in]  f_scale_unit          Unit of the int16 values.
+/// @param  [out] points                Output points.
+/// @param  [in]  threads               Worker threads, 0 for one per cpu.
+void TYXYZ48ToPoints(const int16_t* xyz48, size_t n, float f_scale_unit, TY_VECT_3F* points, int threads = 0);
+/// @brief Unpack xyz48 to points in another frame, pose applied in the same pass.
+/// @param  [in]  pose                  Transform from the camera frame, e.g. an inverted extrinsic, NULL for none.
+void TYXYZ48ToPoints(const int16_t* xyz48, size_t n, float f_scale_unit, const TY_CAMERA_EXTRINSIC* pose,
+                     TY_VECT_3F* points, int threads = 0);
+/// @brief Unpack xyz48 to x, y and z planes, z == 0 gives a NaN point.
+void TYXYZ48ToPlanes(const int16_t* xyz48, size_t n, float f_scale_unit, float* x, float* y, float* z,
+                     int threads = 0);
+/// @brief Depth image of xyz48, the z values.
+void TYXYZ48ToDepth16(const int16_t* xyz48, size_t n, uint16_t* depth, int threads = 0);
+
+/// @brief Points to half floats, 3 x n values.
+void TYPointsToHalf(const TY_VECT_3F* points, size_t n, uint16_t* half);
+void TYHalfToPoints(const uint16_t* half, size_t n, TY_VECT_3F* points);
+
+/// @brief Non owning view of every stride-th element, e.g. one channel of
+/// an interleaved image, read in place instead of being copied out.
+template <typename T>
+class StridedView
+{
+public:
+    StridedView() : _data(NULL), _size(0), _stride(0) {}
+    StridedView(T* data, size_t size, size_t stride) : _data(data), _size(size), _stride(stride) {}
+
+    T&     operator[](size_t i) const { return _data[i * _stride]; }
+    T*     data()   const { return _data; }
+    size_t size()   const { return _size; }
+    size_t stride() const { return _stride; }
+
+private:
+    T*     _data;
+    size_t _size;
+    size_t _stride;
+};
+
+/// @brief The z plane of n xyz48 points, depth of each point in scale units.
+inline StridedView<const int16_t> TYXYZ48ZView(const int16_t* xyz48, size_t n)
+{
+    return StridedView<const int16_t>(xyz48 + 2, n, 3);
+}
+
+#endif
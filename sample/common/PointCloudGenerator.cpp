@@ -0,0 +1,745 @@
+#include <string.h>
+#include <math.h>
+#include <limits>
+#include <algorithm>
+#include "PointCloudGenerator.hpp"
+#include "TYThread.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TY_PC_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TY_PC_NEON
+#endif
+
+#define PC_RAY_TABLE_VERSION  (1)
+// pixels unprojected per kernel call, the x, y, z blocks stay in L1
+#define PC_BLOCK_SIZE         (256)
+// rows per chunk of the packed output, chunks are counted then filled
+#define PC_DENSE_CHUNK_ROWS   (8)
+// fixed point steps of the inverse lens model, most pixels stop well before
+#define PC_UNDISTORT_ITERATIONS (20)
+
+// Unproject n pixels of one row into x, y and z, rays holds (x / z, y / z)
+// per pixel. M is the 3x4 pose of the output frame, NULL for camera frame.
+// Pixels without depth are NaN.
+template <bool POSE>
+static inline void unprojectBlockScalar(const float* rays, const uint16_t* depth, int n, float scale,
+                                        const float* M, float* x, float* y, float* z)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(int i = 0; i < n; i++) {
+    const float pz = depth[i] ? depth[i] * scale : nan;
+    const float px = rays[2 * i + 0] * pz;
+    const float py = rays[2 * i + 1] * pz;
+    if(POSE) {
+      x[i] = M[0] * px + M[1] * py + M[2]  * pz + M[3];
+      y[i] = M[4] * px + M[5] * py + M[6]  * pz + M[7];
+      z[i] = M[8] * px + M[9] * py + M[10] * pz + M[11];
+    } else {
+      x[i] = px;
+      y[i] = py;
+      z[i] = pz;
+    }
+  }
+}
+
+// Same as unprojectBlockScalar() into points.
+template <bool POSE>
+static inline void unprojectRowScalar(const float* rays, const uint16_t* depth, int n, float scale,
+                                      const float* M, TY_VECT_3F* out)
+{
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(int i = 0; i < n; i++) {
+    const float pz = depth[i] ? depth[i] * scale : nan;
+    const float px = rays[2 * i + 0] * pz;
+    const float py = rays[2 * i + 1] * pz;
+    if(POSE) {
+      out[i].x = M[0] * px + M[1] * py + M[2]  * pz + M[3];
+      out[i].y = M[4] * px + M[5] * py + M[6]  * pz + M[7];
+      out[i].z = M[8] * px + M[9] * py + M[10] * pz + M[11];
+    } else {
+      out[i].x = px;
+      out[i].y = py;
+      out[i].z = pz;
+    }
+  }
+}
+
+#if defined(TY_PC_SSE2)
+
+// x0 y0 x1 y1 | x2 y2 x3 y3 | z0 z1 z2 z3 -> x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+static inline void storePoints4(float* o, __m128 xy01, __m128 xy23, __m128 z)
+{
+  const __m128 t0 = _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+  const __m128 t1 = _mm_shuffle_ps(xy01, z, _MM_SHUFFLE(1, 1, 3, 3));
+  const __m128 t2 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm_storeu_ps(o + 0, _mm_shuffle_ps(xy01, t0, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(o + 4, _mm_shuffle_ps(t1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(o + 8, _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(1, 3, 2, 0)));
+}
+
+template <bool POSE>
+static void unprojectRowT(const float* rays, const uint16_t* depth, int n, float scale,
+                          const float* M, TY_VECT_3F* out)
+{
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 vnan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  const __m128i zero = _mm_setzero_si128();
+  __m128 m[12];
+  for(int k = 0; POSE && k < 12; k++) {
+    m[k] = _mm_set1_ps(M[k]);
+  }
+  float* o = (float*)out;
+  int i = 0;
+  for(; i + 4 <= n; i += 4, o += 12) {
+    const __m128i d = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), zero);
+    __m128 pz = _mm_mul_ps(_mm_cvtepi32_ps(d), vscale);
+    pz = _mm_or_ps(pz, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d, zero)), vnan));
+    const __m128 r0 = _mm_loadu_ps(rays + 2 * i), r1 = _mm_loadu_ps(rays + 2 * i + 4);
+    if(POSE) {
+      const __m128 px = _mm_mul_ps(_mm_shuffle_ps(r0, r1, _MM_SHUFFLE(2, 0, 2, 0)), pz);
+      const __m128 py = _mm_mul_ps(_mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 1, 3, 1)), pz);
+      const __m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], px), _mm_mul_ps(m[1], py)),
+                                  _mm_add_ps(_mm_mul_ps(m[2], pz), m[3]));
+      const __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], px), _mm_mul_ps(m[5], py)),
+                                  _mm_add_ps(_mm_mul_ps(m[6], pz), m[7]));
+      const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], px), _mm_mul_ps(m[9], py)),
+                                  _mm_add_ps(_mm_mul_ps(m[10], pz), m[11]));
+      storePoints4(o, _mm_unpacklo_ps(x, y), _mm_unpackhi_ps(x, y), z);
+    } else {
+      // the ray pairs times z are the x y pairs of the output as they are
+      storePoints4(o, _mm_mul_ps(r0, _mm_unpacklo_ps(pz, pz)), _mm_mul_ps(r1, _mm_unpackhi_ps(pz, pz)), pz);
+    }
+  }
+  unprojectRowScalar<POSE>(rays + 2 * i, depth + i, n - i, scale, M, out + i);
+}
+
+template <bool POSE>
+static void unprojectBlockT(const float* rays, const uint16_t* depth, int n, float scale,
+                            const float* M, float* x, float* y, float* z)
+{
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 vnan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  const __m128i zero = _mm_setzero_si128();
+  __m128 m[12];
+  for(int k = 0; POSE && k < 12; k++) {
+    m[k] = _mm_set1_ps(M[k]);
+  }
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    const __m128i d = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), zero);
+    __m128 pz = _mm_mul_ps(_mm_cvtepi32_ps(d), vscale);
+    pz = _mm_or_ps(pz, _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d, zero)), vnan));
+    const __m128 r0 = _mm_loadu_ps(rays + 2 * i), r1 = _mm_loadu_ps(rays + 2 * i + 4);
+    const __m128 px = _mm_mul_ps(_mm_shuffle_ps(r0, r1, _MM_SHUFFLE(2, 0, 2, 0)), pz);
+    const __m128 py = _mm_mul_ps(_mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 1, 3, 1)), pz);
+    if(POSE) {
+      _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], px), _mm_mul_ps(m[1], py)),
+                                      _mm_add_ps(_mm_mul_ps(m[2], pz), m[3])));
+      _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], px), _mm_mul_ps(m[5], py)),
+                                      _mm_add_ps(_mm_mul_ps(m[6], pz), m[7])));
+      _mm_storeu_ps(z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], px), _mm_mul_ps(m[9], py)),
+                                      _mm_add_ps(_mm_mul_ps(m[10], pz), m[11])));
+    } else {
+      _mm_storeu_ps(x + i, px);
+      _mm_storeu_ps(y + i, py);
+      _mm_storeu_ps(z + i, pz);
+    }
+  }
+  unprojectBlockScalar<POSE>(rays + 2 * i, depth + i, n - i, scale, M, x + i, y + i, z + i);
+}
+
+#elif defined(TY_PC_NEON)
+
+template <bool POSE>
+static void unprojectRowT(const float* rays, const uint16_t* depth, int n, float scale,
+                          const float* M, TY_VECT_3F* out)
+{
+  const float32x4_t vnan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  float* o = (float*)out;
+  int i = 0;
+  for(; i + 4 <= n; i += 4, o += 12) {
+    const uint32x4_t d = vmovl_u16(vld1_u16(depth + i));
+    const float32x4x2_t r = vld2q_f32(rays + 2 * i);
+    const float32x4_t pz = vbslq_f32(vceqq_u32(d, vdupq_n_u32(0)), vnan, vmulq_n_f32(vcvtq_f32_u32(d), scale));
+    const float32x4_t px = vmulq_f32(r.val[0], pz);
+    const float32x4_t py = vmulq_f32(r.val[1], pz);
+    float32x4x3_t p;
+    if(POSE) {
+      p.val[0] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[3]), px, M[0]), py, M[1]), pz, M[2]);
+      p.val[1] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[7]), px, M[4]), py, M[5]), pz, M[6]);
+      p.val[2] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[11]), px, M[8]), py, M[9]), pz, M[10]);
+    } else {
+      p.val[0] = px;
+      p.val[1] = py;
+      p.val[2] = pz;
+    }
+    vst3q_f32(o, p);
+  }
+  unprojectRowScalar<POSE>(rays + 2 * i, depth + i, n - i, scale, M, out + i);
+}
+
+template <bool POSE>
+static void unprojectBlockT(const float* rays, const uint16_t* depth, int n, float scale,
+                            const float* M, float* x, float* y, float* z)
+{
+  const float32x4_t vnan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    const uint32x4_t d = vmovl_u16(vld1_u16(depth + i));
+    const float32x4x2_t r = vld2q_f32(rays + 2 * i);
+    const float32x4_t pz = vbslq_f32(vceqq_u32(d, vdupq_n_u32(0)), vnan, vmulq_n_f32(vcvtq_f32_u32(d), scale));
+    const float32x4_t px = vmulq_f32(r.val[0], pz);
+    const float32x4_t py = vmulq_f32(r.val[1], pz);
+    if(POSE) {
+      vst1q_f32(x + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[3]), px, M[0]), py, M[1]), pz, M[2]));
+      vst1q_f32(y + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[7]), px, M[4]), py, M[5]), pz, M[6]));
+      vst1q_f32(z + i, vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[11]), px, M[8]), py, M[9]), pz, M[10]));
+    } else {
+      vst1q_f32(x + i, px);
+      vst1q_f32(y + i, py);
+      vst1q_f32(z + i, pz);
+    }
+  }
+  unprojectBlockScalar<POSE>(rays + 2 * i, depth + i, n - i, scale, M, x + i, y + i, z + i);
+}
+
+#else
+
+template <bool POSE>
+static void unprojectRowT(const float* rays, const uint16_t* depth, int n, float scale,
+                          const float* M, TY_VECT_3F* out)
+{
+  unprojectRowScalar<POSE>(rays, depth, n, scale, M, out);
+}
+
+template <bool POSE>
+static void unprojectBlockT(const float* rays, const uint16_t* depth, int n, float scale,
+                            const float* M, float* x, float* y, float* z)
+{
+  unprojectBlockScalar<POSE>(rays, depth, n, scale, M, x, y, z);
+}
+
+#endif
+
+static void unprojectBlock(const float* rays, const uint16_t* depth, int n, float scale,
+                           const float* M, float* x, float* y, float* z)
+{
+  if(M) {
+    unprojectBlockT<true>(rays, depth, n, scale, M, x, y, z);
+  } else {
+    unprojectBlockT<false>(rays, depth, n, scale, M, x, y, z);
+  }
+}
+
+static void unprojectRow(const float* rays, const uint16_t* depth, int n, float scale,
+                         const float* M, TY_VECT_3F* out)
+{
+  if(M) {
+    unprojectRowT<true>(rays, depth, n, scale, M, out);
+  } else {
+    unprojectRowT<false>(rays, depth, n, scale, M, out);
+  }
+}
+
+void TYComposeExtrinsics(const TY_CAMERA_EXTRINSIC* chain, int count, TY_CAMERA_EXTRINSIC* out)
+{
+  float T[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+  for(int k = 0; k < count; k++) {
+    const float* A = chain[k].data;
+    float R[16];
+    for(int r = 0; r < 4; r++) {
+      for(int c = 0; c < 4; c++) {
+        R[r * 4 + c] = A[r * 4 + 0] * T[0 * 4 + c] + A[r * 4 + 1] * T[1 * 4 + c]
+                     + A[r * 4 + 2] * T[2 * 4 + c] + A[r * 4 + 3] * T[3 * 4 + c];
+      }
+    }
+    memcpy(T, R, sizeof(T));
+  }
+  memcpy(out->data, T, sizeof(T));
+}
+
+PointCloudGenerator::PointCloudGenerator()
+  : _width(0)
+  , _height(0)
+  , _threads(0)
+  , _hasPose(false)
+  , _undistort(false)
+  , _rays(NULL)
+{
+  memset(&_calib, 0, sizeof(_calib));
+  memset(_pose, 0, sizeof(_pose));
+  clearCrop();
+}
+
+// Rays of a distorted image, the lens model (OpenCV rational plus thin
+// prism, TY_CAMERA_DISTORTION) is inverted per pixel by fixed point
+// iteration, as in cv::undistortPoints.
+struct RayTableJob
+{
+  double fx, fy, cx, cy;
+  const float* k;                     // k1, k2, p1, p2, k3, k4, k5, k6, s1, s2, s3, s4
+  uint32_t width;
+  float* rays;
+};
+
+static void undistortedRayRows(int begin, int end, void* arg)
+{
+  const RayTableJob& job = *(const RayTableJob*)arg;
+  const float* k = job.k;
+  for(int v = begin; v < end; v++) {
+    float* r = job.rays + (size_t)v * job.width * 2;
+    const double yd = (v - job.cy) / job.fy;
+    for(uint32_t u = 0; u < job.width; u++, r += 2) {
+      const double xd = (u - job.cx) / job.fx;
+      double x = xd, y = yd;
+      for(int i = 0; i < PC_UNDISTORT_ITERATIONS; i++) {
+        const double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+        const double icdist = (1 + k[5] * r2 + k[6] * r4 + k[7] * r6) / (1 + k[0] * r2 + k[1] * r4 + k[4] * r6);
+        if(!(icdist > 0)) {
+          // outside of where the model is invertible, keep the last estimate
+          break;
+        }
+        const double dx = 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x) + k[8] * r2 + k[9] * r4;
+        const double dy = k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y + k[10] * r2 + k[11] * r4;
+        const double nx = (xd - dx) * icdist, ny = (yd - dy) * icdist;
+        const double change = fabs(nx - x) + fabs(ny - y);
+        x = nx;
+        y = ny;
+        if(change < 1e-10) {
+          break;
+        }
+      }
+      r[0] = (float)x;
+      r[1] = (float)y;
+    }
+  }
+}
+
+static bool hasDistortion(const TY_CAMERA_DISTORTION& distortion)
+{
+  for(int i = 0; i < 12; i++) {
+    if(distortion.data[i] != 0.f) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TY_STATUS PointCloudGenerator::init(const TY_CAMERA_CALIB_INFO* calib, uint32_t width, uint32_t height,
+                                    const TableCache* cache, bool undistort)
+{
+  if(!calib) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  // without coefficients the rays are the same either way
+  undistort = undistort && hasDistortion(calib->distortion);
+  if(_rays && width == _width && height == _height && undistort == _undistort
+      && memcmp(calib, &_calib, sizeof(_calib)) == 0) {
+    return TY_STATUS_OK;
+  }
+  _rays = NULL;
+  _table.clear();
+  _file.close();
+  if(!width || !height || !calib->intrinsicWidth || !calib->intrinsicHeight) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  const float* K = calib->intrinsic.data;
+  const float sx = 1.0f * width / calib->intrinsicWidth;
+  const float sy = 1.0f * height / calib->intrinsicHeight;
+  const float fx = K[0] * sx, cx = K[2] * sx;
+  const float fy = K[4] * sy, cy = K[5] * sy;
+  if(fx == 0.f || fy == 0.f) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  const size_t tableSize = sizeof(float) * 2 * width * height;
+  TableKey key("pcrays", PC_RAY_TABLE_VERSION);
+  key.add(calib).add(width).add(height).add((uint32_t)undistort);
+  const void* payload = NULL;
+  size_t size = 0;
+  if(cache && cache->load(key, _file, &payload, &size) && size == tableSize) {
+    _rays = (const float*)payload;
+  } else {
+    _file.close();
+    _table.resize(2 * width * height);
+    float* r = &_table[0];
+    if(undistort) {
+      RayTableJob job = {fx, fy, cx, cy, calib->distortion.data, width, r};
+      TYParallelFor((int)height, _threads, undistortedRayRows, &job);
+    } else {
+      for(uint32_t v = 0; v < height; v++) {
+        const float ry = (v - cy) / fy;
+        for(uint32_t u = 0; u < width; u++, r += 2) {
+          r[0] = (u - cx) / fx;
+          r[1] = ry;
+        }
+      }
+    }
+    if(cache && cache->enabled()) {
+      cache->store(key, &_table[0], tableSize);
+    }
+    _rays = &_table[0];
+  }
+
+  _calib = *calib;
+  _width = width;
+  _height = height;
+  _undistort = undistort;
+  return TY_STATUS_OK;
+}
+
+void PointCloudGenerator::setPose(const TY_CAMERA_EXTRINSIC* chain, int count)
+{
+  _hasPose = chain && count > 0;
+  if(_hasPose) {
+    TY_CAMERA_EXTRINSIC T;
+    TYComposeExtrinsics(chain, count, &T);
+    memcpy(_pose, T.data, sizeof(_pose));
+  }
+}
+
+void PointCloudGenerator::setCropBox(const TY_VECT_3F& min, const TY_VECT_3F& max, const TY_CAMERA_EXTRINSIC* box)
+{
+  _crop.box = true;
+  _crop.min = min;
+  _crop.max = max;
+  memset(_crop.B, 0, sizeof(_crop.B));
+  _crop.B[0] = _crop.B[5] = _crop.B[10] = 1.f;
+  memcpy(_crop.pose, _crop.B, sizeof(_crop.pose));
+  if(box) {
+    TY_CAMERA_EXTRINSIC inv;
+    TYInvertExtrinsic(box, &inv);
+    memcpy(_crop.B, inv.data, sizeof(_crop.B));
+    memcpy(_crop.pose, box->data, sizeof(_crop.pose));
+  }
+}
+
+void PointCloudGenerator::setDepthRange(float min, float max)
+{
+  _crop.minDepth = min;
+  _crop.maxDepth = max;
+}
+
+void PointCloudGenerator::clearCrop()
+{
+  _crop.box = false;
+  _crop.minDepth = 0.f;
+  _crop.maxDepth = std::numeric_limits<float>::infinity();
+}
+
+bool PointCloudGenerator::cropping() const
+{
+  return _crop.box || _crop.minDepth > 0.f || _crop.maxDepth < std::numeric_limits<float>::infinity();
+}
+
+// Depth values that can pass the crop, from the depth range and the depth
+// camera z of the box corners. Anything outside is dropped before unprojection.
+void PointCloudGenerator::depthWindow(float scale, uint16_t* lo, uint16_t* hi) const
+{
+  float zmin = _crop.minDepth, zmax = _crop.maxDepth;
+  if(_crop.box) {
+    // box frame -> output frame -> depth camera frame
+    TY_CAMERA_EXTRINSIC chain[2], pose, T;
+    memcpy(chain[0].data, _crop.pose, sizeof(_crop.pose));
+    chain[0].data[12] = chain[0].data[13] = chain[0].data[14] = 0.f;
+    chain[0].data[15] = 1.f;
+    if(_hasPose) {
+      memcpy(pose.data, _pose, sizeof(_pose));
+      pose.data[12] = pose.data[13] = pose.data[14] = 0.f;
+      pose.data[15] = 1.f;
+      TYInvertExtrinsic(&pose, &chain[1]);
+    }
+    TYComposeExtrinsics(chain, _hasPose ? 2 : 1, &T);
+    const float* M = T.data;
+    float bmin = std::numeric_limits<float>::infinity(), bmax = -bmin;
+    for(int k = 0; k < 8; k++) {
+      const float x = (k & 1) ? _crop.max.x : _crop.min.x;
+      const float y = (k & 2) ? _crop.max.y : _crop.min.y;
+      const float z = (k & 4) ? _crop.max.z : _crop.min.z;
+      const float cz = M[8] * x + M[9] * y + M[10] * z + M[11];
+      bmin = std::min(bmin, cz);
+      bmax = std::max(bmax, cz);
+    }
+    zmin = std::max(zmin, bmin);
+    zmax = std::min(zmax, bmax);
+  }
+  // one value of slack each side, the exact test is done on the point
+  const double dmin = floor(zmin / scale) - 1, dmax = ceil(zmax / scale) + 1;
+  *lo = (uint16_t)std::max(1.0, std::min(dmin, 65535.0));
+  *hi = (uint16_t)std::max(0.0, std::min(dmax, 65535.0));
+  if(!(zmin <= zmax)) {
+    *lo = 1;
+    *hi = 0;
+  }
+}
+
+// (x, y, z) in the output frame, depthZ the depth camera z.
+inline bool PointCloudGenerator::Crop::contains(float x, float y, float z, float depthZ) const
+{
+  if(depthZ < minDepth || depthZ > maxDepth) {
+    return false;
+  }
+  if(!box) {
+    return true;
+  }
+  const float bx = B[0] * x + B[1] * y + B[2]  * z + B[3];
+  const float by = B[4] * x + B[5] * y + B[6]  * z + B[7];
+  const float bz = B[8] * x + B[9] * y + B[10] * z + B[11];
+  return (bx >= min.x) & (bx <= max.x) & (by >= min.y) & (by <= max.y) & (bz >= min.z) & (bz <= max.z);
+}
+
+struct PointCloudGenerator::Job
+{
+  const PointCloudGenerator* self;
+  const uint16_t* depth;
+  float scale;
+  uint16_t lo, hi;                    // depth window of the crop
+  TY_VECT_3F* point3d;                // organized or packed points
+  float* x;                           // planes
+  float* y;
+  float* z;
+  uint32_t* indices;
+  uint32_t* offsets;                  // per chunk, count then first output
+};
+
+void PointCloudGenerator::pointsRows(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const uint32_t W = job.self->_width;
+  const bool cropping = job.self->cropping();
+  const Crop crop = job.self->_crop;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(int v = begin; v < end; v++) {
+    const size_t off = (size_t)v * W;
+    TY_VECT_3F* p = job.point3d + off;
+    unprojectRow(job.self->_rays + 2 * off, job.depth + off, W, job.scale, job.self->pose(), p);
+    for(uint32_t i = 0; cropping && i < W; i++) {
+      const uint16_t d = job.depth[off + i];
+      if(d < job.lo || d > job.hi || !crop.contains(p[i].x, p[i].y, p[i].z, d * job.scale)) {
+        p[i].x = p[i].y = p[i].z = nan;
+      }
+    }
+  }
+}
+
+TY_STATUS PointCloudGenerator::compute(const uint16_t* depth, TY_VECT_3F* point3d, float f_scale_unit) const
+{
+  if(!_rays) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !point3d) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  Job job = {this, depth, f_scale_unit, 0, 0, point3d, NULL, NULL, NULL, NULL, NULL};
+  depthWindow(f_scale_unit, &job.lo, &job.hi);
+  TYParallelFor((int)_height, _threads, pointsRows, &job);
+  return TY_STATUS_OK;
+}
+
+void PointCloudGenerator::planesRows(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const uint32_t W = job.self->_width;
+  const bool cropping = job.self->cropping();
+  const Crop crop = job.self->_crop;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  for(int v = begin; v < end; v++) {
+    const size_t off = (size_t)v * W;
+    float* x = job.x + off;
+    float* y = job.y + off;
+    float* z = job.z + off;
+    unprojectBlock(job.self->_rays + 2 * off, job.depth + off, W, job.scale, job.self->pose(), x, y, z);
+    for(uint32_t i = 0; cropping && i < W; i++) {
+      const uint16_t d = job.depth[off + i];
+      if(d < job.lo || d > job.hi || !crop.contains(x[i], y[i], z[i], d * job.scale)) {
+        x[i] = y[i] = z[i] = nan;
+      }
+    }
+  }
+}
+
+TY_STATUS PointCloudGenerator::computePlanes(const uint16_t* depth, float* x, float* y, float* z,
+                                             float f_scale_unit) const
+{
+  if(!_rays) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !x || !y || !z) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  Job job = {this, depth, f_scale_unit, 0, 0, NULL, x, y, z, NULL, NULL};
+  depthWindow(f_scale_unit, &job.lo, &job.hi);
+  TYParallelFor((int)_height, _threads, planesRows, &job);
+  return TY_STATUS_OK;
+}
+
+void PointCloudGenerator::countChunks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const uint32_t W = job.self->_width, H = job.self->_height;
+  for(int c = begin; c < end; c++) {
+    const size_t first = (size_t)c * PC_DENSE_CHUNK_ROWS * W;
+    const size_t last = std::min<size_t>((size_t)(c + 1) * PC_DENSE_CHUNK_ROWS, H) * W;
+    uint32_t n = 0;
+    for(size_t i = first; i < last; i++) {
+      n += job.depth[i] != 0;
+    }
+    job.offsets[c] = n;
+  }
+}
+
+void PointCloudGenerator::denseChunks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const uint32_t W = job.self->_width, H = job.self->_height;
+  const float* rays = job.self->_rays;
+  const float* M = job.self->pose();
+  for(int c = begin; c < end; c++) {
+    const size_t first = (size_t)c * PC_DENSE_CHUNK_ROWS * W;
+    const size_t last = std::min<size_t>((size_t)(c + 1) * PC_DENSE_CHUNK_ROWS, H) * W;
+    TY_VECT_3F* out = job.point3d + job.offsets[c];
+    uint32_t* idx = job.indices ? job.indices + job.offsets[c] : NULL;
+    for(size_t i = first; i < last; i++) {
+      if(!job.depth[i]) {
+        continue;
+      }
+      const float z = job.depth[i] * job.scale;
+      const float x = rays[2 * i + 0] * z;
+      const float y = rays[2 * i + 1] * z;
+      if(M) {
+        out->x = M[0] * x + M[1] * y + M[2]  * z + M[3];
+        out->y = M[4] * x + M[5] * y + M[6]  * z + M[7];
+        out->z = M[8] * x + M[9] * y + M[10] * z + M[11];
+      } else {
+        out->x = x;
+        out->y = y;
+        out->z = z;
+      }
+      out++;
+      if(idx) {
+        *idx++ = (uint32_t)i;
+      }
+    }
+  }
+}
+
+// Cropped chunks cannot be counted without unprojecting, each one is packed
+// at its own pixel offset and counted while doing so, then moved down.
+void PointCloudGenerator::cropChunks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const PointCloudGenerator& self = *job.self;
+  const uint32_t W = self._width, H = self._height;
+  const float* rays = self._rays;
+  const float* M = self.pose();
+  const Crop crop = self._crop;
+  const uint16_t lo = job.lo, hi = job.hi;
+  const float scale = job.scale;
+  for(int c = begin; c < end; c++) {
+    const size_t first = (size_t)c * PC_DENSE_CHUNK_ROWS * W;
+    const size_t last = std::min<size_t>((size_t)(c + 1) * PC_DENSE_CHUNK_ROWS, H) * W;
+    TY_VECT_3F* out = job.point3d + first;
+    uint32_t* idx = job.indices ? job.indices + first : NULL;
+    for(size_t i = first; i < last; i++) {
+      const uint16_t d = job.depth[i];
+      if(d < lo || d > hi) {
+        continue;
+      }
+      const float z = d * scale;
+      float x = rays[2 * i + 0] * z;
+      float y = rays[2 * i + 1] * z;
+      float w = z;
+      if(M) {
+        const float tx = M[0] * x + M[1] * y + M[2]  * z + M[3];
+        const float ty = M[4] * x + M[5] * y + M[6]  * z + M[7];
+        w = M[8] * x + M[9] * y + M[10] * z + M[11];
+        x = tx;
+        y = ty;
+      }
+      if(!crop.contains(x, y, w, z)) {
+        continue;
+      }
+      out->x = x;
+      out->y = y;
+      out->z = w;
+      out++;
+      if(idx) {
+        *idx++ = (uint32_t)i;
+      }
+    }
+    job.offsets[c] = (uint32_t)(out - (job.point3d + first));
+  }
+}
+
+TY_STATUS PointCloudGenerator::computeDense(const uint16_t* depth, TY_VECT_3F* point3d, uint32_t* indices,
+                                            uint32_t* count, float f_scale_unit) const
+{
+  if(!_rays) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !point3d || !count) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  // chunks write disjoint ranges of the output once their offsets are known
+  const int chunks = (int)((_height + PC_DENSE_CHUNK_ROWS - 1) / PC_DENSE_CHUNK_ROWS);
+  if(_offsets.size() < (size_t)chunks) {
+    _offsets.resize(chunks);
+  }
+  uint32_t* offsets = &_offsets[0];
+  Job job = {this, depth, f_scale_unit, 0, 0, point3d, NULL, NULL, NULL, indices, offsets};
+  if(cropping()) {
+    depthWindow(f_scale_unit, &job.lo, &job.hi);
+    TYParallelFor(chunks, _threads, cropChunks, &job);
+    // chunk c moves down to the end of chunk c - 1, in order
+    uint32_t total = 0;
+    for(int c = 0; c < chunks; c++) {
+      const size_t first = (size_t)c * PC_DENSE_CHUNK_ROWS * _width;
+      memmove(point3d + total, point3d + first, offsets[c] * sizeof(TY_VECT_3F));
+      if(indices) {
+        memmove(indices + total, indices + first, offsets[c] * sizeof(uint32_t));
+      }
+      total += offsets[c];
+    }
+    *count = total;
+    return TY_STATUS_OK;
+  }
+  TYParallelFor(chunks, _threads, countChunks, &job);
+  uint32_t total = 0;
+  for(int c = 0; c < chunks; c++) {
+    const uint32_t n = offsets[c];
+    offsets[c] = total;
+    total += n;
+  }
+  TYParallelFor(chunks, _threads, denseChunks, &job);
+  *count = total;
+  return TY_STATUS_OK;
+}
+
+uint32_t PointCloudGenerator::compact(const TY_VECT_3F* points, uint32_t n, TY_VECT_3F* dense, uint32_t* indices)
+{
+  uint32_t k = 0;
+  for(uint32_t i = 0; i < n; i++) {
+    const TY_VECT_3F& p = points[i];
+    if(p.x != p.x || p.y != p.y || p.z != p.z) {
+      continue;
+    }
+    dense[k] = p;
+    if(indices) {
+      indices[k] = i;
+    }
+    k++;
+  }
+  return k;
+}
+
+void PointCloudGenerator::gather(const void* src, size_t size, const uint32_t* indices, uint32_t count, void* dst)
+{
+  const uint8_t* s = (const uint8_t*)src;
+  uint8_t* d = (uint8_t*)dst;
+  for(uint32_t i = 0; i < count; i++, d += size) {
+    memcpy(d, s + (size_t)indices[i] * size, size);
+  }
+}
@@ -0,0 +1,165 @@
+#ifndef XYZ_POINT_CLOUD_GENERATOR_HPP_
+#define XYZ_POINT_CLOUD_GENERATOR_HPP_
+
+#include <vector>
+#include "TYCoordinateMapper.h"
+#include "TableCache.hpp"
+
+/// @brief Depth image to point cloud with a precomputed ray table.
+///
+/// Replacement for TYMapDepthImageToPoint3d. The viewing ray (x / z, y / z)
+/// of every pixel is computed once per calibration and resolution, a frame
+/// is then one multiply per coordinate, rows spread over worker threads.
+///
+/// computeDense() skips invalid pixels instead of writing NaN, consumers of
+/// the packed cloud need no NaN test of their own.
+///
+/// init() with undistort set takes the lens distortion of the calibration
+/// into the rays, the depth image is then used as captured, without
+/// TYUndistortImage first.
+///
+/// Points are in the depth camera frame unless setPose() gives another one,
+/// the transform is then applied in the same pass.
+///
+/// setCropBox() and setDepthRange() limit the output to a workspace. Depth
+/// values that cannot fall inside are rejected before unprojection, the box
+/// test runs on the rest as they are written.
+class PointCloudGenerator
+{
+public:
+    PointCloudGenerator();
+
+    /// @brief Build the ray table, kept as is if calibration and size did not change.
+    /// @param  [in]  calib                 Calibration data of the depth image.
+    /// @param  [in]  width                 Width of depth image.
+    /// @param  [in]  height                Height of depth image.
+    /// @param  [in]  cache                 Optional table cache, the table is mapped from it if present.
+    /// @param  [in]  undistort             Depth images are distorted, as captured, rays undo calib distortion.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NULL_POINTER      calib is NULL.
+    /// @retval TY_STATUS_INVALID_PARAMETER Bad size or intrinsic.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* calib, uint32_t width, uint32_t height,
+                   const TableCache* cache = NULL, bool undistort = false);
+
+    /// @brief Worker threads used by init() and compute(), 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Frame of the output points.
+    /// @param  [in]  chain                 Transforms from the depth camera frame, chain[0] applied
+    ///                                     first, e.g. inverted color extrinsic then hand-eye pose.
+    ///                                     NULL or count 0 for the depth camera frame.
+    /// @param  [in]  count                 Number of transforms.
+    void setPose(const TY_CAMERA_EXTRINSIC* chain, int count);
+
+    /// @brief Keep only points inside a box, the others are NaN or left out of computeDense().
+    /// @param  [in]  min                   Box corner, in the box frame.
+    /// @param  [in]  max                   Opposite box corner.
+    /// @param  [in]  box                   Pose of the box in the output frame, NULL for axis aligned.
+    void setCropBox(const TY_VECT_3F& min, const TY_VECT_3F& max, const TY_CAMERA_EXTRINSIC* box = NULL);
+
+    /// @brief Keep only points with depth camera z in [min, max], same unit as the points.
+    void setDepthRange(float min, float max);
+
+    /// @brief Drop the crop box and depth range.
+    void clearCrop();
+
+    /// @brief Map depth image to 3D points, same output as TYMapDepthImageToPoint3d without pose.
+    /// @param  [in]  depth                 Depth image, width x height.
+    /// @param  [out] point3d               Output point3D image, width x height, NaN for invalid depth.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      depth or point3d is NULL.
+    TY_STATUS compute(const uint16_t* depth, TY_VECT_3F* point3d, float f_scale_unit = 1.0f) const;
+
+    /// @brief Map depth image to x, y and z planes, see PointCloudFormat.hpp.
+    /// @param  [in]  depth                 Depth image, width x height.
+    /// @param  [out] x                     Output x plane, width x height, NaN for invalid depth.
+    /// @param  [out] y                     Output y plane.
+    /// @param  [out] z                     Output z plane.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      An input or output is NULL.
+    TY_STATUS computePlanes(const uint16_t* depth, float* x, float* y, float* z, float f_scale_unit = 1.0f) const;
+
+    /// @brief Map depth image to its valid 3D points only, packed in pixel order.
+    ///        Keeps scratch space in the generator, one call at a time per generator.
+    /// @param  [in]  depth                 Depth image, width x height.
+    /// @param  [out] point3d               Output points, room for width x height, also when cropping.
+    /// @param  [out] indices               Optional, pixel index v * width + u of each output point.
+    /// @param  [out] count                 Number of output points.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      depth, point3d or count is NULL.
+    TY_STATUS computeDense(const uint16_t* depth, TY_VECT_3F* point3d, uint32_t* indices, uint32_t* count,
+                           float f_scale_unit = 1.0f) const;
+
+    /// @brief Drop the NaN points of an organized cloud, may work in place.
+    /// @param  [in]  points                Organized cloud.
+    /// @param  [in]  n                     Number of points.
+    /// @param  [out] dense                 Output points, room for n, may be points.
+    /// @param  [out] indices               Optional, index in points of each output point.
+    /// @return Number of output points.
+    static uint32_t compact(const TY_VECT_3F* points, uint32_t n, TY_VECT_3F* dense, uint32_t* indices);
+
+    /// @brief Pick per pixel elements by index, e.g. the colors of a packed cloud.
+    /// @param  [in]  src                   Per pixel elements.
+    /// @param  [in]  size                  Element size in bytes.
+    /// @param  [in]  indices               Pixel indices.
+    /// @param  [in]  count                 Number of indices.
+    /// @param  [out] dst                   Output, count elements.
+    static void gather(const void* src, size_t size, const uint32_t* indices, uint32_t count, void* dst);
+
+    bool     isValid() const { return _rays != NULL; }
+    bool     undistorts() const { return _undistort; }
+    uint32_t width()   const { return _width; }
+    uint32_t height()  const { return _height; }
+
+    /// @brief Ray table, (x / z, y / z) interleaved per pixel.
+    const float* rays() const { return _rays; }
+
+private:
+    PointCloudGenerator(const PointCloudGenerator&);
+    PointCloudGenerator& operator=(const PointCloudGenerator&);
+
+    struct Job;
+    static void pointsRows(int begin, int end, void* arg);
+    static void planesRows(int begin, int end, void* arg);
+    static void countChunks(int begin, int end, void* arg);
+    static void denseChunks(int begin, int end, void* arg);
+    static void cropChunks(int begin, int end, void* arg);
+
+    const float* pose() const { return _hasPose ? _pose : NULL; }
+    struct Crop
+    {
+        bool       box;
+        float      B[12];               // output frame to box frame
+        float      pose[12];            // box frame to output frame
+        TY_VECT_3F min, max;
+        float      minDepth, maxDepth;
+
+        bool contains(float x, float y, float z, float depthZ) const;
+    };
+
+    bool cropping() const;
+    void depthWindow(float scale, uint16_t* lo, uint16_t* hi) const;
+
+    uint32_t             _width, _height;
+    int                  _threads;
+    bool                 _hasPose;
+    float                _pose[12];     // 3x4 row major
+    bool                 _undistort;
+    Crop                 _crop;
+    TY_CAMERA_CALIB_INFO _calib;
+    const float*         _rays;         // into _table or _file
+    std::vector<float>   _table;
+    MappedFile           _file;
+    mutable std::vector<uint32_t> _offsets;  // per row chunk, computeDense() scratch
+};
+
+/// @brief out = chain[count - 1] * ... * chain[0], identity for count 0.
+void TYComposeExtrinsics(const TY_CAMERA_EXTRINSIC* chain, int count, TY_CAMERA_EXTRINSIC* out);
+
+#endif
@@ -0,0 +1,1825 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "Registration.hpp"
+#include "TYThread.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TY_REG_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TY_REG_SSE2
+// the AVX2 kernel is built anyway and picked at run time
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#define TY_REG_AVX2_DISPATCH
+#define TY_REG_TARGET_AVX2
+#elif defined(__GNUC__)
+#include <immintrin.h>
+#define TY_REG_AVX2_DISPATCH
+#define TY_REG_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TY_REG_NEON
+#endif
+
+// pixels projected per kernel call, keeps the outputs in L1
+#define REG_BLOCK_SIZE  (256)
+// coordinates are clamped before float to int conversion
+#define REG_COORD_LIMIT (1048576.f)
+// splat coordinates are biased by this many pixels so the kernels, which
+// truncate toward zero, floor them near the left and top borders too
+#define REG_SPLAT_OFFSET  (1024)
+// footprint bound, in target pixels, against points right at the target camera
+#define REG_SPLAT_MAX_FOOT  (64)
+
+typedef DepthToColorPlan::Params Params;
+
+static inline TY_IMAGE_ROI fullROI(uint32_t w, uint32_t h)
+{
+  TY_IMAGE_ROI roi = {0, 0, w, h};
+  return roi;
+}
+
+// Project n depth pixels of one row into color image coordinates.
+// u/v are fx * X / Z + cx truncated toward zero as the SDK does, cx/cy
+// carry the rounding bias if any. d is the rounded target depth.
+// Pixels without valid projection get u = v = -1, d = 0.
+static inline void projectRowScalar(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                                    int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  const float* M = P.M;
+  for(int i = 0; i < n; i++) {
+    u[i] = v[i] = -1;
+    d[i] = 0;
+    if(depth[i] == 0) {
+      continue;
+    }
+    const float z = depth[i] * P.scale;
+    const float x = rayX[i] * z;
+    const float y = ry * z;
+    const float X = M[0] * x + M[1] * y + M[2]  * z + M[3];
+    const float Y = M[4] * x + M[5] * y + M[6]  * z + M[7];
+    const float Z = M[8] * x + M[9] * y + M[10] * z + M[11];
+    if(!(Z > 0.f)) {
+      continue;
+    }
+    float fu = P.fx * X / Z + P.cx;
+    float fv = P.fy * Y / Z + P.cy;
+    float fd = Z * P.invScale + 0.5f;
+    fu = fu < -REG_COORD_LIMIT ? -REG_COORD_LIMIT : (fu > REG_COORD_LIMIT ? REG_COORD_LIMIT : fu);
+    fv = fv < -REG_COORD_LIMIT ? -REG_COORD_LIMIT : (fv > REG_COORD_LIMIT ? REG_COORD_LIMIT : fv);
+    fd = fd > REG_COORD_LIMIT ? REG_COORD_LIMIT : fd;
+    u[i] = (int32_t)fu;
+    v[i] = (int32_t)fv;
+    d[i] = (int32_t)fd;
+  }
+}
+
+#if defined(TY_REG_AVX2) || defined(TY_REG_AVX2_DISPATCH)
+
+#ifndef TY_REG_TARGET_AVX2
+#define TY_REG_TARGET_AVX2
+#endif
+
+TY_REG_TARGET_AVX2
+static void projectRowAvx2(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                           int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  const float* M = P.M;
+  const __m256 m0 = _mm256_set1_ps(M[0]), m1 = _mm256_set1_ps(M[1]), m2  = _mm256_set1_ps(M[2]),  m3  = _mm256_set1_ps(M[3]);
+  const __m256 m4 = _mm256_set1_ps(M[4]), m5 = _mm256_set1_ps(M[5]), m6  = _mm256_set1_ps(M[6]),  m7  = _mm256_set1_ps(M[7]);
+  const __m256 m8 = _mm256_set1_ps(M[8]), m9 = _mm256_set1_ps(M[9]), m10 = _mm256_set1_ps(M[10]), m11 = _mm256_set1_ps(M[11]);
+  const __m256 fx = _mm256_set1_ps(P.fx), fy = _mm256_set1_ps(P.fy);
+  const __m256 cx = _mm256_set1_ps(P.cx), cy = _mm256_set1_ps(P.cy);
+  const __m256 scale = _mm256_set1_ps(P.scale), invScale = _mm256_set1_ps(P.invScale);
+  const __m256 half = _mm256_set1_ps(0.5f), zero = _mm256_setzero_ps();
+  const __m256 lo = _mm256_set1_ps(-REG_COORD_LIMIT), hi = _mm256_set1_ps(REG_COORD_LIMIT);
+  const __m256 vry = _mm256_set1_ps(ry);
+  const __m256i invalid = _mm256_set1_epi32(-1);
+
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    __m256 z = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+                  _mm_loadu_si128((const __m128i*)(depth + i)))), scale);
+    __m256 x = _mm256_mul_ps(_mm256_loadu_ps(rayX + i), z);
+    __m256 y = _mm256_mul_ps(vry, z);
+    __m256 X = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, x), _mm256_mul_ps(m1, y)), _mm256_add_ps(_mm256_mul_ps(m2, z), m3));
+    __m256 Y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m4, x), _mm256_mul_ps(m5, y)), _mm256_add_ps(_mm256_mul_ps(m6, z), m7));
+    __m256 Z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m8, x), _mm256_mul_ps(m9, y)), _mm256_add_ps(_mm256_mul_ps(m10, z), m11));
+    __m256 valid = _mm256_and_ps(_mm256_cmp_ps(z, zero, _CMP_GT_OQ), _mm256_cmp_ps(Z, zero, _CMP_GT_OQ));
+    if(_mm256_movemask_ps(valid) == 0) {
+      _mm256_storeu_si256((__m256i*)(u + i), invalid);
+      _mm256_storeu_si256((__m256i*)(v + i), invalid);
+      _mm256_storeu_si256((__m256i*)(d + i), _mm256_setzero_si256());
+      continue;
+    }
+    __m256 fu = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(fx, X), Z), cx);
+    __m256 fv = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(fy, Y), Z), cy);
+    __m256 fd = _mm256_add_ps(_mm256_mul_ps(Z, invScale), half);
+    fu = _mm256_min_ps(_mm256_max_ps(fu, lo), hi);
+    fv = _mm256_min_ps(_mm256_max_ps(fv, lo), hi);
+    fd = _mm256_min_ps(fd, hi);
+    __m256i iv = _mm256_castps_si256(valid);
+    _mm256_storeu_si256((__m256i*)(u + i), _mm256_blendv_epi8(invalid, _mm256_cvttps_epi32(fu), iv));
+    _mm256_storeu_si256((__m256i*)(v + i), _mm256_blendv_epi8(invalid, _mm256_cvttps_epi32(fv), iv));
+    _mm256_storeu_si256((__m256i*)(d + i), _mm256_and_si256(_mm256_cvttps_epi32(fd), iv));
+  }
+  projectRowScalar(P, depth + i, rayX + i, ry, n - i, u + i, v + i, d + i);
+}
+
+#endif
+
+#if defined(TY_REG_AVX2)
+
+static const char* kernelInstructionSet()
+{
+  return "AVX2";
+}
+
+static void projectRow(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                       int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  projectRowAvx2(P, depth, rayX, ry, n, u, v, d);
+}
+
+#elif defined(TY_REG_SSE2)
+
+static inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void projectRowSse2(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                           int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  const float* M = P.M;
+  const __m128 m0 = _mm_set1_ps(M[0]), m1 = _mm_set1_ps(M[1]), m2  = _mm_set1_ps(M[2]),  m3  = _mm_set1_ps(M[3]);
+  const __m128 m4 = _mm_set1_ps(M[4]), m5 = _mm_set1_ps(M[5]), m6  = _mm_set1_ps(M[6]),  m7  = _mm_set1_ps(M[7]);
+  const __m128 m8 = _mm_set1_ps(M[8]), m9 = _mm_set1_ps(M[9]), m10 = _mm_set1_ps(M[10]), m11 = _mm_set1_ps(M[11]);
+  const __m128 fx = _mm_set1_ps(P.fx), fy = _mm_set1_ps(P.fy);
+  const __m128 cx = _mm_set1_ps(P.cx), cy = _mm_set1_ps(P.cy);
+  const __m128 scale = _mm_set1_ps(P.scale), invScale = _mm_set1_ps(P.invScale);
+  const __m128 half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+  const __m128 lo = _mm_set1_ps(-REG_COORD_LIMIT), hi = _mm_set1_ps(REG_COORD_LIMIT);
+  const __m128 vry = _mm_set1_ps(ry);
+  const __m128i invalid = _mm_set1_epi32(-1);
+  const __m128i izero = _mm_setzero_si128();
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    __m128i raw = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), izero);
+    __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(raw), scale);
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(rayX + i), z);
+    __m128 y = _mm_mul_ps(vry, z);
+    __m128 X = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m1, y)), _mm_add_ps(_mm_mul_ps(m2, z), m3));
+    __m128 Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m4, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m6, z), m7));
+    __m128 Z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m8, x), _mm_mul_ps(m9, y)), _mm_add_ps(_mm_mul_ps(m10, z), m11));
+    __m128 valid = _mm_and_ps(_mm_cmpgt_ps(z, zero), _mm_cmpgt_ps(Z, zero));
+    if(_mm_movemask_ps(valid) == 0) {
+      _mm_storeu_si128((__m128i*)(u + i), invalid);
+      _mm_storeu_si128((__m128i*)(v + i), invalid);
+      _mm_storeu_si128((__m128i*)(d + i), izero);
+      continue;
+    }
+    __m128 fu = _mm_add_ps(_mm_div_ps(_mm_mul_ps(fx, X), Z), cx);
+    __m128 fv = _mm_add_ps(_mm_div_ps(_mm_mul_ps(fy, Y), Z), cy);
+    __m128 fd = _mm_add_ps(_mm_mul_ps(Z, invScale), half);
+    fu = _mm_min_ps(_mm_max_ps(fu, lo), hi);
+    fv = _mm_min_ps(_mm_max_ps(fv, lo), hi);
+    fd = _mm_min_ps(fd, hi);
+    __m128i iv = _mm_castps_si128(valid);
+    _mm_storeu_si128((__m128i*)(u + i), select_epi32(iv, _mm_cvttps_epi32(fu), invalid));
+    _mm_storeu_si128((__m128i*)(v + i), select_epi32(iv, _mm_cvttps_epi32(fv), invalid));
+    _mm_storeu_si128((__m128i*)(d + i), _mm_and_si128(_mm_cvttps_epi32(fd), iv));
+  }
+  projectRowScalar(P, depth + i, rayX + i, ry, n - i, u + i, v + i, d + i);
+}
+
+#if defined(TY_REG_AVX2_DISPATCH)
+
+// AVX2 in the cpu and its ymm state saved by the OS.
+static bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  const bool osxsave = (info[2] & (1 << 27)) != 0;
+  const bool avx = (info[2] & (1 << 28)) != 0;
+  if(!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+// checked once, at the first projection
+static bool hasAvx2()
+{
+  static const bool avx2 = cpuHasAvx2();
+  return avx2;
+}
+
+static const char* kernelInstructionSet()
+{
+  return hasAvx2() ? "AVX2" : "SSE2";
+}
+
+static void projectRow(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                       int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  if(hasAvx2()) {
+    projectRowAvx2(P, depth, rayX, ry, n, u, v, d);
+  } else {
+    projectRowSse2(P, depth, rayX, ry, n, u, v, d);
+  }
+}
+
+#else
+
+static const char* kernelInstructionSet()
+{
+  return "SSE2";
+}
+
+static void projectRow(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                       int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  projectRowSse2(P, depth, rayX, ry, n, u, v, d);
+}
+
+#endif
+
+#elif defined(TY_REG_NEON)
+
+static const char* kernelInstructionSet()
+{
+  return "NEON";
+}
+
+static inline float32x4_t div_f32(float32x4_t a, float32x4_t b)
+{
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  float32x4_t r = vrecpeq_f32(b);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  return vmulq_f32(a, r);
+#endif
+}
+
+static void projectRow(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                       int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  const float* M = P.M;
+  const float32x4_t cx = vdupq_n_f32(P.cx), cy = vdupq_n_f32(P.cy);
+  const float32x4_t half = vdupq_n_f32(0.5f), zero = vdupq_n_f32(0.f);
+  const float32x4_t lo = vdupq_n_f32(-REG_COORD_LIMIT), hi = vdupq_n_f32(REG_COORD_LIMIT);
+  const int32x4_t invalid = vdupq_n_s32(-1);
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    float32x4_t z = vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vld1_u16(depth + i))), P.scale);
+    float32x4_t x = vmulq_f32(vld1q_f32(rayX + i), z);
+    float32x4_t y = vmulq_n_f32(z, ry);
+    float32x4_t X = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[3]),  x, M[0]), y, M[1]), z, M[2]);
+    float32x4_t Y = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[7]),  x, M[4]), y, M[5]), z, M[6]);
+    float32x4_t Z = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vdupq_n_f32(M[11]), x, M[8]), y, M[9]), z, M[10]);
+    uint32x4_t valid = vandq_u32(vcgtq_f32(z, zero), vcgtq_f32(Z, zero));
+    float32x4_t fu = vaddq_f32(div_f32(vmulq_n_f32(X, P.fx), Z), cx);
+    float32x4_t fv = vaddq_f32(div_f32(vmulq_n_f32(Y, P.fy), Z), cy);
+    float32x4_t fd = vaddq_f32(vmulq_n_f32(Z, P.invScale), half);
+    fu = vminq_f32(vmaxq_f32(fu, lo), hi);
+    fv = vminq_f32(vmaxq_f32(fv, lo), hi);
+    fd = vminq_f32(vmaxq_f32(fd, zero), hi);
+    vst1q_s32(u + i, vbslq_s32(valid, vcvtq_s32_f32(fu), invalid));
+    vst1q_s32(v + i, vbslq_s32(valid, vcvtq_s32_f32(fv), invalid));
+    vst1q_s32(d + i, vandq_s32(vcvtq_s32_f32(fd), vreinterpretq_s32_u32(valid)));
+  }
+  projectRowScalar(P, depth + i, rayX + i, ry, n - i, u + i, v + i, d + i);
+}
+
+#else
+
+static const char* kernelInstructionSet()
+{
+  return "scalar";
+}
+
+static void projectRow(const Params& P, const uint16_t* depth, const float* rayX, float ry,
+                       int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  projectRowScalar(P, depth, rayX, ry, n, u, v, d);
+}
+
+#endif
+
+// Fixed point projection. Color space X (Y, Z) of depth pixel (u, v, d) is
+// d * A + T in depth units, A = M0 * rayX[u] + M1 * rayY[v] + M2 split into
+// a column and a row part, T = M3 / scale. A is kept in Q20, the product is
+// split in two so it stays in int32 and X comes out in Q12. Only the
+// perspective division is done in float, with a reciprocal estimate.
+#define REG_FIXED_COEF_BITS   (20)
+#define REG_FIXED_BITS        (12)
+// |A| and |T| bounds that keep 65535 * A + T in int32
+#define REG_FIXED_COEF_LIMIT  (2.0)
+#define REG_FIXED_T_LIMIT     (262144.0)
+
+struct FixedRow
+{
+  const int32_t* ax;          // column part of A, Q20
+  const int32_t* ay;
+  const int32_t* az;
+  int32_t bx, by, bz;         // row part of A, Q20
+  int32_t tx, ty, tz;         // T, Q12
+};
+
+// d * a, a in Q20, result in Q12
+static inline int32_t fixedMul(int32_t d, int32_t a)
+{
+  return d * (a >> 8) + ((d * (a & 255)) >> 8);
+}
+
+static inline void projectRowFixedScalar(const Params& P, const FixedRow& R, const uint16_t* depth,
+                                         int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  for(int i = 0; i < n; i++) {
+    u[i] = v[i] = -1;
+    d[i] = 0;
+    if(depth[i] == 0) {
+      continue;
+    }
+    const int32_t X = fixedMul(depth[i], R.ax[i] + R.bx) + R.tx;
+    const int32_t Y = fixedMul(depth[i], R.ay[i] + R.by) + R.ty;
+    const int32_t Z = fixedMul(depth[i], R.az[i] + R.bz) + R.tz;
+    if(Z <= 0) {
+      continue;
+    }
+    const float r = 1.f / (float)Z;
+    float fu = P.fx * (X * r) + P.cx;
+    float fv = P.fy * (Y * r) + P.cy;
+    fu = fu < -REG_COORD_LIMIT ? -REG_COORD_LIMIT : (fu > REG_COORD_LIMIT ? REG_COORD_LIMIT : fu);
+    fv = fv < -REG_COORD_LIMIT ? -REG_COORD_LIMIT : (fv > REG_COORD_LIMIT ? REG_COORD_LIMIT : fv);
+    u[i] = (int32_t)fu;
+    v[i] = (int32_t)fv;
+    d[i] = (Z + (1 << (REG_FIXED_BITS - 1))) >> REG_FIXED_BITS;
+  }
+}
+
+#if defined(TY_REG_NEON)
+
+static inline int32x4_t fixedMul_s32(int32x4_t d, int32x4_t a, int32x4_t acc)
+{
+  const int32x4_t lo = vandq_s32(a, vdupq_n_s32(255));
+  return vaddq_s32(vmlaq_s32(acc, d, vshrq_n_s32(a, 8)), vshrq_n_s32(vmulq_s32(d, lo), 8));
+}
+
+static void projectRowFixed(const Params& P, const FixedRow& R, const uint16_t* depth,
+                            int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  const int32x4_t bx = vdupq_n_s32(R.bx), by = vdupq_n_s32(R.by), bz = vdupq_n_s32(R.bz);
+  const int32x4_t tx = vdupq_n_s32(R.tx), ty = vdupq_n_s32(R.ty), tz = vdupq_n_s32(R.tz);
+  const float32x4_t cx = vdupq_n_f32(P.cx), cy = vdupq_n_f32(P.cy);
+  const float32x4_t lo = vdupq_n_f32(-REG_COORD_LIMIT), hi = vdupq_n_f32(REG_COORD_LIMIT);
+  const int32x4_t izero = vdupq_n_s32(0);
+  const int32x4_t round = vdupq_n_s32(1 << (REG_FIXED_BITS - 1));
+  const int32x4_t invalid = vdupq_n_s32(-1);
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    int32x4_t dv = vreinterpretq_s32_u32(vmovl_u16(vld1_u16(depth + i)));
+    int32x4_t X = fixedMul_s32(dv, vaddq_s32(vld1q_s32(R.ax + i), bx), tx);
+    int32x4_t Y = fixedMul_s32(dv, vaddq_s32(vld1q_s32(R.ay + i), by), ty);
+    int32x4_t Z = fixedMul_s32(dv, vaddq_s32(vld1q_s32(R.az + i), bz), tz);
+    uint32x4_t valid = vandq_u32(vcgtq_s32(dv, izero), vcgtq_s32(Z, izero));
+    // one Newton step on the estimate, relative error about 2^-16
+    float32x4_t fZ = vcvtq_f32_s32(Z);
+    float32x4_t r = vrecpeq_f32(fZ);
+    r = vmulq_f32(vrecpsq_f32(fZ, r), r);
+    float32x4_t fu = vmlaq_n_f32(cx, vmulq_f32(vcvtq_f32_s32(X), r), P.fx);
+    float32x4_t fv = vmlaq_n_f32(cy, vmulq_f32(vcvtq_f32_s32(Y), r), P.fy);
+    fu = vminq_f32(vmaxq_f32(fu, lo), hi);
+    fv = vminq_f32(vmaxq_f32(fv, lo), hi);
+    vst1q_s32(u + i, vbslq_s32(valid, vcvtq_s32_f32(fu), invalid));
+    vst1q_s32(v + i, vbslq_s32(valid, vcvtq_s32_f32(fv), invalid));
+    vst1q_s32(d + i, vandq_s32(vshrq_n_s32(vaddq_s32(Z, round), REG_FIXED_BITS), vreinterpretq_s32_u32(valid)));
+  }
+  FixedRow tail = R;
+  tail.ax += i;
+  tail.ay += i;
+  tail.az += i;
+  projectRowFixedScalar(P, tail, depth + i, n - i, u + i, v + i, d + i);
+}
+
+#else
+
+static void projectRowFixed(const Params& P, const FixedRow& R, const uint16_t* depth,
+                            int n, int32_t* u, int32_t* v, int32_t* d)
+{
+  projectRowFixedScalar(P, R, depth, n, u, v, d);
+}
+
+#endif
+
+// Intrinsic is given at intrinsicWidth x intrinsicHeight, scale it to the
+// actual image resolution.
+static TY_STATUS scaledIntrinsic(const TY_CAMERA_CALIB_INFO* calib, uint32_t w, uint32_t h,
+                                 float& fx, float& fy, float& cx, float& cy)
+{
+  if(!calib->intrinsicWidth || !calib->intrinsicHeight) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  const float* K = calib->intrinsic.data;
+  const float sx = 1.0f * w / calib->intrinsicWidth;
+  const float sy = 1.0f * h / calib->intrinsicHeight;
+  fx = K[0] * sx;
+  cx = K[2] * sx;
+  fy = K[4] * sy;
+  cy = K[5] * sy;
+  return (fx == 0.f || fy == 0.f) ? TY_STATUS_INVALID_PARAMETER : TY_STATUS_OK;
+}
+
+// A depth pixel at depth z covers about (fx / dfx) * (z / Z) pixels of the
+// target image, Z its depth in the target camera. The splat footprint is
+// one pixel wider than that spacing, so slanted surfaces, whose neighbour
+// pixels land further apart, do not crack either. P is set up so the
+// kernels give 2 * (REG_SPLAT_OFFSET + fu) truncated, half pixels, and
+// splatSpans() takes the first pixel of the footprint, ceil(fu - foot / 2),
+// from that once the footprint of the point is known.
+static void splatFootprint(float dfx, float dfy, Params& P, float& scaleX, float& scaleY)
+{
+  scaleX = fabsf(P.fx / dfx);
+  scaleY = fabsf(P.fy / dfy);
+  P.fx *= 2.0f;
+  P.fy *= 2.0f;
+  P.cx = 2.0f * (P.cx + REG_SPLAT_OFFSET);
+  P.cy = 2.0f * (P.cy + REG_SPLAT_OFFSET);
+}
+
+// Turn the kernel outputs of n points, half pixel u/v, into the first pixel
+// x/y and the size foot (width | height << 16) of their footprints, d is
+// left as is. Widens minY/maxY to the target rows the points reach.
+static void splatSpansScalar(const uint16_t* depth, int n, float scaleX, float scaleY,
+                             int32_t* u, int32_t* v, const int32_t* d, int32_t* foot, int32_t& minY, int32_t& maxY)
+{
+  for(int i = 0; i < n; i++) {
+    if((uint32_t)(d[i] - 1) >= 0xffff) {
+      continue;
+    }
+    const float ratio = (float)depth[i] / (float)d[i];
+    const int32_t footW = (int32_t)std::min(scaleX * ratio, REG_SPLAT_MAX_FOOT - 1.0f) + 1;
+    const int32_t footH = (int32_t)std::min(scaleY * ratio, REG_SPLAT_MAX_FOOT - 1.0f) + 1;
+    u[i] = ((u[i] - footW) >> 1) + 1 - REG_SPLAT_OFFSET;
+    v[i] = ((v[i] - footH) >> 1) + 1 - REG_SPLAT_OFFSET;
+    foot[i] = footW | (footH << 16);
+    minY = v[i] < minY ? v[i] : minY;
+    maxY = v[i] + footH - 1 > maxY ? v[i] + footH - 1 : maxY;
+  }
+}
+
+#if defined(TY_REG_AVX2) || defined(TY_REG_SSE2)
+
+#if defined(TY_REG_AVX2)
+static inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+// SSE2 in AVX2 builds too, 4 lanes are plenty next to the scatter
+
+static void splatSpans(const uint16_t* depth, int n, float scaleX, float scaleY,
+                       int32_t* u, int32_t* v, const int32_t* d, int32_t* foot, int32_t& minY, int32_t& maxY)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i dmax = _mm_set1_epi32(0x10000);
+  const __m128i bias = _mm_set1_epi32(1 - REG_SPLAT_OFFSET);
+  const __m128 sx = _mm_set1_ps(scaleX), sy = _mm_set1_ps(scaleY);
+  const __m128 fmax = _mm_set1_ps(REG_SPLAT_MAX_FOOT - 1.0f);
+  __m128i lo = _mm_set1_epi32(minY), hi = _mm_set1_epi32(maxY);
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    const __m128i dv = _mm_loadu_si128((const __m128i*)(d + i));
+    const __m128i valid = _mm_and_si128(_mm_cmpgt_epi32(dv, zero), _mm_cmplt_epi32(dv, dmax));
+    const __m128i z = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), zero);
+    const __m128 ratio = _mm_div_ps(_mm_cvtepi32_ps(z), _mm_cvtepi32_ps(select_epi32(valid, dv, one)));
+    const __m128i fw = _mm_add_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(sx, ratio), fmax)), one);
+    const __m128i fh = _mm_add_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(sy, ratio), fmax)), one);
+    const __m128i x = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(u + i)), fw), 1), bias);
+    const __m128i y = _mm_add_epi32(_mm_srai_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(v + i)), fh), 1), bias);
+    const __m128i bottom = _mm_sub_epi32(_mm_add_epi32(y, fh), one);
+    // invalid lanes keep their kernel output, they are skipped by d
+    _mm_storeu_si128((__m128i*)(u + i), select_epi32(valid, x, _mm_loadu_si128((const __m128i*)(u + i))));
+    _mm_storeu_si128((__m128i*)(v + i), select_epi32(valid, y, _mm_loadu_si128((const __m128i*)(v + i))));
+    _mm_storeu_si128((__m128i*)(foot + i), _mm_or_si128(fw, _mm_slli_epi32(fh, 16)));
+    lo = select_epi32(_mm_and_si128(valid, _mm_cmplt_epi32(y, lo)), y, lo);
+    hi = select_epi32(_mm_and_si128(valid, _mm_cmpgt_epi32(bottom, hi)), bottom, hi);
+  }
+  int32_t l[4], h[4];
+  _mm_storeu_si128((__m128i*)l, lo);
+  _mm_storeu_si128((__m128i*)h, hi);
+  for(int k = 0; k < 4; k++) {
+    minY = l[k] < minY ? l[k] : minY;
+    maxY = h[k] > maxY ? h[k] : maxY;
+  }
+  splatSpansScalar(depth + i, n - i, scaleX, scaleY, u + i, v + i, d + i, foot + i, minY, maxY);
+}
+
+#elif defined(TY_REG_NEON)
+
+static void splatSpans(const uint16_t* depth, int n, float scaleX, float scaleY,
+                       int32_t* u, int32_t* v, const int32_t* d, int32_t* foot, int32_t& minY, int32_t& maxY)
+{
+  const int32x4_t one = vdupq_n_s32(1);
+  const int32x4_t bias = vdupq_n_s32(1 - REG_SPLAT_OFFSET);
+  const uint32x4_t dmax = vdupq_n_u32(0xffff);
+  const float32x4_t fmax = vdupq_n_f32(REG_SPLAT_MAX_FOOT - 1.0f);
+  int32x4_t lo = vdupq_n_s32(minY), hi = vdupq_n_s32(maxY);
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    const int32x4_t dv = vld1q_s32(d + i);
+    const uint32x4_t valid = vcltq_u32(vreinterpretq_u32_s32(vsubq_s32(dv, one)), dmax);
+    const float32x4_t z = vcvtq_f32_u32(vmovl_u16(vld1_u16(depth + i)));
+    const float32x4_t dd = vcvtq_f32_s32(vbslq_s32(valid, dv, one));
+    // two Newton steps, the footprint only needs the integer part
+    float32x4_t r = vrecpeq_f32(dd);
+    r = vmulq_f32(vrecpsq_f32(dd, r), r);
+    r = vmulq_f32(vrecpsq_f32(dd, r), r);
+    const float32x4_t ratio = vmulq_f32(z, r);
+    const int32x4_t fw = vaddq_s32(vcvtq_s32_f32(vminq_f32(vmulq_n_f32(ratio, scaleX), fmax)), one);
+    const int32x4_t fh = vaddq_s32(vcvtq_s32_f32(vminq_f32(vmulq_n_f32(ratio, scaleY), fmax)), one);
+    const int32x4_t uv = vld1q_s32(u + i);
+    const int32x4_t vv = vld1q_s32(v + i);
+    const int32x4_t x = vaddq_s32(vshrq_n_s32(vsubq_s32(uv, fw), 1), bias);
+    const int32x4_t y = vaddq_s32(vshrq_n_s32(vsubq_s32(vv, fh), 1), bias);
+    const int32x4_t bottom = vsubq_s32(vaddq_s32(y, fh), one);
+    // invalid lanes keep their kernel output, they are skipped by d
+    vst1q_s32(u + i, vbslq_s32(valid, x, uv));
+    vst1q_s32(v + i, vbslq_s32(valid, y, vv));
+    vst1q_s32(foot + i, vorrq_s32(fw, vshlq_n_s32(fh, 16)));
+    lo = vbslq_s32(valid, vminq_s32(lo, y), lo);
+    hi = vbslq_s32(valid, vmaxq_s32(hi, bottom), hi);
+  }
+  int32_t l[4], h[4];
+  vst1q_s32(l, lo);
+  vst1q_s32(h, hi);
+  for(int k = 0; k < 4; k++) {
+    minY = l[k] < minY ? l[k] : minY;
+    maxY = h[k] > maxY ? h[k] : maxY;
+  }
+  splatSpansScalar(depth + i, n - i, scaleX, scaleY, u + i, v + i, d + i, foot + i, minY, maxY);
+}
+
+#else
+
+static void splatSpans(const uint16_t* depth, int n, float scaleX, float scaleY,
+                       int32_t* u, int32_t* v, const int32_t* d, int32_t* foot, int32_t& minY, int32_t& maxY)
+{
+  splatSpansScalar(depth, n, scaleX, scaleY, u, v, d, foot, minY, maxY);
+}
+
+#endif
+
+// Separable unprojection rays of the depth camera, pixel (u, v) at depth z
+// is (rayX[u] * z, rayY[v] * z, z).
+static TY_STATUS buildRays(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                           std::vector<float>& rayX, std::vector<float>& rayY)
+{
+  float fx, fy, cx, cy;
+  TY_STATUS status = scaledIntrinsic(depth_calib, depthW, depthH, fx, fy, cx, cy);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  rayX.resize(depthW);
+  for(uint32_t u = 0; u < depthW; u++) {
+    rayX[u] = (u - cx) / fx;
+  }
+  rayY.resize(depthH);
+  for(uint32_t v = 0; v < depthH; v++) {
+    rayY[v] = (v - cy) / fy;
+  }
+  return TY_STATUS_OK;
+}
+
+// Projection from depth camera space into a mappedW x mappedH color image,
+// without rounding bias.
+static TY_STATUS buildProjection(const TY_CAMERA_CALIB_INFO* color_calib, uint32_t mappedW, uint32_t mappedH,
+                                 float f_scale_unit, Params& P)
+{
+  TY_CAMERA_EXTRINSIC extri_inv;
+  TY_STATUS status = TYInvertExtrinsic(&color_calib->extrinsic, &extri_inv);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  status = scaledIntrinsic(color_calib, mappedW, mappedH, P.fx, P.fy, P.cx, P.cy);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  memcpy(P.M, extri_inv.data, sizeof(P.M));
+  P.scale = f_scale_unit;
+  P.invScale = 1.0f / f_scale_unit;
+  return TY_STATUS_OK;
+}
+
+DepthToColorPlan::DepthToColorPlan()
+  : _valid(false)
+  , _fixedValid(false)
+  , _kernel(KERNEL_FLOAT)
+  , _splat(false)
+  , _fillHoles(true)
+  , _depthW(0), _depthH(0)
+  , _mappedW(0), _mappedH(0)
+  , _threads(0)
+  , _splatScaleX(1.f), _splatScaleY(1.f)
+{
+  memset(&_params, 0, sizeof(_params));
+  memset(&_lutParams, 0, sizeof(_lutParams));
+  memset(&_splatParams, 0, sizeof(_splatParams));
+  memset(_fixT, 0, sizeof(_fixT));
+}
+
+TY_STATUS DepthToColorPlan::init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                                 const TY_CAMERA_CALIB_INFO* color_calib, uint32_t mappedW, uint32_t mappedH,
+                                 float f_scale_unit)
+{
+  _valid = false;
+  if(!depth_calib || !color_calib) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!depthW || !depthH || !mappedW || !mappedH || !(f_scale_unit > 0.f)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  TY_STATUS status = buildRays(depth_calib, depthW, depthH, _rayX, _rayY);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  status = buildProjection(color_calib, mappedW, mappedH, f_scale_unit, _lutParams);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  // depth image rounds to the nearest pixel, lookup table truncates like
+  // TYMapPoint3dToDepth
+  _params = _lutParams;
+  _params.cx += 0.5f;
+  _params.cy += 0.5f;
+  _fixedValid = buildFixed(depthW, depthH);
+
+  float dfx, dfy, dcx, dcy;
+  scaledIntrinsic(depth_calib, depthW, depthH, dfx, dfy, dcx, dcy);
+  _splatParams = _lutParams;
+  splatFootprint(dfx, dfy, _splatParams, _splatScaleX, _splatScaleY);
+
+  _depthW  = depthW;
+  _depthH  = depthH;
+  _mappedW = mappedW;
+  _mappedH = mappedH;
+  _valid   = true;
+  return TY_STATUS_OK;
+}
+
+bool DepthToColorPlan::buildFixed(uint32_t depthW, uint32_t depthH)
+{
+  const float* M = _lutParams.M;
+  const double q = (double)(1 << REG_FIXED_COEF_BITS);
+  _fixCol.resize(3 * depthW);
+  _fixRow.resize(3 * depthH);
+  bool inRange = true;
+  for(int k = 0; k < 3; k++) {
+    const float* m = M + 4 * k;
+    // A is linear in the rays, the corners bound it
+    const double x0 = m[0] * _rayX[0], x1 = m[0] * _rayX[depthW - 1];
+    const double y0 = m[1] * _rayY[0] + m[2], y1 = m[1] * _rayY[depthH - 1] + m[2];
+    const double aMax = std::max(std::max(fabs(x0 + y0), fabs(x0 + y1)), std::max(fabs(x1 + y0), fabs(x1 + y1)));
+    const double t = m[3] / _lutParams.scale;
+    inRange = inRange && aMax < REG_FIXED_COEF_LIMIT && fabs(t) < REG_FIXED_T_LIMIT;
+
+    for(uint32_t u = 0; u < depthW; u++) {
+      _fixCol[k * depthW + u] = (int32_t)floor(m[0] * _rayX[u] * q + 0.5);
+    }
+    for(uint32_t v = 0; v < depthH; v++) {
+      _fixRow[k * depthH + v] = (int32_t)floor((m[1] * _rayY[v] + m[2]) * q + 0.5);
+    }
+    _fixT[k] = (int32_t)floor(t * (1 << REG_FIXED_BITS) + 0.5);
+  }
+  return inRange;
+}
+
+const char* DepthToColorPlan::instructionSet()
+{
+  return kernelInstructionSet();
+}
+
+TY_STATUS DepthToColorPlan::setKernel(Kernel kernel)
+{
+  if(kernel != KERNEL_FLOAT && _valid && !_fixedValid) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  _kernel = kernel;
+  return TY_STATUS_OK;
+}
+
+void DepthToColorPlan::projectBlock(const Params& P, const uint16_t* depth, uint32_t row, uint32_t col,
+                                    int n, int32_t* u, int32_t* v, int32_t* d) const
+{
+  if(_kernel != KERNEL_FLOAT && _fixedValid) {
+    FixedRow R;
+    R.ax = &_fixCol[col];
+    R.ay = &_fixCol[_depthW + col];
+    R.az = &_fixCol[2 * _depthW + col];
+    R.bx = _fixRow[row];
+    R.by = _fixRow[_depthH + row];
+    R.bz = _fixRow[2 * _depthH + row];
+    R.tx = _fixT[0];
+    R.ty = _fixT[1];
+    R.tz = _fixT[2];
+    if(_kernel == KERNEL_FIXED_SCALAR) {
+      projectRowFixedScalar(P, R, depth, n, u, v, d);
+    } else {
+      projectRowFixed(P, R, depth, n, u, v, d);
+    }
+  } else {
+    projectRow(P, depth, &_rayX[col], _rayY[row], n, u, v, d);
+  }
+}
+
+TY_STATUS DepthToColorPlan::execute(const uint16_t* depth, uint16_t* mappedDepth)
+{
+  return execute(depth, fullROI(_depthW, _depthH), fullROI(_mappedW, _mappedH), mappedDepth);
+}
+
+TY_STATUS DepthToColorPlan::execute(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi,
+                                    const TY_IMAGE_ROI& mappedRoi, uint16_t* mappedDepth)
+{
+  if(!_valid) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !mappedDepth) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!TYImageROIInside(&depthRoi, _depthW, _depthH) || !TYImageROIInside(&mappedRoi, _mappedW, _mappedH)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  memset(mappedDepth, 0, sizeof(uint16_t) * mappedRoi.w * mappedRoi.h);
+  if(_splat) {
+    splatBlocks(depth, depthRoi, mappedRoi, mappedDepth);
+    return TY_STATUS_OK;
+  }
+
+  int32_t u[REG_BLOCK_SIZE], v[REG_BLOCK_SIZE], d[REG_BLOCK_SIZE];
+  for(uint32_t row = depthRoi.y; row < depthRoi.y + depthRoi.h; row++) {
+    const uint16_t* src = depth + (size_t)row * _depthW;
+    for(uint32_t col = depthRoi.x; col < depthRoi.x + depthRoi.w; col += REG_BLOCK_SIZE) {
+      const uint32_t left = depthRoi.x + depthRoi.w - col;
+      int n = (int)(left < REG_BLOCK_SIZE ? left : REG_BLOCK_SIZE);
+      projectBlock(_params, src + col, row, col, n, u, v, d);
+      for(int i = 0; i < n; i++) {
+        const uint32_t x = (uint32_t)(u[i] - (int32_t)mappedRoi.x);
+        const uint32_t y = (uint32_t)(v[i] - (int32_t)mappedRoi.y);
+        if((uint32_t)(d[i] - 1) >= 0xffff || u[i] < 0 || v[i] < 0
+            || x >= mappedRoi.w || y >= mappedRoi.h) {
+          continue;
+        }
+        uint16_t& dst = mappedDepth[(size_t)y * mappedRoi.w + x];
+        if(dst == 0 || d[i] < dst) {
+          dst = (uint16_t)d[i];
+        }
+      }
+    }
+  }
+
+  // same hole filling TYMapPoint3dToDepthImage applies after projection
+  if(!_fillHoles) {
+    return TY_STATUS_OK;
+  }
+  return TYDepthImageFillEmptyRegion(mappedDepth, mappedRoi.w, mappedRoi.h);
+}
+
+struct DepthToColorPlan::SplatJob
+{
+  DepthToColorPlan* plan;
+  const uint16_t*   depth;
+  TY_IMAGE_ROI      depthRoi;
+  TY_IMAGE_ROI      mappedRoi;
+  uint16_t*         mappedDepth;
+};
+
+// project row r of the depth region into scratch row slot
+void DepthToColorPlan::splatProjectRow(const SplatJob& job, uint32_t r, uint32_t slot)
+{
+  const uint32_t W = job.depthRoi.w;
+  const uint32_t row = job.depthRoi.y + r;
+  const uint16_t* src = job.depth + (size_t)row * _depthW + job.depthRoi.x;
+  int32_t* u = &_splatRows[(size_t)4 * slot * W];
+  int32_t* v = u + W;
+  int32_t* d = v + W;
+  int32_t* foot = d + W;
+  int32_t minY = (int32_t)(job.mappedRoi.y + job.mappedRoi.h), maxY = -1;
+  for(uint32_t col = 0; col < W; col += REG_BLOCK_SIZE) {
+    int n = (int)(W - col < REG_BLOCK_SIZE ? W - col : REG_BLOCK_SIZE);
+    projectBlock(_splatParams, src + col, row, job.depthRoi.x + col, n, u + col, v + col, d + col);
+    splatSpans(src + col, n, _splatScaleX, _splatScaleY, u + col, v + col, d + col, foot + col, minY, maxY);
+  }
+  _splatMinY[slot] = minY;
+  _splatMaxY[slot] = maxY;
+}
+
+// z-buffer scratch row slot into mapped image rows [yBegin, yEnd)
+void DepthToColorPlan::splatRow(const SplatJob& job, uint32_t slot, int yBegin, int yEnd) const
+{
+  const int mx = (int)job.mappedRoi.x;
+  const int my = (int)job.mappedRoi.y;
+  if(_splatMaxY[slot] < yBegin + my || _splatMinY[slot] >= yEnd + my) {
+    return;
+  }
+  const uint32_t W = job.depthRoi.w;
+  const int w = (int)job.mappedRoi.w;
+  const int32_t* u = &_splatRows[(size_t)4 * slot * W];
+  const int32_t* v = u + W;
+  const int32_t* d = v + W;
+  const int32_t* foot = d + W;
+  for(uint32_t i = 0; i < W; i++) {
+    if((uint32_t)(d[i] - 1) >= 0xffff) {
+      continue;
+    }
+    const int x = u[i] - mx;
+    const int y = v[i] - my;
+    const int x0 = x < 0 ? 0 : x;
+    const int y0 = y < yBegin ? yBegin : y;
+    const int x1 = x + (foot[i] & 0xffff) > w ? w : x + (foot[i] & 0xffff);
+    const int y1 = y + (foot[i] >> 16) > yEnd ? yEnd : y + (foot[i] >> 16);
+    const uint16_t z = (uint16_t)d[i];
+    for(int yy = y0; yy < y1; yy++) {
+      uint16_t* dst = job.mappedDepth + (size_t)yy * w;
+      for(int xx = x0; xx < x1; xx++) {
+        if(dst[xx] == 0 || z < dst[xx]) {
+          dst[xx] = z;
+        }
+      }
+    }
+  }
+}
+
+void DepthToColorPlan::splatProjectRange(int begin, int end, void* arg)
+{
+  SplatJob* job = (SplatJob*)arg;
+  for(int r = begin; r < end; r++) {
+    job->plan->splatProjectRow(*job, r, r);
+  }
+}
+
+void DepthToColorPlan::splatScatterRange(int begin, int end, void* arg)
+{
+  SplatJob* job = (SplatJob*)arg;
+  // this worker owns mapped rows [begin, end), only depth rows reaching
+  // them are scanned and only pixels inside them are written
+  for(uint32_t r = 0; r < job->depthRoi.h; r++) {
+    job->plan->splatRow(*job, r, begin, end);
+  }
+}
+
+void DepthToColorPlan::splatBlocks(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi,
+                                   const TY_IMAGE_ROI& mappedRoi, uint16_t* mappedDepth)
+{
+  SplatJob job;
+  job.plan = this;
+  job.depth = depth;
+  job.depthRoi = depthRoi;
+  job.mappedRoi = mappedRoi;
+  job.mappedDepth = mappedDepth;
+  const int threads = _threads > 0 ? _threads : TYThreadHardwareConcurrency();
+  const uint32_t slots = threads > 1 ? depthRoi.h : 1;
+  if(_splatRows.size() < (size_t)4 * depthRoi.w * slots) {
+    _splatRows.resize((size_t)4 * depthRoi.w * slots);
+  }
+  if(_splatMinY.size() < slots) {
+    _splatMinY.resize(slots);
+    _splatMaxY.resize(slots);
+  }
+
+  if(threads > 1) {
+    TYParallelFor((int)depthRoi.h, threads, splatProjectRange, &job);
+    TYParallelFor((int)mappedRoi.h, threads, splatScatterRange, &job);
+    return;
+  }
+  // one pass through one scratch row, each row is splatted while its
+  // projection is in cache
+  for(uint32_t r = 0; r < depthRoi.h; r++) {
+    splatProjectRow(job, r, 0);
+    splatRow(job, 0, 0, (int)mappedRoi.h);
+  }
+}
+
+TY_STATUS DepthToColorPlan::createLookupTable(const uint16_t* depth, TY_PIXEL_DESC* lut)
+{
+  return createLookupTable(depth, fullROI(_depthW, _depthH), lut);
+}
+
+TY_STATUS DepthToColorPlan::createLookupTable(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi, TY_PIXEL_DESC* lut)
+{
+  if(!_valid) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !lut) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!TYImageROIInside(&depthRoi, _depthW, _depthH)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  int32_t u[REG_BLOCK_SIZE], v[REG_BLOCK_SIZE], d[REG_BLOCK_SIZE];
+  for(uint32_t r = 0; r < depthRoi.h; r++) {
+    const uint32_t row = depthRoi.y + r;
+    const uint16_t* src = depth + (size_t)row * _depthW + depthRoi.x;
+    TY_PIXEL_DESC* dst = lut + (size_t)r * depthRoi.w;
+    for(uint32_t col = 0; col < depthRoi.w; col += REG_BLOCK_SIZE) {
+      int n = (int)(depthRoi.w - col < REG_BLOCK_SIZE ? depthRoi.w - col : REG_BLOCK_SIZE);
+      projectBlock(_lutParams, src + col, row, depthRoi.x + col, n, u, v, d);
+      for(int i = 0; i < n; i++) {
+        dst[col + i].x = (int16_t)u[i];
+        dst[col + i].y = (int16_t)v[i];
+        dst[col + i].depth = (uint16_t)d[i];
+      }
+    }
+  }
+  return TY_STATUS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+struct ColorPixelsToDepthPlan::Job
+{
+  const ColorPixelsToDepthPlan* plan;
+  const uint16_t* depth;
+  const TY_PIXEL_COLOR_DESC* src;
+  TY_PIXEL_COLOR_DESC* dst;
+};
+
+// below this many queries per thread spawning workers costs more than it saves
+#define PIXELS_PER_THREAD_MIN (32)
+
+ColorPixelsToDepthPlan::ColorPixelsToDepthPlan()
+  : _valid(false)
+  , _depthW(0), _depthH(0)
+  , _rgbW(0), _rgbH(0)
+  , _zMin(0.f), _zMax(0.f)
+  , _scale(1.0f)
+  , _threads(0)
+  , _maxDelta(10)
+{
+  memset(_R, 0, sizeof(_R));
+  memset(_t, 0, sizeof(_t));
+  _cfx = _cfy = _ccx = _ccy = 0.f;
+  _dfx = _dfy = _dcx = _dcy = 0.f;
+}
+
+TY_STATUS ColorPixelsToDepthPlan::init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                                       const TY_CAMERA_CALIB_INFO* color_calib, uint32_t rgbW, uint32_t rgbH,
+                                       uint32_t min_distance, uint32_t max_distance,
+                                       float f_scale_unit)
+{
+  _valid = false;
+  if(!depth_calib || !color_calib) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!depthW || !depthH || !rgbW || !rgbH || !(f_scale_unit > 0.f)
+      || min_distance == 0 || max_distance <= min_distance) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  TY_STATUS status = scaledIntrinsic(color_calib, rgbW, rgbH, _cfx, _cfy, _ccx, _ccy);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  status = scaledIntrinsic(depth_calib, depthW, depthH, _dfx, _dfy, _dcx, _dcy);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+
+  // color extrinsic maps color space points into depth space
+  const float* E = color_calib->extrinsic.data;
+  for(int r = 0; r < 3; r++) {
+    _R[r * 3 + 0] = E[r * 4 + 0];
+    _R[r * 3 + 1] = E[r * 4 + 1];
+    _R[r * 3 + 2] = E[r * 4 + 2];
+    _t[r] = E[r * 4 + 3];
+  }
+
+  // same candidates as TYMapRGBPixelsToDepthCoordinate, [min, max) depth units
+  _zMin = min_distance * f_scale_unit;
+  _zMax = (max_distance - 1) * f_scale_unit;
+  _scale = f_scale_unit;
+  _depthW = depthW;
+  _depthH = depthH;
+  _rgbW = rgbW;
+  _rgbH = rgbH;
+  _valid = true;
+  return TY_STATUS_OK;
+}
+
+void ColorPixelsToDepthPlan::search(const uint16_t* depth, const TY_PIXEL_COLOR_DESC& src, TY_PIXEL_COLOR_DESC& dst) const
+{
+  dst.x = -1;
+  dst.y = -1;
+
+  // ray of the color pixel in depth space: P(z) = A * z + t
+  const float rx = (src.x - _ccx) / _cfx;
+  const float ry = (src.y - _ccy) / _cfy;
+  const float A[3] = {
+    _R[0] * rx + _R[1] * ry + _R[2],
+    _R[3] * rx + _R[4] * ry + _R[5],
+    _R[6] * rx + _R[7] * ry + _R[8]
+  };
+
+  // extent of the epipolar segment decides the sample count, two samples
+  // per depth pixel crossed, never more than one per depth unit
+  float ends[2][2];
+  const float zEnds[2] = { _zMin, _zMax };
+  for(int i = 0; i < 2; i++) {
+    const float Z = A[2] * zEnds[i] + _t[2];
+    if(!(Z > 0.f)) {
+      return;
+    }
+    ends[i][0] = _dfx * (A[0] * zEnds[i] + _t[0]) / Z + _dcx;
+    ends[i][1] = _dfy * (A[1] * zEnds[i] + _t[1]) / Z + _dcy;
+  }
+  const float du = fabsf(ends[1][0] - ends[0][0]);
+  const float dv = fabsf(ends[1][1] - ends[0][1]);
+  int steps = (int)(2.f * (du > dv ? du : dv)) + 1;
+  const int units = (int)((_zMax - _zMin) / _scale) + 1;
+  if(steps > units) {
+    steps = units;
+  }
+
+  // image position along the epipolar line is close to linear in inverse
+  // depth, so sample there
+  const float wMin = 1.f / _zMax;
+  const float wMax = 1.f / _zMin;
+  uint32_t best = 0xffffffff;
+  float zPrev = _zMin;
+  float dPrev = (A[2] * zPrev + _t[2]) / _scale;
+  for(int k = 1; k <= steps; k++) {
+    const float z = (k == steps) ? _zMax : 1.f / (wMax + (wMin - wMax) * k / steps);
+    const float d = (A[2] * z + _t[2]) / _scale;
+
+    const float zm = 0.5f * (zPrev + z);
+    const float Z = A[2] * zm + _t[2];
+    const float pu = _dfx * (A[0] * zm + _t[0]) / Z + _dcx;
+    const float pv = _dfy * (A[1] * zm + _t[1]) / Z + _dcy;
+    const float lo = dPrev < d ? dPrev : d;
+    const float hi = dPrev < d ? d : dPrev;
+    zPrev = z;
+    dPrev = d;
+    if(!(Z > 0.f) || !(pu >= 0.f && pu < _depthW && pv >= 0.f && pv < _depthH)) {
+      continue;
+    }
+
+    const int px = (int)pu;
+    const int py = (int)pv;
+    const uint16_t D = depth[py * _depthW + px];
+    if(D == 0) {
+      continue;
+    }
+    // closest ray depth inside this pixel to the measured one
+    float delta = 0.f;
+    if(D < lo) {
+      delta = lo - D;
+    } else if(D > hi) {
+      delta = D - hi;
+    }
+    const uint32_t idelta = (uint32_t)(delta + 0.5f);
+    if(idelta < best) {
+      best = idelta;
+      if(best < _maxDelta) {
+        dst.x = (int16_t)px;
+        dst.y = (int16_t)py;
+        dst.bgr_ch1 = src.bgr_ch1;
+        dst.bgr_ch2 = src.bgr_ch2;
+        dst.bgr_ch3 = src.bgr_ch3;
+      }
+      if(best == 0) {
+        break;
+      }
+    }
+  }
+}
+
+void ColorPixelsToDepthPlan::executeRange(int begin, int end, void* arg)
+{
+  Job* job = (Job*)arg;
+  for(int i = begin; i < end; i++) {
+    job->plan->search(job->depth, job->src[i], job->dst[i]);
+  }
+}
+
+TY_STATUS ColorPixelsToDepthPlan::execute(const uint16_t* depth, const TY_PIXEL_COLOR_DESC* src, uint32_t cnt,
+                                          TY_PIXEL_COLOR_DESC* dst) const
+{
+  if(!_valid) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth || !src || !dst) {
+    return TY_STATUS_NULL_POINTER;
+  }
+
+  Job job;
+  job.plan = this;
+  job.depth = depth;
+  job.src = src;
+  job.dst = dst;
+
+  int threads = _threads > 0 ? _threads : TYThreadHardwareConcurrency();
+  const int maxThreads = (int)(cnt / PIXELS_PER_THREAD_MIN);
+  if(threads > maxThreads) {
+    threads = maxThreads > 0 ? maxThreads : 1;
+  }
+  TYParallelFor((int)cnt, threads, executeRange, &job);
+  return TY_STATUS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+#define INDEX_MAP_EMPTY (~(uint64_t)0)
+
+ColorToDepthIndexMap::ColorToDepthIndexMap()
+  : _valid(false)
+  , _built(false)
+  , _depthW(0), _depthH(0)
+  , _colorW(0), _colorH(0)
+  , _scaleX(1.f), _scaleY(1.f)
+  , _threads(0)
+{
+  memset(&_params, 0, sizeof(_params));
+}
+
+TY_STATUS ColorToDepthIndexMap::init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                                     const TY_CAMERA_CALIB_INFO* color_calib, uint32_t colorW, uint32_t colorH,
+                                     float f_scale_unit)
+{
+  _valid = false;
+  _built = false;
+  if(!depth_calib || !color_calib) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!depthW || !depthH || !colorW || !colorH || !(f_scale_unit > 0.f)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  TY_STATUS status = buildRays(depth_calib, depthW, depthH, _rayX, _rayY);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  status = buildProjection(color_calib, colorW, colorH, f_scale_unit, _params);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+
+  // same footprint as DepthToColorPlan::setSplat(), so upsampled color
+  // resolutions have no holes
+  float dfx, dfy, dcx, dcy;
+  scaledIntrinsic(depth_calib, depthW, depthH, dfx, dfy, dcx, dcy);
+  splatFootprint(dfx, dfy, _params, _scaleX, _scaleY);
+
+  _depth.resize((size_t)depthW * depthH);
+  _zbuffer.resize((size_t)colorW * colorH);
+  _proj.resize((size_t)4 * depthW);
+  _rowMinY.resize(1);
+  _rowMaxY.resize(1);
+  _depthW = depthW;
+  _depthH = depthH;
+  _colorW = colorW;
+  _colorH = colorH;
+  _valid = true;
+  return TY_STATUS_OK;
+}
+
+// project depth row into scratch row slot
+void ColorToDepthIndexMap::projectDepthRow(uint32_t row, uint32_t slot)
+{
+  const uint32_t W = _depthW;
+  const uint16_t* src = &_depth[(size_t)row * W];
+  int32_t* u = &_proj[(size_t)4 * slot * W];
+  int32_t* v = u + W;
+  int32_t* d = v + W;
+  int32_t* foot = d + W;
+  int32_t minY = (int32_t)_colorH, maxY = -1;
+  for(uint32_t col = 0; col < W; col += REG_BLOCK_SIZE) {
+    int n = (int)(W - col < REG_BLOCK_SIZE ? W - col : REG_BLOCK_SIZE);
+    projectRow(_params, src + col, &_rayX[col], _rayY[row], n, u + col, v + col, d + col);
+    splatSpans(src + col, n, _scaleX, _scaleY, u + col, v + col, d + col, foot + col, minY, maxY);
+  }
+  _rowMinY[slot] = minY;
+  _rowMaxY[slot] = maxY;
+}
+
+// z-buffer depth row, projected in scratch row slot, into color rows [yBegin, yEnd)
+void ColorToDepthIndexMap::scatterDepthRow(uint32_t row, uint32_t slot, int yBegin, int yEnd)
+{
+  if(_rowMaxY[slot] < yBegin || _rowMinY[slot] >= yEnd) {
+    return;
+  }
+  const uint32_t W = _depthW;
+  const int colorW = (int)_colorW;
+  const int32_t* u = &_proj[(size_t)4 * slot * W];
+  const int32_t* v = u + W;
+  const int32_t* d = v + W;
+  const int32_t* foot = d + W;
+  for(uint32_t i = 0; i < W; i++) {
+    if((uint32_t)(d[i] - 1) >= 0xffff) {
+      continue;
+    }
+    // nearest surface wins, ties go to the lower depth pixel index
+    const uint64_t key = ((uint64_t)d[i] << 32) | (uint32_t)(row * W + i);
+    const int x = u[i];
+    const int y = v[i];
+    const int x0 = x < 0 ? 0 : x;
+    const int y0 = y < yBegin ? yBegin : y;
+    const int x1 = x + (foot[i] & 0xffff) > colorW ? colorW : x + (foot[i] & 0xffff);
+    const int y1 = y + (foot[i] >> 16) > yEnd ? yEnd : y + (foot[i] >> 16);
+    for(int y = y0; y < y1; y++) {
+      uint64_t* dst = &_zbuffer[(size_t)y * colorW];
+      for(int x = x0; x < x1; x++) {
+        if(key < dst[x]) {
+          dst[x] = key;
+        }
+      }
+    }
+  }
+}
+
+void ColorToDepthIndexMap::projectRange(int begin, int end, void* arg)
+{
+  ColorToDepthIndexMap* map = (ColorToDepthIndexMap*)arg;
+  for(int row = begin; row < end; row++) {
+    map->projectDepthRow(row, row);
+  }
+}
+
+void ColorToDepthIndexMap::scatterRange(int begin, int end, void* arg)
+{
+  ColorToDepthIndexMap* map = (ColorToDepthIndexMap*)arg;
+  std::fill(&map->_zbuffer[0] + (size_t)begin * map->_colorW, &map->_zbuffer[0] + (size_t)end * map->_colorW,
+            INDEX_MAP_EMPTY);
+  // this worker owns color rows [begin, end), only depth rows reaching
+  // them are scanned and only pixels inside them are written
+  for(uint32_t row = 0; row < map->_depthH; row++) {
+    map->scatterDepthRow(row, row, begin, end);
+  }
+}
+
+TY_STATUS ColorToDepthIndexMap::build(const uint16_t* depth)
+{
+  if(!_valid) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!depth) {
+    return TY_STATUS_NULL_POINTER;
+  }
+
+  memcpy(&_depth[0], depth, sizeof(uint16_t) * _depth.size());
+  const int threads = _threads > 0 ? _threads : TYThreadHardwareConcurrency();
+  if(threads > 1) {
+    if(_rowMinY.size() < _depthH) {
+      _proj.resize((size_t)4 * _depthW * _depthH);
+      _rowMinY.resize(_depthH);
+      _rowMaxY.resize(_depthH);
+    }
+    TYParallelFor((int)_depthH, threads, projectRange, this);
+    TYParallelFor((int)_colorH, threads, scatterRange, this);
+  } else {
+    // one pass through one scratch row, each row is scattered while its
+    // projection is in cache
+    std::fill(_zbuffer.begin(), _zbuffer.end(), INDEX_MAP_EMPTY);
+    for(uint32_t row = 0; row < _depthH; row++) {
+      projectDepthRow(row, 0);
+      scatterDepthRow(row, 0, 0, (int)_colorH);
+    }
+  }
+  _built = true;
+  return TY_STATUS_OK;
+}
+
+TY_PIXEL_DESC ColorToDepthIndexMap::depthPixel(int x, int y) const
+{
+  TY_PIXEL_DESC pix;
+  pix.x = -1;
+  pix.y = -1;
+  pix.depth = 0;
+  pix.rsvd = 0;
+  if(!_built || x < 0 || y < 0 || x >= (int)_colorW || y >= (int)_colorH) {
+    return pix;
+  }
+  const uint64_t key = _zbuffer[(size_t)y * _colorW + x];
+  if(key == INDEX_MAP_EMPTY) {
+    return pix;
+  }
+  const uint32_t idx = (uint32_t)key;
+  pix.x = (int16_t)(idx % _depthW);
+  pix.y = (int16_t)(idx / _depthW);
+  pix.depth = _depth[idx];
+  return pix;
+}
+
+TY_STATUS ColorToDepthIndexMap::mapPixels(const TY_PIXEL_DESC* colorPixels, uint32_t cnt, TY_PIXEL_DESC* depthPixels) const
+{
+  if(!_built) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!colorPixels || !depthPixels) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  for(uint32_t i = 0; i < cnt; i++) {
+    depthPixels[i] = depthPixel(colorPixels[i].x, colorPixels[i].y);
+  }
+  return TY_STATUS_OK;
+}
+
+TY_STATUS ColorToDepthIndexMap::mapPixelsToPoint3d(const TY_PIXEL_DESC* colorPixels, uint32_t cnt, TY_VECT_3F* points) const
+{
+  if(!_built) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!colorPixels || !points) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  for(uint32_t i = 0; i < cnt; i++) {
+    const TY_PIXEL_DESC pix = depthPixel(colorPixels[i].x, colorPixels[i].y);
+    if(pix.depth == 0) {
+      points[i].x = points[i].y = points[i].z = NAN;
+      continue;
+    }
+    const float z = pix.depth * _params.scale;
+    points[i].x = _rayX[pix.x] * z;
+    points[i].y = _rayY[pix.y] * z;
+    points[i].z = z;
+  }
+  return TY_STATUS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+struct PixelsOverlapResolver::Job
+{
+  TY_PIXEL_DESC* lut;
+  uint32_t lutW, lutH;
+  uint32_t imageW, imageH;
+  uint16_t tolerance;
+  uint16_t* zbuffer;
+  uint16_t* filled;
+  int32_t* rowMinY;       // target row span of each lookup table row
+  int32_t* rowMaxY;
+};
+
+PixelsOverlapResolver::PixelsOverlapResolver()
+  : _threads(0)
+  , _tolerance(10)
+{
+}
+
+size_t PixelsOverlapResolver::scratchSize(uint32_t lutH, uint32_t imageW, uint32_t imageH)
+{
+  return sizeof(uint16_t) * 2 * imageW * imageH + sizeof(int32_t) * 2 * lutH;
+}
+
+void PixelsOverlapResolver::rowBoundsRange(int begin, int end, void* arg)
+{
+  Job* job = (Job*)arg;
+  for(int r = begin; r < end; r++) {
+    const TY_PIXEL_DESC* p = job->lut + (size_t)r * job->lutW;
+    int32_t minY = (int32_t)job->imageH, maxY = -1;
+    for(uint32_t i = 0; i < job->lutW; i++) {
+      if(p[i].depth && p[i].x >= 0 && p[i].y >= 0 && p[i].x < (int)job->imageW && p[i].y < (int)job->imageH) {
+        minY = p[i].y < minY ? p[i].y : minY;
+        maxY = p[i].y > maxY ? p[i].y : maxY;
+      }
+    }
+    job->rowMinY[r] = minY;
+    job->rowMaxY[r] = maxY;
+  }
+}
+
+void PixelsOverlapResolver::scatterRange(int begin, int end, void* arg)
+{
+  Job* job = (Job*)arg;
+  const uint32_t W = job->imageW;
+  memset(job->zbuffer + (size_t)begin * W, 0, sizeof(uint16_t) * W * (end - begin));
+  // this worker owns image rows [begin, end), only table rows reaching them
+  // are scanned and only pixels inside them are written
+  for(uint32_t r = 0; r < job->lutH; r++) {
+    if(job->rowMaxY[r] < begin || job->rowMinY[r] >= end) {
+      continue;
+    }
+    const TY_PIXEL_DESC* p = job->lut + (size_t)r * job->lutW;
+    for(uint32_t i = 0; i < job->lutW; i++) {
+      if(!p[i].depth || p[i].y < begin || p[i].y >= end || p[i].x < 0 || p[i].x >= (int)W) {
+        continue;
+      }
+      uint16_t& z = job->zbuffer[(size_t)p[i].y * W + p[i].x];
+      if(z == 0 || z >= p[i].depth) {
+        z = p[i].depth;
+      }
+    }
+  }
+}
+
+void PixelsOverlapResolver::fillRange(int begin, int end, void* arg)
+{
+  // same rule as TYDepthImageFillEmptyRegion: border is cleared, an empty
+  // pixel without horizontal neighbours takes its vertical neighbours,
+  // averaged when they are close, otherwise the upper one
+  Job* job = (Job*)arg;
+  const int W = (int)job->imageW;
+  const int H = (int)job->imageH;
+  for(int y = begin; y < end; y++) {
+    const uint16_t* in = job->zbuffer + (size_t)y * W;
+    uint16_t* out = job->filled + (size_t)y * W;
+    if(y == 0 || y == H - 1) {
+      memset(out, 0, sizeof(uint16_t) * W);
+      continue;
+    }
+    out[0] = 0;
+    out[W - 1] = 0;
+    for(int x = 1; x < W - 1; x++) {
+      if(in[x]) {
+        out[x] = in[x];
+        continue;
+      }
+      out[x] = 0;
+      if(in[x - 1] + in[x + 1] >= 2) {
+        continue;
+      }
+      const int up = in[x - W];
+      const int down = in[x + W];
+      const int diff = up > down ? up - down : down - up;
+      if(diff < 20) {
+        out[x] = (uint16_t)((up + down) / 2);
+      } else {
+        out[x] = (uint16_t)(up ? up : down);
+      }
+    }
+  }
+}
+
+void PixelsOverlapResolver::invalidateRange(int begin, int end, void* arg)
+{
+  Job* job = (Job*)arg;
+  for(int r = begin; r < end; r++) {
+    TY_PIXEL_DESC* p = job->lut + (size_t)r * job->lutW;
+    for(uint32_t i = 0; i < job->lutW; i++) {
+      if(p[i].x < 0 || p[i].y < 0 || p[i].x >= (int)job->imageW || p[i].y >= (int)job->imageH) {
+        continue;
+      }
+      const int32_t delt = p[i].depth - job->filled[(size_t)p[i].y * job->imageW + p[i].x];
+      if(p[i].depth && delt > job->tolerance) {
+        p[i].x = -1;
+        p[i].y = -1;
+        p[i].depth = 0;
+      }
+    }
+  }
+}
+
+TY_STATUS PixelsOverlapResolver::resolve(TY_PIXEL_DESC* lut, uint32_t lutW, uint32_t lutH,
+                                         uint32_t imageW, uint32_t imageH, void* scratch)
+{
+  if(!lut) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!lutW || !lutH || !imageW || !imageH) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  if(!scratch) {
+    _scratch.resize(scratchSize(lutH, imageW, imageH));
+    scratch = &_scratch[0];
+  }
+
+  Job job;
+  job.lut = lut;
+  job.lutW = lutW;
+  job.lutH = lutH;
+  job.imageW = imageW;
+  job.imageH = imageH;
+  job.tolerance = _tolerance;
+  job.zbuffer = (uint16_t*)scratch;
+  job.filled = job.zbuffer + (size_t)imageW * imageH;
+  job.rowMinY = (int32_t*)(job.filled + (size_t)imageW * imageH);
+  job.rowMaxY = job.rowMinY + lutH;
+
+  TYParallelFor((int)lutH, _threads, rowBoundsRange, &job);
+  TYParallelFor((int)imageH, _threads, scatterRange, &job);
+  TYParallelFor((int)imageH, _threads, fillRange, &job);
+  TYParallelFor((int)lutH, _threads, invalidateRange, &job);
+  return TY_STATUS_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+ImageToDepthRegistration::ImageToDepthRegistration()
+  : _updated(false)
+  , _bilinear(false)
+  , _distorted(false)
+  , _threads(0)
+  , _imageW(0), _imageH(0)
+{
+  memset(&_colorCalib, 0, sizeof(_colorCalib));
+  _roi = fullROI(0, 0);
+}
+
+TY_STATUS ImageToDepthRegistration::init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                                         const TY_CAMERA_CALIB_INFO* color_calib, uint32_t imageW, uint32_t imageH,
+                                         float f_scale_unit)
+{
+  _updated = false;
+  if(!imageW || !imageH) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  // lookup table is built at depth resolution, like the SDK inlines
+  TY_STATUS status = _plan.init(depth_calib, depthW, depthH, color_calib, depthW, depthH, f_scale_unit);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+
+  _roi = fullROI(depthW, depthH);
+  _lut.resize((size_t)depthW * depthH);
+  _tab.resize(depthW + depthH);
+  TYCreateMapScaleTable(depthW, imageW, &_tab[0]);
+  TYCreateMapScaleTable(depthH, imageH, &_tab[depthW]);
+  _bilinearTab.resize(depthW + depthH);
+  TYCreateMapBilinearTable(depthW, imageW, &_bilinearTab[0]);
+  TYCreateMapBilinearTable(depthH, imageH, &_bilinearTab[depthW]);
+  _imageW = imageW;
+  _imageH = imageH;
+  _colorCalib = *color_calib;
+  if(_distorted) {
+    return setDistortedSource(true);
+  }
+  return TY_STATUS_OK;
+}
+
+TY_STATUS ImageToDepthRegistration::setDistortedSource(bool enable)
+{
+  if(!_plan.isValid()) {
+    return TY_STATUS_NOT_INITED;
+  }
+  _distorted = false;
+  if(!enable) {
+    return TY_STATUS_OK;
+  }
+  // the table only depends on the interpolation, any bilinear format will do
+  TY_STATUS status = _undistortion.init(&_colorCalib, _imageW, _imageH, TY_PIXEL_FORMAT_RGB);
+  _distorted = status == TY_STATUS_OK;
+  return status;
+}
+
+TY_STATUS ImageToDepthRegistration::setROI(const TY_IMAGE_ROI* depthRoi)
+{
+  if(!_plan.isValid()) {
+    return TY_STATUS_NOT_INITED;
+  }
+  TY_IMAGE_ROI roi = depthRoi ? *depthRoi : fullROI(_plan.depthWidth(), _plan.depthHeight());
+  if(!TYImageROIInside(&roi, _plan.depthWidth(), _plan.depthHeight())) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  _roi = roi;
+  _lut.resize((size_t)_roi.w * _roi.h);
+  _updated = false;
+  return TY_STATUS_OK;
+}
+
+TY_STATUS ImageToDepthRegistration::update(const uint16_t* depth)
+{
+  _updated = false;
+  if(!_plan.isValid()) {
+    return TY_STATUS_NOT_INITED;
+  }
+  TY_STATUS status = _plan.createLookupTable(depth, _roi, &_lut[0]);
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  status = _resolver.resolve(&_lut[0], _roi.w, _roi.h,
+                             _plan.depthWidth(), _plan.depthHeight());
+  if(status != TY_STATUS_OK) {
+    return status;
+  }
+  _updated = true;
+  return TY_STATUS_OK;
+}
+
+// BT.601 video range YUV to BGR, same fixed point constants as OpenCV
+// cvtColor YUV2BGR_YUYV uses so both paths give the same colors
+#define YUV_SHIFT   (20)
+#define YUV_CY      (1220542)
+#define YUV_CUB     (2116026)
+#define YUV_CUG     (-409993)
+#define YUV_CVG     (-852492)
+#define YUV_CVR     (1673527)
+
+static inline uint8_t clampU8(int v)
+{
+  return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+struct YUV422Sampler
+{
+  const uint8_t* buf;
+  size_t stride;
+  int uIdx, vIdx;     // byte offset of U and V in the 4-byte macro pixel
+
+  inline void operator()(uint32_t x, uint32_t y, uint8_t* bgr) const
+  {
+    const uint8_t* p = buf + y * stride + (x & ~1u) * 2;
+    const int Y = p[(x & 1) * 2] - 16;
+    const int U = p[uIdx] - 128;
+    const int V = p[vIdx] - 128;
+    const int y1 = (Y < 0 ? 0 : Y) * YUV_CY;
+    const int round = 1 << (YUV_SHIFT - 1);
+    bgr[0] = clampU8((y1 + YUV_CUB * U + round) >> YUV_SHIFT);
+    bgr[1] = clampU8((y1 + YUV_CVG * V + YUV_CUG * U + round) >> YUV_SHIFT);
+    bgr[2] = clampU8((y1 + YUV_CVR * V + round) >> YUV_SHIFT);
+  }
+};
+
+struct Bayer8Sampler
+{
+  const uint8_t* buf;
+  int width, height;
+  int redX, redY;     // position of the red pixel in the 2x2 pattern
+
+  inline int at(int x, int y) const
+  {
+    // mirror at the border so the neighbour keeps the same color
+    x = x < 0 ? 1 : (x >= width ? width - 2 : x);
+    y = y < 0 ? 1 : (y >= height ? height - 2 : y);
+    return buf[(size_t)y * width + x];
+  }
+
+  // bilinear demosaic of a single pixel
+  inline void operator()(uint32_t ux, uint32_t uy, uint8_t* bgr) const
+  {
+    const int x = (int)ux, y = (int)uy;
+    const int c = at(x, y);
+    const bool redRow = (y & 1) == redY;
+    const bool redCol = (x & 1) == redX;
+    const int cross = (at(x - 1, y) + at(x + 1, y) + at(x, y - 1) + at(x, y + 1) + 2) >> 2;
+    const int diag = (at(x - 1, y - 1) + at(x + 1, y - 1) + at(x - 1, y + 1) + at(x + 1, y + 1) + 2) >> 2;
+    const int horz = (at(x - 1, y) + at(x + 1, y) + 1) >> 1;
+    const int vert = (at(x, y - 1) + at(x, y + 1) + 1) >> 1;
+    if(redRow && redCol) {
+      bgr[0] = (uint8_t)diag;  bgr[1] = (uint8_t)cross; bgr[2] = (uint8_t)c;
+    } else if(!redRow && !redCol) {
+      bgr[0] = (uint8_t)c;     bgr[1] = (uint8_t)cross; bgr[2] = (uint8_t)diag;
+    } else if(redRow) {
+      bgr[0] = (uint8_t)vert;  bgr[1] = (uint8_t)c;     bgr[2] = (uint8_t)horz;
+    } else {
+      bgr[0] = (uint8_t)horz;  bgr[1] = (uint8_t)c;     bgr[2] = (uint8_t)vert;
+    }
+  }
+};
+
+template <typename Sampler>
+struct RawMapJob
+{
+  const TY_PIXEL_DESC* lut;
+  uint32_t lutW;
+  uint32_t depthW, depthH;
+  const uint16_t* tabX;
+  const uint16_t* tabY;
+  const UndistortionPlan* undistortion;   // NULL for an undistorted source
+  uint32_t imageW;
+  Sampler sampler;
+  uint8_t* out;
+};
+
+template <typename Sampler>
+static void mapRawRows(int begin, int end, void* arg)
+{
+  const RawMapJob<Sampler>* job = (const RawMapJob<Sampler>*)arg;
+  for(int r = begin; r < end; r++) {
+    const TY_PIXEL_DESC* plut = job->lut + (size_t)r * job->lutW;
+    uint8_t* outPtr = job->out + (size_t)r * job->lutW * 3;
+    for(uint32_t c = 0; c < job->lutW; c++, plut++, outPtr += 3) {
+      if(plut->x < 0 || plut->x >= (int)job->depthW || plut->y < 0 || plut->y >= (int)job->depthH) {
+        outPtr[0] = outPtr[1] = outPtr[2] = 0;
+      } else {
+        job->sampler(job->tabX[plut->x], job->tabY[plut->y], outPtr);
+      }
+    }
+  }
+}
+
+// Raw source as captured: the undistorted pixel of each table entry is
+// moved to the raw pixel nearest to where it comes from, then sampled.
+template <typename Sampler>
+static void mapRawDistortedRows(int begin, int end, void* arg)
+{
+  const RawMapJob<Sampler>* job = (const RawMapJob<Sampler>*)arg;
+  int32_t pixels[256];
+  for(int r = begin; r < end; r++) {
+    const TY_PIXEL_DESC* plut = job->lut + (size_t)r * job->lutW;
+    uint8_t* outPtr = job->out + (size_t)r * job->lutW * 3;
+    for(uint32_t c0 = 0; c0 < job->lutW; c0 += 256) {
+      const uint32_t n = job->lutW - c0 < 256 ? job->lutW - c0 : 256;
+      for(uint32_t i = 0; i < n; i++) {
+        const TY_PIXEL_DESC& e = plut[c0 + i];
+        pixels[i] = (e.x < 0 || e.x >= (int)job->depthW || e.y < 0 || e.y >= (int)job->depthH) ? -1
+                  : (int32_t)((uint32_t)job->tabY[e.y] * job->imageW + job->tabX[e.x]);
+      }
+      job->undistortion->nearestSource(pixels, n, pixels);
+      for(uint32_t i = 0; i < n; i++, outPtr += 3) {
+        if(pixels[i] < 0) {
+          outPtr[0] = outPtr[1] = outPtr[2] = 0;
+        } else {
+          job->sampler(pixels[i] % job->imageW, pixels[i] / job->imageW, outPtr);
+        }
+      }
+    }
+  }
+}
+
+template <typename Sampler>
+static void mapRaw(const TY_PIXEL_DESC* lut, uint32_t lutW, uint32_t lutH,
+                   uint32_t depthW, uint32_t depthH, const uint16_t* tab,
+                   const UndistortionPlan* undistortion, uint32_t imageW,
+                   const Sampler& sampler, uint8_t* out, int threads)
+{
+  RawMapJob<Sampler> job;
+  job.lut = lut;
+  job.lutW = lutW;
+  job.depthW = depthW;
+  job.depthH = depthH;
+  job.tabX = tab;
+  job.tabY = tab + depthW;
+  job.undistortion = undistortion;
+  job.imageW = imageW;
+  job.sampler = sampler;
+  job.out = out;
+  TYParallelFor((int)lutH, threads, undistortion ? mapRawDistortedRows<Sampler> : mapRawRows<Sampler>, &job);
+}
+
+TY_STATUS ImageToDepthRegistration::mapRaw(const TY_IMAGE_DATA* image, uint8_t* mappedBgr) const
+{
+  if(!_updated) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!image || !image->buffer || !mappedBgr) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if((uint32_t)image->width != _imageW || (uint32_t)image->height != _imageH) {
+    return TY_STATUS_WRONG_SIZE;
+  }
+
+  const uint32_t depthW = _plan.depthWidth();
+  const uint32_t depthH = _plan.depthHeight();
+  const UndistortionPlan* undistortion = _distorted ? &_undistortion : NULL;
+  switch(image->pixelFormat) {
+    case TY_PIXEL_FORMAT_YUYV:
+    case TY_PIXEL_FORMAT_YVYU: {
+      YUV422Sampler s;
+      s.buf = (const uint8_t*)image->buffer;
+      s.stride = (size_t)_imageW * 2;
+      s.uIdx = image->pixelFormat == TY_PIXEL_FORMAT_YUYV ? 1 : 3;
+      s.vIdx = image->pixelFormat == TY_PIXEL_FORMAT_YUYV ? 3 : 1;
+      ::mapRaw(&_lut[0], _roi.w, _roi.h, depthW, depthH, &_tab[0], undistortion, _imageW,
+                   s, mappedBgr, _threads);
+      return TY_STATUS_OK;
+    }
+    case TY_PIXEL_FORMAT_BAYER8GBRG:
+    case TY_PIXEL_FORMAT_BAYER8BGGR:
+    case TY_PIXEL_FORMAT_BAYER8GRBG:
+    case TY_PIXEL_FORMAT_BAYER8RGGB: {
+      if(_imageW < 2 || _imageH < 2) {
+        return TY_STATUS_WRONG_SIZE;
+      }
+      Bayer8Sampler s;
+      s.buf = (const uint8_t*)image->buffer;
+      s.width = (int)_imageW;
+      s.height = (int)_imageH;
+      switch(image->pixelFormat) {
+        case TY_PIXEL_FORMAT_BAYER8GBRG: s.redX = 0; s.redY = 1; break;
+        case TY_PIXEL_FORMAT_BAYER8BGGR: s.redX = 1; s.redY = 1; break;
+        case TY_PIXEL_FORMAT_BAYER8GRBG: s.redX = 1; s.redY = 0; break;
+        default:                         s.redX = 0; s.redY = 0; break;
+      }
+      ::mapRaw(&_lut[0], _roi.w, _roi.h, depthW, depthH, &_tab[0], undistortion, _imageW,
+                   s, mappedBgr, _threads);
+      return TY_STATUS_OK;
+    }
+    default:
+      return TY_STATUS_WRONG_TYPE;
+  }
+}
@@ -0,0 +1,549 @@
+#ifndef XYZ_REGISTRATION_HPP_
+#define XYZ_REGISTRATION_HPP_
+
+#include <vector>
+#include "TYCoordinateMapper.h"
+#include "TYThread.hpp"
+#include "UndistortionPlan.hpp"
+
+/// @brief Depth image to color coordinate registration plan.
+///
+/// Same result as TYMapDepthImageToColorCoordinate, but everything that only
+/// depends on the calibration (inverted color extrinsic, scaled intrinsics,
+/// unprojection rays) is prepared once in init(). execute() does not allocate,
+/// so one plan per camera can run at frame rate.
+///
+/// Each depth pixel is unprojected, moved to color space, projected and
+/// z-buffered in registers (SSE2 on x86, AVX2 when the cpu has it, NEON on
+/// ARM), without the intermediate TY_VECT_3F frame the SDK path sweeps
+/// three times.
+class DepthToColorPlan
+{
+public:
+    /// Projection kernel, see setKernel().
+    enum Kernel
+    {
+        KERNEL_FLOAT,           ///< float, default
+        KERNEL_FIXED,           ///< int32 transform, float reciprocal estimate
+        KERNEL_FIXED_SCALAR,    ///< KERNEL_FIXED without SIMD, reference for its checks
+    };
+
+    DepthToColorPlan();
+
+    /// @brief Build the plan.
+    /// @param  [in]  depth_calib           Depth image's calibration data.
+    /// @param  [in]  depthW                Width of depth image.
+    /// @param  [in]  depthH                Height of depth image.
+    /// @param  [in]  color_calib           Color image's calibration data.
+    /// @param  [in]  mappedW               Width of target depth image.
+    /// @param  [in]  mappedH               Height of target depth image.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                   const TY_CAMERA_CALIB_INFO* color_calib, uint32_t mappedW, uint32_t mappedH,
+                   float f_scale_unit = 1.0f);
+
+    /// @brief Map depth image to color coordinate.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @param  [out] mappedDepth           Output depth image, mappedW x mappedH. Cleared before mapping.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Plan not initialized.
+    TY_STATUS execute(const uint16_t* depth, uint16_t* mappedDepth);
+
+    /// @brief Map a region of depth image to a region of color coordinate depth image.
+    ///        Only depth pixels inside depthRoi are projected, output is sized to mappedRoi.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @param  [in]  depthRoi              Region of depth image to map.
+    /// @param  [in]  mappedRoi             Region of target depth image to output.
+    /// @param  [out] mappedDepth           Output depth image, mappedRoi.w x mappedRoi.h. Cleared before mapping.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Plan not initialized.
+    /// @retval TY_STATUS_INVALID_PARAMETER Region outside of image.
+    TY_STATUS execute(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi,
+                      const TY_IMAGE_ROI& mappedRoi, uint16_t* mappedDepth);
+
+    /// @brief Create depth image to color coordinate lookup table.
+    ///        Same layout as TYCreateDepthToColorCoordinateLookupTable,
+    ///        invalid depth pixels get (-1, -1, 0).
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @param  [out] lut                   Output lookup table, depthW x depthH.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Plan not initialized.
+    TY_STATUS createLookupTable(const uint16_t* depth, TY_PIXEL_DESC* lut);
+
+    /// @brief Create lookup table of a region of depth image.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @param  [in]  depthRoi              Region of depth image.
+    /// @param  [out] lut                   Output lookup table, depthRoi.w x depthRoi.h.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Plan not initialized.
+    /// @retval TY_STATUS_INVALID_PARAMETER Region outside of depth image.
+    TY_STATUS createLookupTable(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi, TY_PIXEL_DESC* lut);
+
+    /// @brief Select the projection kernel, kept across init().
+    ///
+    /// KERNEL_FIXED folds the depth rays into the extrinsic and runs the
+    /// transform on int32 (Q20 coefficients, Q12 result), only the
+    /// perspective division is float, one Newton step on the reciprocal
+    /// estimate. Use it on ARM with NEON only, where it is the fast path.
+    /// Keep the default KERNEL_FLOAT on x86: the float kernel runs on SSE2 or
+    /// AVX2 there while the fixed one runs scalar and is slower.
+    /// Against KERNEL_FLOAT, projected coordinates stay within 1/32 pixel
+    /// for images up to 2048 wide, so an integer coordinate moves by at most
+    /// one pixel and only for points that close to a pixel border; mapped
+    /// depth is within 1 unit. KERNEL_FIXED_SCALAR gives the same depth as
+    /// KERNEL_FIXED, coordinates may differ by one pixel where the NEON
+    /// reciprocal estimate rounds across a pixel border.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_INVALID_PARAMETER Calibration out of the fixed point range
+    ///                                     (|translation / scale| >= 262144), float kept.
+    TY_STATUS setKernel(Kernel kernel);
+    Kernel    kernel()       const { return _kernel; }
+
+    /// @brief Splat each depth pixel over its footprint, kept across init().
+    ///
+    /// A depth pixel lands on about (mapped fx / depth fx) * (depth / mapped
+    /// depth) mapped pixels. With splatting on, execute() z-buffers it over
+    /// a footprint one pixel wider than that, so a mapped image larger than
+    /// the depth image, e.g. at full color resolution, comes out without
+    /// holes in one pass instead of one pixel per depth pixel followed by
+    /// TYDepthImageFillEmptyRegion. Near surfaces grow by at most one pixel
+    /// over the background. Depth rows are projected in bands over threads,
+    /// then each thread z-buffers its own band of mapped rows.
+    void setSplat(bool enable) { _splat = enable; }
+    bool splat()             const { return _splat; }
+
+    /// @brief Worker threads of splatting execute(), 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Run TYDepthImageFillEmptyRegion at the end of execute(), on by default.
+    ///        Off leaves the holes of the projection, e.g. to time it alone.
+    void setHoleFilling(bool enable) { _fillHoles = enable; }
+    bool holeFilling()       const { return _fillHoles; }
+
+    /// @brief Instruction set of the float kernel on this cpu, "AVX2", "SSE2", "NEON" or "scalar".
+    static const char* instructionSet();
+
+    bool     isValid()      const { return _valid; }
+    uint32_t depthWidth()   const { return _depthW; }
+    uint32_t depthHeight()  const { return _depthH; }
+    uint32_t mappedWidth()  const { return _mappedW; }
+    uint32_t mappedHeight() const { return _mappedH; }
+
+    /// Projection of one depth row segment, shared by the kernels.
+    struct Params
+    {
+        float M[12];                // inverted color extrinsic, 3x4 row major
+        float fx, fy, cx, cy;       // color intrinsic at mapped resolution, cx/cy with rounding bias
+        float scale;                // depth scale unit
+        float invScale;
+    };
+
+private:
+    struct SplatJob;
+    static void splatProjectRange(int begin, int end, void* arg);
+    static void splatScatterRange(int begin, int end, void* arg);
+    void splatProjectRow(const SplatJob& job, uint32_t r, uint32_t slot);
+    void splatRow(const SplatJob& job, uint32_t slot, int yBegin, int yEnd) const;
+
+    bool buildFixed(uint32_t depthW, uint32_t depthH);
+    void splatBlocks(const uint16_t* depth, const TY_IMAGE_ROI& depthRoi,
+                     const TY_IMAGE_ROI& mappedRoi, uint16_t* mappedDepth);
+    void projectBlock(const Params& P, const uint16_t* depth, uint32_t row, uint32_t col,
+                      int n, int32_t* u, int32_t* v, int32_t* d) const;
+
+    bool                  _valid;
+    bool                  _fixedValid;  // calibration fits the fixed point kernel
+    Kernel                _kernel;
+    bool                  _splat;
+    bool                  _fillHoles;
+    uint32_t              _depthW, _depthH;
+    uint32_t              _mappedW, _mappedH;
+    int                   _threads;
+    float                 _splatScaleX, _splatScaleY;   // mapped fx / depth fx
+    Params                _params;      // depth image projection
+    Params                _lutParams;   // lookup table projection
+    Params                _splatParams; // half pixel projection, see splatFootprint
+    std::vector<float>    _rayX;    // (u - cx) / fx, one per depth column
+    std::vector<float>    _rayY;    // (v - cy) / fy, one per depth row
+    std::vector<int32_t>  _fixCol;  // fixed point A, column part, x y z planes of depthW
+    std::vector<int32_t>  _fixRow;  // fixed point A, row part, x y z planes of depthH
+    int32_t               _fixT[3]; // fixed point T
+    std::vector<int32_t>  _splatRows;   // x, y, d, footprint rows, one per depth row when threaded
+    std::vector<int32_t>  _splatMinY;   // mapped rows each of them reaches
+    std::vector<int32_t>  _splatMaxY;
+};
+
+/// @brief Color pixels to depth coordinate search plan.
+///
+/// Replacement for TYMapRGBPixelsToDepthCoordinate. Instead of mapping one
+/// candidate per depth unit of [min_distance, max_distance), the viewing ray
+/// of each color pixel is walked along its epipolar line in the depth image
+/// once, visiting every depth pixel it crosses. Queries are spread over
+/// worker threads.
+class ColorPixelsToDepthPlan
+{
+public:
+    ColorPixelsToDepthPlan();
+
+    /// @brief Build the plan.
+    /// @param  [in]  depth_calib           Depth image's calibration data.
+    /// @param  [in]  depthW                Width of depth image.
+    /// @param  [in]  depthH                Height of depth image.
+    /// @param  [in]  color_calib           Color image's calibration data.
+    /// @param  [in]  rgbW                  Width of RGB image.
+    /// @param  [in]  rgbH                  Height of RGB image.
+    /// @param  [in]  min_distance          The min distance(mm) of the search range.
+    /// @param  [in]  max_distance          The max distance(mm) of the search range.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                   const TY_CAMERA_CALIB_INFO* color_calib, uint32_t rgbW, uint32_t rgbH,
+                   uint32_t min_distance, uint32_t max_distance,
+                   float f_scale_unit = 1.0f);
+
+    /// @brief Worker threads used by execute(), 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Max difference between measured and ray depth to accept a match, default 10.
+    void setMaxDepthDelta(uint16_t delta) { _maxDelta = delta; }
+
+    /// @brief Map color pixels to depth coordinate.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @param  [in]  src                   Input RGB pixels info.
+    /// @param  [in]  cnt                   Input RGB pixels cnt.
+    /// @param  [out] dst                   Output RGB pixels info, (-1, -1) if not found.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Plan not initialized.
+    TY_STATUS execute(const uint16_t* depth, const TY_PIXEL_COLOR_DESC* src, uint32_t cnt,
+                      TY_PIXEL_COLOR_DESC* dst) const;
+
+    bool isValid() const { return _valid; }
+
+private:
+    struct Job;
+    static void executeRange(int begin, int end, void* arg);
+    void search(const uint16_t* depth, const TY_PIXEL_COLOR_DESC& src, TY_PIXEL_COLOR_DESC& dst) const;
+
+    bool      _valid;
+    uint32_t  _depthW, _depthH;
+    uint32_t  _rgbW, _rgbH;
+    float     _zMin, _zMax;             // search range, in depth units
+    float     _scale;
+    int       _threads;
+    uint16_t  _maxDelta;
+    float     _R[9], _t[3];             // color to depth extrinsic
+    float     _cfx, _cfy, _ccx, _ccy;   // color intrinsic at rgb resolution
+    float     _dfx, _dfy, _dcx, _dcy;   // depth intrinsic at depth resolution
+};
+
+/// @brief Color to depth index map of one frame.
+///
+/// build() projects every depth pixel into the color image once, splats it
+/// over the color pixels its footprint covers and keeps the nearest one, so
+/// each color pixel knows the depth pixel it sees. Any number of color
+/// pixel to depth pixel / 3D point queries on that frame are then lookups.
+class ColorToDepthIndexMap
+{
+public:
+    ColorToDepthIndexMap();
+
+    /// @brief Prepare the map.
+    /// @param  [in]  depth_calib           Depth image's calibration data.
+    /// @param  [in]  depthW                Width of depth image.
+    /// @param  [in]  depthH                Height of depth image.
+    /// @param  [in]  color_calib           Color image's calibration data.
+    /// @param  [in]  colorW                Width of color image.
+    /// @param  [in]  colorH                Height of color image.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                   const TY_CAMERA_CALIB_INFO* color_calib, uint32_t colorW, uint32_t colorH,
+                   float f_scale_unit = 1.0f);
+
+    /// @brief Build the map for a new depth frame, the frame is copied.
+    ///
+    /// Depth rows are projected in bands over threads, then each thread
+    /// z-buffers the points landing in its own band of color rows, so the
+    /// map is the same as a serial build.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Map not initialized.
+    TY_STATUS build(const uint16_t* depth);
+
+    /// @brief Depth pixel seen by color pixel (x, y).
+    /// @retval Depth pixel coordinate and value, (-1, -1, 0) if none.
+    TY_PIXEL_DESC depthPixel(int x, int y) const;
+
+    /// @brief Map color pixels to the depth pixels they see.
+    /// @param  [in]  colorPixels           Color pixels, only x and y are used.
+    /// @param  [in]  cnt                   Number of pixels.
+    /// @param  [out] depthPixels           Depth pixels, (-1, -1, 0) if none.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS mapPixels(const TY_PIXEL_DESC* colorPixels, uint32_t cnt, TY_PIXEL_DESC* depthPixels) const;
+
+    /// @brief Map color pixels to 3D points in depth camera space,
+    ///        as TYMapDepthImageToPoint3d would give for the seen depth pixel.
+    /// @param  [in]  colorPixels           Color pixels, only x and y are used.
+    /// @param  [in]  cnt                   Number of pixels.
+    /// @param  [out] points                3D points, (NAN, NAN, NAN) if none.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS mapPixelsToPoint3d(const TY_PIXEL_DESC* colorPixels, uint32_t cnt, TY_VECT_3F* points) const;
+
+    bool isValid() const { return _valid; }
+    bool isBuilt() const { return _built; }
+
+    /// @brief Worker threads of build(), 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+private:
+    static void projectRange(int begin, int end, void* arg);
+    static void scatterRange(int begin, int end, void* arg);
+    void projectDepthRow(uint32_t row, uint32_t slot);
+    void scatterDepthRow(uint32_t row, uint32_t slot, int yBegin, int yEnd);
+
+    bool                  _valid;
+    bool                  _built;
+    uint32_t              _depthW, _depthH;
+    uint32_t              _colorW, _colorH;
+    float                 _scaleX, _scaleY; // color fx / depth fx, see DepthToColorPlan::setSplat
+    DepthToColorPlan::Params _params;
+    std::vector<float>    _rayX;
+    std::vector<float>    _rayY;
+    std::vector<uint16_t> _depth;           // copy of the frame the map was built from
+    std::vector<uint64_t> _zbuffer;         // color space depth << 32 | depth pixel index
+    int                   _threads;
+    std::vector<int32_t>  _proj;            // x, y, d, footprint rows, one per depth row when threaded
+    std::vector<int32_t>  _rowMinY;         // color rows each of them reaches
+    std::vector<int32_t>  _rowMaxY;
+};
+
+/// @brief Lookup table occlusion resolver, threaded TYPixelsOverlapRemove.
+///
+/// The table is z-buffered into the image, holes are filled the same way
+/// TYDepthImageFillEmptyRegion does, and entries more than the tolerance
+/// behind the surface are invalidated. Each worker owns a band of image rows
+/// and only scatters the table rows that land in it, so no two workers
+/// write the same pixel and the result matches the serial pass exactly.
+class PixelsOverlapResolver
+{
+public:
+    PixelsOverlapResolver();
+
+    /// @brief Worker threads, 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Max depth behind the visible surface that is still kept, default 10.
+    void setTolerance(uint16_t tolerance) { _tolerance = tolerance; }
+
+    /// @brief Scratch bytes resolve() needs for the given sizes.
+    static size_t scratchSize(uint32_t lutH, uint32_t imageW, uint32_t imageH);
+
+    /// @brief Remove occluded lookup table entries.
+    /// @param  [in,out] lut                Lookup table, lutW x lutH, occluded entries set to (-1, -1, 0).
+    /// @param  [in]  lutW                  Width of lookup table.
+    /// @param  [in]  lutH                  Height of lookup table.
+    /// @param  [in]  imageW                Width of the image the table maps into.
+    /// @param  [in]  imageH                Height of the image the table maps into.
+    /// @param  [in]  scratch               At least scratchSize() bytes, NULL to use an internal buffer.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS resolve(TY_PIXEL_DESC* lut, uint32_t lutW, uint32_t lutH,
+                      uint32_t imageW, uint32_t imageH, void* scratch = NULL);
+
+private:
+    struct Job;
+    static void rowBoundsRange(int begin, int end, void* arg);
+    static void scatterRange(int begin, int end, void* arg);
+    static void fillRange(int begin, int end, void* arg);
+    static void invalidateRange(int begin, int end, void* arg);
+
+    int                  _threads;
+    uint16_t             _tolerance;
+    std::vector<uint8_t> _scratch;
+};
+
+/// @brief Image to depth coordinate registration engine.
+///
+/// Threaded counterpart of TYMapRGBImageToDepthCoordinate and friends.
+/// update() builds the overlap removed lookup table of a depth frame once,
+/// then any number of images (color, mono, ...) are sampled through it with
+/// precomputed scale tables, nearest or bilinear, rows split over threads.
+class ImageToDepthRegistration
+{
+public:
+    ImageToDepthRegistration();
+
+    /// @brief Prepare the engine.
+    /// @param  [in]  depth_calib           Depth image's calibration data.
+    /// @param  [in]  depthW                Width of depth image.
+    /// @param  [in]  depthH                Height of depth image.
+    /// @param  [in]  color_calib           Color image's calibration data.
+    /// @param  [in]  imageW                Width of source image.
+    /// @param  [in]  imageH                Height of source image.
+    /// @param  [in]  f_scale_unit          Depth scale unit.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* depth_calib, uint32_t depthW, uint32_t depthH,
+                   const TY_CAMERA_CALIB_INFO* color_calib, uint32_t imageW, uint32_t imageH,
+                   float f_scale_unit = 1.0f);
+
+    /// @brief Worker threads, 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; _resolver.setThreadCount(threads); }
+
+    /// @brief Occlusion tolerance, see PixelsOverlapResolver::setTolerance.
+    void setOverlapTolerance(uint16_t tolerance) { _resolver.setTolerance(tolerance); }
+
+    /// @brief Projection kernel of the lookup table, see DepthToColorPlan::setKernel.
+    TY_STATUS setKernel(DepthToColorPlan::Kernel kernel) { return _plan.setKernel(kernel); }
+
+    /// @brief Bilinear instead of nearest sampling, default off.
+    void setBilinear(bool enable) { _bilinear = enable; }
+
+    /// @brief Take source images as captured, with the lens distortion of color_calib.
+    ///
+    /// The undistortion remap of the source image is composed with the
+    /// lookup table, each mapped pixel reads the raw image once, bilinear,
+    /// where TYUndistortImage would have read for the pixel nearest sampling
+    /// picks. No undistorted copy of the image is made. setBilinear() has no
+    /// effect then. Kept across update() and rebuilt by init().
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Engine not initialized.
+    TY_STATUS setDistortedSource(bool enable);
+    bool      distortedSource() const { return _distorted; }
+
+    /// @brief Restrict registration to a region of the depth image, NULL for the whole image.
+    ///        Lookup table and mapped images are then sized to the region.
+    ///        Surfaces outside the region do not occlude the ones inside.
+    /// @param  [in]  depthRoi              Region of depth image.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Engine not initialized.
+    /// @retval TY_STATUS_INVALID_PARAMETER Region outside of depth image.
+    TY_STATUS setROI(const TY_IMAGE_ROI* depthRoi);
+
+    /// @brief Build the lookup table of a new depth frame.
+    /// @param  [in]  depth                 Depth image, depthW x depthH.
+    /// @retval TY_STATUS_OK                Succeed.
+    TY_STATUS update(const uint16_t* depth);
+
+    /// @brief Sample an image of CN channels of T to depth coordinate.
+    /// @param  [in]  image                 Source image, imageW x imageH.
+    /// @param  [out] mapped                Output image, depthW x depthH or the region size.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        No lookup table, call update() first.
+    template <typename T, int CN>
+    TY_STATUS map(const T* image, T* mapped) const;
+
+    TY_STATUS mapRGB(const uint8_t* rgb, uint8_t* mapped) const      { return map<uint8_t, 3>(rgb, mapped); }
+    TY_STATUS mapRGB48(const uint16_t* rgb, uint16_t* mapped) const  { return map<uint16_t, 3>(rgb, mapped); }
+    TY_STATUS mapMono16(const uint16_t* gray, uint16_t* mapped) const { return map<uint16_t, 1>(gray, mapped); }
+    TY_STATUS mapMono8(const uint8_t* gray, uint8_t* mapped) const   { return map<uint8_t, 1>(gray, mapped); }
+
+    /// @brief Sample a raw YUYV, YVYU or BAYER8 color image to depth coordinate.
+    ///        Only the pixels the lookup table hits are converted, nearest
+    ///        sampling. The raw image is used as is, without ISP. With
+    ///        setDistortedSource(), each pixel reads the raw pixel nearest to
+    ///        where its undistorted position comes from.
+    /// @param  [in]  image                 Raw color image, imageW x imageH.
+    /// @param  [out] mappedBgr             Output BGR image, depthW x depthH or the region size.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        No lookup table, call update() first.
+    /// @retval TY_STATUS_WRONG_SIZE        Image size differs from init().
+    /// @retval TY_STATUS_WRONG_TYPE        Unsupported pixel format.
+    TY_STATUS mapRaw(const TY_IMAGE_DATA* image, uint8_t* mappedBgr) const;
+
+    bool isValid() const { return _plan.isValid(); }
+    const TY_PIXEL_DESC* lookupTable() const { return _updated ? &_lut[0] : NULL; }
+    const TY_IMAGE_ROI& roi() const { return _roi; }
+
+private:
+    template <typename T, int CN>
+    struct Job
+    {
+        const ImageToDepthRegistration* self;
+        const T* image;
+        T* mapped;
+    };
+    template <typename T, int CN>
+    static void mapRows(int begin, int end, void* arg);
+    template <typename T, int CN>
+    static void mapDistortedRows(int begin, int end, void* arg);
+
+    DepthToColorPlan      _plan;
+    PixelsOverlapResolver _resolver;
+    bool                  _updated;
+    bool                  _bilinear;
+    bool                  _distorted;
+    int                   _threads;
+    uint32_t              _imageW, _imageH;
+    TY_CAMERA_CALIB_INFO  _colorCalib;
+    UndistortionPlan      _undistortion;                // source image as captured, see setDistortedSource()
+    TY_IMAGE_ROI          _roi;                         // depth image region of _lut
+    std::vector<TY_PIXEL_DESC> _lut;
+    std::vector<uint16_t> _tab;                         // nearest, x then y
+    std::vector<TY_MAP_BILINEAR_ENTRY> _bilinearTab;    // bilinear, x then y
+};
+
+template <typename T, int CN>
+void ImageToDepthRegistration::mapRows(int begin, int end, void* arg)
+{
+    Job<T, CN>* job = (Job<T, CN>*)arg;
+    const ImageToDepthRegistration* self = job->self;
+    const uint32_t depthW = self->_plan.depthWidth();
+    const uint32_t depthH = self->_plan.depthHeight();
+    if(self->_bilinear) {
+        TYMapImageToDepthCoordinateRowsBilinear<T, CN>(&self->_lut[0], self->_roi.w, depthW, depthH,
+                job->image, self->_imageW, &self->_bilinearTab[0], &self->_bilinearTab[depthW],
+                job->mapped, begin, end);
+    } else {
+        TYMapImageToDepthCoordinateRows<T, CN>(&self->_lut[0], self->_roi.w, depthW, depthH,
+                job->image, self->_imageW, &self->_tab[0], &self->_tab[depthW],
+                job->mapped, begin, end);
+    }
+}
+
+template <typename T, int CN>
+void ImageToDepthRegistration::mapDistortedRows(int begin, int end, void* arg)
+{
+    Job<T, CN>* job = (Job<T, CN>*)arg;
+    const ImageToDepthRegistration* self = job->self;
+    const uint32_t depthW = self->_plan.depthWidth();
+    const uint32_t depthH = self->_plan.depthHeight();
+    const uint32_t lutW = self->_roi.w;
+    const uint16_t* tabX = &self->_tab[0];
+    const uint16_t* tabY = &self->_tab[depthW];
+    const TY_PIXEL_FORMAT format = sizeof(T) == 1 ? (CN == 1 ? TY_PIXEL_FORMAT_MONO : TY_PIXEL_FORMAT_RGB)
+                                                  : (CN == 1 ? TY_PIXEL_FORMAT_MONO16 : TY_PIXEL_FORMAT_RGB48);
+    // undistorted image pixel of each table entry, then one remap per chunk
+    int32_t pixels[256];
+    for(int r = begin; r < end; r++) {
+        const TY_PIXEL_DESC* lut = &self->_lut[(size_t)r * lutW];
+        T* out = job->mapped + (size_t)r * lutW * CN;
+        for(uint32_t c0 = 0; c0 < lutW; c0 += 256) {
+            const uint32_t n = lutW - c0 < 256 ? lutW - c0 : 256;
+            for(uint32_t i = 0; i < n; i++) {
+                const TY_PIXEL_DESC& e = lut[c0 + i];
+                pixels[i] = (e.x < 0 || e.x >= (int)depthW || e.y < 0 || e.y >= (int)depthH) ? -1
+                          : (int32_t)((uint32_t)tabY[e.y] * self->_imageW + tabX[e.x]);
+            }
+            self->_undistortion.remap(format, job->image, pixels, n, out + (size_t)c0 * CN);
+        }
+    }
+}
+
+template <typename T, int CN>
+TY_STATUS ImageToDepthRegistration::map(const T* image, T* mapped) const
+{
+    if(!_updated) {
+        return TY_STATUS_NOT_INITED;
+    }
+    if(!image || !mapped) {
+        return TY_STATUS_NULL_POINTER;
+    }
+    Job<T, CN> job;
+    job.self = this;
+    job.image = image;
+    job.mapped = mapped;
+    TYParallelFor((int)_roi.h, _threads, _distorted ? mapDistortedRows<T, CN> : mapRows<T, CN>, &job);
+    return TY_STATUS_OK;
+}
+
+#endif
@@ -16,7 +16,7 @@ public:
         arg,                    // argument to thread function
         0,                      // use default creation flags
         &dwThreadId);           // returns the thread identifier
-    return 0;
+    return _thread ? 0 : -1;
   }
   int destroy() {
     // TerminateThread(_thread, 0);
@@ -41,6 +41,7 @@ private:
 #else // _WIN32
 
 #include <pthread.h>
+#include <unistd.h>
 class TYThreadImpl
 {
 public:
@@ -81,3 +82,262 @@ int TYThread::destroy()
 {
   return impl->destroy();
 }
+
+////////////////////////////////////////////////////////////////////////////
+
+int TYThreadHardwareConcurrency()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = (int)info.dwNumberOfProcessors;
+#else
+  int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return n > 0 ? n : 1;
+}
+
+// Workers are started on demand up to this count and kept until exit.
+#define TY_PARALLEL_MAX_WORKERS   (64)
+
+// One TYParallelFor() call. Lives on the stack of the caller, which does
+// not return before every range is done.
+struct TYParallelJob
+{
+  TYParallelRange_t fn;
+  void* arg;
+  int count;
+  int ranges;
+  int next;             // next range to hand out
+  int pending;          // ranges not finished yet
+  TYParallelJob* link;  // next job in the queue
+};
+
+// Persistent worker threads. Jobs wait in a queue, any worker and the
+// calling thread take ranges from the oldest one. The caller never blocks
+// before its own job has no range left, so nested and concurrent calls
+// always make progress.
+class TYParallelPool
+{
+public:
+  TYParallelPool();
+  ~TYParallelPool();
+
+  void run(TYParallelJob* job);
+
+private:
+  static void* workerCallback(void* userdata);
+  void workerLoop();
+  void startWorkers(int count);
+  bool take(TYParallelJob* job, int* range);
+  static void runRange(TYParallelJob* job, int range);
+
+  void lock();
+  void unlock();
+  void waitWork();
+  void waitDone();
+  void wakeWork();
+  void wakeDone();
+
+#ifdef _WIN32
+  CRITICAL_SECTION _mutex;
+  CONDITION_VARIABLE _work;
+  CONDITION_VARIABLE _done;
+#else
+  pthread_mutex_t _mutex;
+  pthread_cond_t _work;
+  pthread_cond_t _done;
+#endif
+  TYThread* _workers[TY_PARALLEL_MAX_WORKERS];
+  int _workerCount;
+  bool _stop;
+  TYParallelJob* _head;
+  TYParallelJob* _tail;
+};
+
+#ifdef _WIN32
+void TYParallelPool::lock()     { EnterCriticalSection(&_mutex); }
+void TYParallelPool::unlock()   { LeaveCriticalSection(&_mutex); }
+void TYParallelPool::waitWork() { SleepConditionVariableCS(&_work, &_mutex, INFINITE); }
+void TYParallelPool::waitDone() { SleepConditionVariableCS(&_done, &_mutex, INFINITE); }
+void TYParallelPool::wakeWork() { WakeAllConditionVariable(&_work); }
+void TYParallelPool::wakeDone() { WakeAllConditionVariable(&_done); }
+#else
+void TYParallelPool::lock()     { pthread_mutex_lock(&_mutex); }
+void TYParallelPool::unlock()   { pthread_mutex_unlock(&_mutex); }
+void TYParallelPool::waitWork() { pthread_cond_wait(&_work, &_mutex); }
+void TYParallelPool::waitDone() { pthread_cond_wait(&_done, &_mutex); }
+void TYParallelPool::wakeWork() { pthread_cond_broadcast(&_work); }
+void TYParallelPool::wakeDone() { pthread_cond_broadcast(&_done); }
+#endif
+
+TYParallelPool::TYParallelPool()
+  : _workerCount(0)
+  , _stop(false)
+  , _head(NULL)
+  , _tail(NULL)
+{
+#ifdef _WIN32
+  InitializeCriticalSection(&_mutex);
+  InitializeConditionVariable(&_work);
+  InitializeConditionVariable(&_done);
+#else
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_work, NULL);
+  pthread_cond_init(&_done, NULL);
+#endif
+}
+
+// Workers are joined, the lock is kept so calls made later, e.g. from
+// other static destructors, still work on the calling thread alone.
+TYParallelPool::~TYParallelPool()
+{
+  lock();
+  _stop = true;
+  wakeWork();
+  unlock();
+  for(int i = 0; i < _workerCount; i++) {
+    _workers[i]->destroy();
+    delete _workers[i];
+  }
+  _workerCount = 0;
+}
+
+void* TYParallelPool::workerCallback(void* userdata)
+{
+  ((TYParallelPool*)userdata)->workerLoop();
+  return NULL;
+}
+
+// Called locked.
+void TYParallelPool::startWorkers(int count)
+{
+  if(count > TY_PARALLEL_MAX_WORKERS) {
+    count = TY_PARALLEL_MAX_WORKERS;
+  }
+  while(_workerCount < count) {
+    TYThread* worker = new TYThread();
+    if(worker->create(workerCallback, this) != 0) {
+      // could not spawn, the ranges left run on the threads there are
+      delete worker;
+      return;
+    }
+    _workers[_workerCount++] = worker;
+  }
+}
+
+// Called locked. Hands out the next range of job, a job without ranges
+// left leaves the queue.
+bool TYParallelPool::take(TYParallelJob* job, int* range)
+{
+  if(job->next >= job->ranges) {
+    return false;
+  }
+  *range = job->next++;
+  if(job->next == job->ranges) {
+    TYParallelJob* prev = NULL;
+    for(TYParallelJob* it = _head; it; prev = it, it = it->link) {
+      if(it == job) {
+        if(prev) {
+          prev->link = job->link;
+        } else {
+          _head = job->link;
+        }
+        if(_tail == job) {
+          _tail = prev;
+        }
+        break;
+      }
+    }
+    job->link = NULL;
+  }
+  return true;
+}
+
+void TYParallelPool::runRange(TYParallelJob* job, int range)
+{
+  const int begin = (int)((long long)job->count * range / job->ranges);
+  const int end = (int)((long long)job->count * (range + 1) / job->ranges);
+  job->fn(begin, end, job->arg);
+}
+
+void TYParallelPool::workerLoop()
+{
+  lock();
+  while(!_stop) {
+    TYParallelJob* job = _head;
+    int range;
+    if(!job || !take(job, &range)) {
+      waitWork();
+      continue;
+    }
+    unlock();
+    runRange(job, range);
+    lock();
+    // job may be gone once pending is 0 and the caller saw it
+    if(--job->pending == 0) {
+      wakeDone();
+    }
+  }
+  unlock();
+}
+
+void TYParallelPool::run(TYParallelJob* job)
+{
+  lock();
+  if(_stop) {
+    unlock();
+    job->fn(0, job->count, job->arg);
+    return;
+  }
+  startWorkers(job->ranges - 1);
+  job->link = NULL;
+  if(_tail) {
+    _tail->link = job;
+  } else {
+    _head = job;
+  }
+  _tail = job;
+  wakeWork();
+
+  int range;
+  while(take(job, &range)) {
+    unlock();
+    runRange(job, range);
+    lock();
+    job->pending--;
+  }
+  while(job->pending > 0) {
+    waitDone();
+  }
+  unlock();
+}
+
+static TYParallelPool g_parallelPool;
+
+void TYParallelFor(int count, int threads, TYParallelRange_t fn, void* arg)
+{
+  if(count <= 0) {
+    return;
+  }
+  if(threads <= 0) {
+    threads = TYThreadHardwareConcurrency();
+  }
+  if(threads > count) {
+    threads = count;
+  }
+  if(threads == 1) {
+    fn(0, count, arg);
+    return;
+  }
+
+  TYParallelJob job;
+  job.fn = fn;
+  job.arg = arg;
+  job.count = count;
+  job.ranges = threads;
+  job.next = 0;
+  job.pending = threads;
+  job.link = NULL;
+  g_parallelPool.run(&job);
+}
@@ -19,6 +19,18 @@ private:
   TYThreadImpl* impl;
 };
 
+/// Number of online cpus, 1 if unknown.
+int TYThreadHardwareConcurrency();
+
+typedef void (*TYParallelRange_t)(int begin, int end, void* arg);
+
+/// Split [0, count) into at most `threads` contiguous ranges and run
+/// fn(begin, end, arg) on each. The ranges go to worker threads that are
+/// started at the first call and kept, the calling thread takes ranges too.
+/// threads <= 0 uses TYThreadHardwareConcurrency(). Returns after all
+/// ranges are done. Safe to call from several threads and from inside fn.
+void TYParallelFor(int count, int threads, TYParallelRange_t fn, void* arg);
+
 
 
 
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <string.h>
+#include "TableCache.hpp"
+#include "crc32.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile()
+  : _data(NULL)
+  , _size(0)
+#ifdef _WIN32
+  , _file(INVALID_HANDLE_VALUE)
+  , _mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+  close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if(!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!data) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  _file = file;
+  _mapping = mapping;
+  _data = (const uint8_t*)data;
+  _size = (size_t)size.QuadPart;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(_data) {
+    UnmapViewOfFile(_data);
+  }
+  if(_mapping) {
+    CloseHandle(_mapping);
+  }
+  if(_file != INVALID_HANDLE_VALUE) {
+    CloseHandle(_file);
+  }
+  _data = NULL;
+  _size = 0;
+  _mapping = NULL;
+  _file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if(data == MAP_FAILED) {
+    return false;
+  }
+  _data = (const uint8_t*)data;
+  _size = (size_t)st.st_size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(_data) {
+    munmap((void*)_data, _size);
+  }
+  _data = NULL;
+  _size = 0;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////
+
+TableKey::TableKey(const char* kind, uint32_t version)
+  : _kind(kind)
+{
+  add(kind, strlen(kind));
+  add(version);
+}
+
+TableKey& TableKey::add(const void* data, size_t size)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  _bytes.insert(_bytes.end(), p, p + size);
+  return *this;
+}
+
+uint32_t TableKey::hash() const
+{
+  return _bytes.empty() ? 0 : crc32_fast(&_bytes[0], _bytes.size());
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+#define TABLE_FILE_MAGIC    "TYTB"
+#define TABLE_FILE_VERSION  (1)
+#define TABLE_FILE_ALIGN    (16)
+
+struct TableFileHeader
+{
+  char     magic[4];
+  uint32_t version;
+  uint32_t keySize;
+  uint32_t payloadCrc;
+  uint64_t payloadOffset;   // from file start, TABLE_FILE_ALIGN aligned
+  uint64_t payloadSize;
+};
+
+static uint64_t payloadOffset(size_t keySize)
+{
+  uint64_t off = sizeof(TableFileHeader) + keySize;
+  return (off + TABLE_FILE_ALIGN - 1) / TABLE_FILE_ALIGN * TABLE_FILE_ALIGN;
+}
+
+// Temporary file name next to target, unique per process and per store()
+// call, so writers of the same table in other processes or threads never
+// share one.
+static std::string tempPath(const std::string& target)
+{
+#ifdef _WIN32
+  static volatile LONG counter = 0;
+  const unsigned long pid = (unsigned long)GetCurrentProcessId();
+  const unsigned long seq = (unsigned long)InterlockedIncrement(&counter);
+#else
+  static unsigned long counter = 0;
+  const unsigned long pid = (unsigned long)getpid();
+  const unsigned long seq = __sync_add_and_fetch(&counter, 1UL);
+#endif
+  char suffix[48];
+  sprintf(suffix, ".%lu.%lu.tmp", pid, seq);
+  return target + suffix;
+}
+
+TableCache::TableCache(const std::string& dir)
+  : _dir(dir)
+{
+}
+
+std::string TableCache::path(const TableKey& key) const
+{
+  char name[16];
+  sprintf(name, "_%08x.tbl", key.hash());
+  std::string p = _dir;
+  if(!p.empty() && p[p.size() - 1] != '/' && p[p.size() - 1] != '\\') {
+    p += '/';
+  }
+  return p + key.kind() + name;
+}
+
+bool TableCache::load(const TableKey& key, MappedFile& file, const void** payload, size_t* size) const
+{
+  if(!enabled() || !payload || !size) {
+    return false;
+  }
+  if(!file.open(path(key))) {
+    return false;
+  }
+
+  const std::vector<uint8_t>& bytes = key.bytes();
+  TableFileHeader header;
+  bool valid = file.size() >= sizeof(header);
+  if(valid) {
+    memcpy(&header, file.data(), sizeof(header));
+    valid = memcmp(header.magic, TABLE_FILE_MAGIC, 4) == 0
+        && header.version == TABLE_FILE_VERSION
+        && header.keySize == bytes.size()
+        && header.payloadOffset == payloadOffset(bytes.size())
+        && header.payloadOffset <= file.size()
+        && header.payloadSize <= file.size() - header.payloadOffset;
+  }
+  // a different key with the same hash, or a table from an older layout
+  valid = valid && memcmp(file.data() + sizeof(header), &bytes[0], bytes.size()) == 0;
+  // truncated or damaged file
+  valid = valid && crc32_fast(file.data() + header.payloadOffset, (size_t)header.payloadSize) == header.payloadCrc;
+  if(!valid) {
+    file.close();
+    return false;
+  }
+
+  *payload = file.data() + header.payloadOffset;
+  *size = (size_t)header.payloadSize;
+  return true;
+}
+
+TY_STATUS TableCache::store(const TableKey& key, const void* payload, size_t size) const
+{
+  if(!enabled()) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!payload && size) {
+    return TY_STATUS_NULL_POINTER;
+  }
+
+  const std::vector<uint8_t>& bytes = key.bytes();
+  TableFileHeader header;
+  memcpy(header.magic, TABLE_FILE_MAGIC, 4);
+  header.version = TABLE_FILE_VERSION;
+  header.keySize = (uint32_t)bytes.size();
+  header.payloadCrc = crc32_fast(payload, size);
+  header.payloadOffset = payloadOffset(bytes.size());
+  header.payloadSize = size;
+
+  // write aside and rename, a reader never maps a half written table
+  const std::string target = path(key);
+  const std::string tmp = tempPath(target);
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if(!fp) {
+    return TY_STATUS_ERROR;
+  }
+  static const uint8_t zeros[TABLE_FILE_ALIGN] = {0};
+  const size_t pad = (size_t)(header.payloadOffset - sizeof(header) - bytes.size());
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+      && fwrite(&bytes[0], 1, bytes.size(), fp) == bytes.size()
+      && fwrite(zeros, 1, pad, fp) == pad
+      && (size == 0 || fwrite(payload, 1, size, fp) == size);
+  ok = (fclose(fp) == 0) && ok;
+  if(ok) {
+#ifdef _WIN32
+    ok = MoveFileExA(tmp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    ok = rename(tmp.c_str(), target.c_str()) == 0;
+#endif
+  }
+  if(!ok) {
+    remove(tmp.c_str());
+    return TY_STATUS_ERROR;
+  }
+  return TY_STATUS_OK;
+}
@@ -0,0 +1,96 @@
+#ifndef XYZ_TABLE_CACHE_HPP_
+#define XYZ_TABLE_CACHE_HPP_
+
+#include <string>
+#include <vector>
+#include "TYCoordinateMapper.h"
+
+/// @brief Read only memory mapping of a whole file.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    /// @brief Map the file, any previous mapping is closed.
+    /// @retval true                        Succeed.
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return _data; }
+    size_t         size() const { return _size; }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* _data;
+    size_t         _size;
+#ifdef _WIN32
+    void*          _file;
+    void*          _mapping;
+#endif
+};
+
+/// @brief Identity of a precomputed table.
+///
+/// Everything the table is computed from is appended: table kind, layout
+/// version, calibrations, resolutions, scale unit... Two keys are equal only
+/// if all appended bytes are.
+class TableKey
+{
+public:
+    /// @param  [in]  kind                  Table kind, also names the cache file.
+    /// @param  [in]  version               Bump when the table layout or algorithm changes.
+    TableKey(const char* kind, uint32_t version);
+
+    TableKey& add(const void* data, size_t size);
+    TableKey& add(const TY_CAMERA_CALIB_INFO* calib) { return add(calib, sizeof(*calib)); }
+    TableKey& add(uint32_t value)                    { return add(&value, sizeof(value)); }
+    TableKey& add(float value)                       { return add(&value, sizeof(value)); }
+
+    const std::string&          kind()  const { return _kind; }
+    const std::vector<uint8_t>& bytes() const { return _bytes; }
+    uint32_t                    hash()  const;
+
+private:
+    std::string          _kind;
+    std::vector<uint8_t> _bytes;
+};
+
+/// @brief Directory of precomputed tables, loaded back with mmap.
+///
+/// A table is stored in <dir>/<kind>_<hash>.tbl together with its full key
+/// and a crc32 of the payload. load() only accepts a file whose key matches
+/// byte for byte and whose payload is intact, anything else is reported as
+/// missing so the caller rebuilds the table and store()s it again.
+class TableCache
+{
+public:
+    /// @param  [in]  dir                   Cache directory, must exist. Empty disables the cache.
+    explicit TableCache(const std::string& dir);
+
+    bool enabled() const { return !_dir.empty(); }
+
+    /// @brief Path of the table file of key.
+    std::string path(const TableKey& key) const;
+
+    /// @brief Map the table of key.
+    /// @param  [in]  key                   Table key.
+    /// @param  [out] file                  Mapping, keeps the payload alive.
+    /// @param  [out] payload               Table payload, 16 bytes aligned.
+    /// @param  [out] size                  Payload size in bytes.
+    /// @retval true                        Table found and valid.
+    bool load(const TableKey& key, MappedFile& file, const void** payload, size_t* size) const;
+
+    /// @brief Write the table of key, replacing a stale one.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Cache disabled.
+    /// @retval TY_STATUS_ERROR             File can not be written.
+    TY_STATUS store(const TableKey& key, const void* payload, size_t size) const;
+
+private:
+    std::string _dir;
+};
+
+#endif
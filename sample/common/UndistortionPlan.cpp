@@ -0,0 +1,523 @@
+#include <string.h>
+#include <math.h>
+#include "UndistortionPlan.hpp"
+#include "TYThread.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TY_UP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TY_UP_NEON
+#endif
+
+#define UP_TABLE_VERSION  (1)
+// fractional bits of the bilinear weights
+#define UP_WEIGHT_BITS    (7)
+#define UP_WEIGHT_ONE     (1 << UP_WEIGHT_BITS)
+// output rows per task
+#define UP_BAND_ROWS      (16)
+// pixels gathered per remapTaps() call of remap()
+#define UP_GATHER_SIZE    (256)
+
+struct UndistortionPlan::Job
+{
+  const UndistortionPlan* self;
+  const uint8_t* src;
+  uint8_t* dst;
+};
+
+static int channelsOf(TY_PIXEL_FORMAT format)
+{
+  switch(format) {
+    case TY_PIXEL_FORMAT_MONO:
+    case TY_PIXEL_FORMAT_MONO16:
+    case TY_PIXEL_FORMAT_DEPTH16:
+      return 1;
+    case TY_PIXEL_FORMAT_RGB:
+    case TY_PIXEL_FORMAT_BGR:
+    case TY_PIXEL_FORMAT_RGB48:
+    case TY_PIXEL_FORMAT_BGR48:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+bool UndistortionPlan::supports(TY_PIXEL_FORMAT format)
+{
+  return channelsOf(format) != 0;
+}
+
+// Bilinear in fixed point, T is the channel type.
+template <typename T, int C>
+static void remapBilinear(const T* src, uint32_t width, const int32_t* pixels, const uint8_t* weights,
+                          int n, T* dst)
+{
+  const size_t stride = (size_t)width * C;
+  for(int i = 0; i < n; i++, dst += C) {
+    if(pixels[i] < 0) {
+      for(int c = 0; c < C; c++) dst[c] = 0;
+      continue;
+    }
+    const T* a = src + (size_t)pixels[i] * C;
+    const T* b = a + stride;
+    const int wx = weights[2 * i], wy = weights[2 * i + 1];
+    const int w00 = (UP_WEIGHT_ONE - wx) * (UP_WEIGHT_ONE - wy), w01 = wx * (UP_WEIGHT_ONE - wy);
+    const int w10 = (UP_WEIGHT_ONE - wx) * wy, w11 = wx * wy;
+    for(int c = 0; c < C; c++) {
+      // 16 bit channels: 65535 * 2^14 still fits in 32 bits
+      const uint32_t v = (uint32_t)a[c] * w00 + (uint32_t)a[c + C] * w01
+                       + (uint32_t)b[c] * w10 + (uint32_t)b[c + C] * w11;
+      dst[c] = (T)((v + (1u << (2 * UP_WEIGHT_BITS - 1))) >> (2 * UP_WEIGHT_BITS));
+    }
+  }
+}
+
+static void remapNearest16(const uint16_t* src, const int32_t* pixels, int n, uint16_t* dst)
+{
+  for(int i = 0; i < n; i++) {
+    dst[i] = pixels[i] < 0 ? 0 : src[pixels[i]];
+  }
+}
+
+#ifdef TY_UP_SSE2
+// 8 pixels per step. The rows are interpolated first, the products stay
+// below 2^15, then one madd per pixel pair does the columns.
+static void remapMono8(const uint8_t* src, uint32_t width, const int32_t* pixels, const uint8_t* weights,
+                       int n, uint8_t* dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(UP_WEIGHT_ONE);
+  const __m128i odd = _mm_set1_epi32((int)0xffff0000);
+  const __m128i round = _mm_set1_epi32(1 << (2 * UP_WEIGHT_BITS - 1));
+  const __m128i outside = _mm_set1_epi32(-1);
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    uint16_t top[8], bottom[8];
+    for(int k = 0; k < 8; k++) {
+      const uint8_t* a = src + (pixels[i + k] < 0 ? 0 : pixels[i + k]);
+      top[k] = (uint16_t)(a[0] | (a[1] << 8));
+      bottom[k] = (uint16_t)(a[width] | (a[width + 1] << 8));
+    }
+    const __m128i t = _mm_loadu_si128((const __m128i*)top);
+    const __m128i b = _mm_loadu_si128((const __m128i*)bottom);
+    const __m128i w = _mm_loadu_si128((const __m128i*)(weights + 2 * i));
+    const __m128i valid = _mm_packs_epi32(
+        _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(pixels + i)), outside),
+        _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(pixels + i + 4)), outside));
+    __m128i r[2];
+    for(int h = 0; h < 2; h++) {
+      // (wx, wy) of 4 pixels, then wy and (1 - wx, wx) per pixel pair
+      const __m128i wxy = h ? _mm_unpackhi_epi8(w, zero) : _mm_unpacklo_epi8(w, zero);
+      const __m128i wy = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wxy, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+      const __m128i wx = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wxy, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+      const __m128i wxPair = _mm_or_si128(_mm_and_si128(odd, wx), _mm_andnot_si128(odd, _mm_sub_epi16(one, wx)));
+      const __m128i pt = h ? _mm_unpackhi_epi8(t, zero) : _mm_unpacklo_epi8(t, zero);
+      const __m128i pb = h ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+      const __m128i rows = _mm_add_epi16(_mm_mullo_epi16(pt, _mm_sub_epi16(one, wy)), _mm_mullo_epi16(pb, wy));
+      r[h] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(rows, wxPair), round), 2 * UP_WEIGHT_BITS);
+    }
+    const __m128i v = _mm_and_si128(_mm_packs_epi32(r[0], r[1]), valid);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(v, zero));
+  }
+  remapBilinear<uint8_t, 1>(src, width, pixels + i, weights + 2 * i, n - i, dst + i);
+}
+
+// One pixel per step, the 8 byte loads read 2 bytes past the right pixel.
+static void remapColor8(const uint8_t* src, uint32_t width, uint32_t height, const int32_t* pixels,
+                        const uint8_t* weights, int n, uint8_t* dst)
+{
+  const size_t stride = (size_t)width * 3;
+  const size_t total = stride * height;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(1 << (2 * UP_WEIGHT_BITS - 1));
+  for(int i = 0; i < n; i++, dst += 3) {
+    const size_t offset = (size_t)pixels[i] * 3;
+    if(pixels[i] < 0 || offset + stride + 8 > total) {
+      remapBilinear<uint8_t, 3>(src, width, pixels + i, weights + 2 * i, 1, dst);
+      continue;
+    }
+    const int wx = weights[2 * i], wy = weights[2 * i + 1];
+    const __m128i t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + offset)), zero);
+    const __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + offset + stride)), zero);
+    const __m128i rows = _mm_add_epi16(_mm_mullo_epi16(t, _mm_set1_epi16((short)(UP_WEIGHT_ONE - wy))),
+                                       _mm_mullo_epi16(b, _mm_set1_epi16((short)wy)));
+    // (left, right) per channel
+    const __m128i pairs = _mm_unpacklo_epi16(rows, _mm_srli_si128(rows, 6));
+    const __m128i r = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, _mm_set1_epi32((wx << 16) | (UP_WEIGHT_ONE - wx))),
+                                                   round), 2 * UP_WEIGHT_BITS);
+    const int v = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(r, zero), zero));
+    dst[0] = (uint8_t)v;
+    dst[1] = (uint8_t)(v >> 8);
+    dst[2] = (uint8_t)(v >> 16);
+  }
+}
+
+// 4 pixels per step. madd takes signed 16 bits, so the pixels are biased
+// by -32768; the weights of a pixel add up to 2^14, the bias comes back as
+// 2^29 in the sum.
+static void remapMono16(const uint16_t* src, uint32_t width, const int32_t* pixels, const uint8_t* weights,
+                        int n, uint16_t* dst)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi16(UP_WEIGHT_ONE);
+  const __m128i odd = _mm_set1_epi32((int)0xffff0000);
+  const __m128i sign = _mm_set1_epi16((short)0x8000);
+  const __m128i round = _mm_set1_epi32((1 << 29) + (1 << (2 * UP_WEIGHT_BITS - 1)));
+  const __m128i half = _mm_set1_epi32(32768);
+  const __m128i outside = _mm_set1_epi32(-1);
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    uint32_t top[4], bottom[4];
+    for(int k = 0; k < 4; k++) {
+      const uint16_t* a = src + (pixels[i + k] < 0 ? 0 : pixels[i + k]);
+      memcpy(&top[k], a, 4);
+      memcpy(&bottom[k], a + width, 4);
+    }
+    const __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i*)top), sign);
+    const __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)bottom), sign);
+    // (wx, wy) of 4 pixels, then (1 - wx, wx) times 1 - wy and wy per pixel
+    const __m128i wxy = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(weights + 2 * i)), zero);
+    const __m128i wy = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wxy, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+    const __m128i wx = _mm_shufflehi_epi16(_mm_shufflelo_epi16(wxy, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128i wxPair = _mm_or_si128(_mm_and_si128(odd, wx), _mm_andnot_si128(odd, _mm_sub_epi16(one, wx)));
+    const __m128i sum = _mm_add_epi32(_mm_madd_epi16(t, _mm_mullo_epi16(wxPair, _mm_sub_epi16(one, wy))),
+                                      _mm_madd_epi16(b, _mm_mullo_epi16(wxPair, wy)));
+    const __m128i r = _mm_srli_epi32(_mm_add_epi32(sum, round), 2 * UP_WEIGHT_BITS);
+    // no unsigned pack in SSE2, through signed and back
+    const __m128i v = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(r, half), zero), sign);
+    const __m128i valid = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(pixels + i)), outside);
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_and_si128(v, _mm_packs_epi32(valid, zero)));
+  }
+  remapBilinear<uint16_t, 1>(src, width, pixels + i, weights + 2 * i, n - i, dst + i);
+}
+
+#elif defined(TY_UP_NEON)
+
+// Pixels outside the source, all ones per 16 bit lane.
+static inline uint16x8_t validMask8(const int32_t* pixels)
+{
+  const int32x4_t zero = vdupq_n_s32(0);
+  return vcombine_u16(vmovn_u32(vcgeq_s32(vld1q_s32(pixels), zero)),
+                      vmovn_u32(vcgeq_s32(vld1q_s32(pixels + 4), zero)));
+}
+
+// 8 pixels per step, columns of rows: the left and right column are
+// interpolated between the rows, then between each other.
+static void remapMono8(const uint8_t* src, uint32_t width, const int32_t* pixels, const uint8_t* weights,
+                       int n, uint8_t* dst)
+{
+  const uint8x8_t one = vdup_n_u8(UP_WEIGHT_ONE);
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    uint8_t a[8], b[8], c[8], d[8];
+    for(int k = 0; k < 8; k++) {
+      const uint8_t* p = src + (pixels[i + k] < 0 ? 0 : pixels[i + k]);
+      a[k] = p[0];
+      b[k] = p[1];
+      c[k] = p[width];
+      d[k] = p[width + 1];
+    }
+    const uint8x8x2_t w = vld2_u8(weights + 2 * i);
+    const uint8x8_t wy1 = vsub_u8(one, w.val[1]);
+    const uint16x8_t left = vmlal_u8(vmull_u8(vld1_u8(a), wy1), vld1_u8(c), w.val[1]);
+    const uint16x8_t right = vmlal_u8(vmull_u8(vld1_u8(b), wy1), vld1_u8(d), w.val[1]);
+    const uint16x8_t wx = vmovl_u8(w.val[0]);
+    const uint16x8_t wx1 = vmovl_u8(vsub_u8(one, w.val[0]));
+    const uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(left), vget_low_u16(wx1)),
+                                    vget_low_u16(right), vget_low_u16(wx));
+    const uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(left), vget_high_u16(wx1)),
+                                    vget_high_u16(right), vget_high_u16(wx));
+    const uint16x8_t v = vcombine_u16(vrshrn_n_u32(lo, 2 * UP_WEIGHT_BITS), vrshrn_n_u32(hi, 2 * UP_WEIGHT_BITS));
+    vst1_u8(dst + i, vmovn_u16(vandq_u16(v, validMask8(pixels + i))));
+  }
+  remapBilinear<uint8_t, 1>(src, width, pixels + i, weights + 2 * i, n - i, dst + i);
+}
+
+// One pixel per step, the 8 byte loads read 2 bytes past the right pixel.
+static void remapColor8(const uint8_t* src, uint32_t width, uint32_t height, const int32_t* pixels,
+                        const uint8_t* weights, int n, uint8_t* dst)
+{
+  const size_t stride = (size_t)width * 3;
+  const size_t total = stride * height;
+  for(int i = 0; i < n; i++, dst += 3) {
+    const size_t offset = (size_t)pixels[i] * 3;
+    if(pixels[i] < 0 || offset + stride + 8 > total) {
+      remapBilinear<uint8_t, 3>(src, width, pixels + i, weights + 2 * i, 1, dst);
+      continue;
+    }
+    const int wx = weights[2 * i], wy = weights[2 * i + 1];
+    // left pixel in lanes 0 to 2, right pixel in lanes 3 to 5
+    const uint16x8_t rows = vmlal_u8(vmull_u8(vld1_u8(src + offset), vdup_n_u8((uint8_t)(UP_WEIGHT_ONE - wy))),
+                                     vld1_u8(src + offset + stride), vdup_n_u8((uint8_t)wy));
+    const uint32x4_t v = vmlal_n_u16(vmull_n_u16(vget_low_u16(rows), (uint16_t)(UP_WEIGHT_ONE - wx)),
+                                     vget_low_u16(vextq_u16(rows, rows, 3)), (uint16_t)wx);
+    const uint16x4_t r = vrshrn_n_u32(v, 2 * UP_WEIGHT_BITS);
+    dst[0] = (uint8_t)vget_lane_u16(r, 0);
+    dst[1] = (uint8_t)vget_lane_u16(r, 1);
+    dst[2] = (uint8_t)vget_lane_u16(r, 2);
+  }
+}
+
+// 8 pixels per step as remapMono8, the columns in 32 bits.
+static void remapMono16(const uint16_t* src, uint32_t width, const int32_t* pixels, const uint8_t* weights,
+                        int n, uint16_t* dst)
+{
+  const uint8x8_t one = vdup_n_u8(UP_WEIGHT_ONE);
+  int i = 0;
+  for(; i + 8 <= n; i += 8) {
+    uint16_t a[8], b[8], c[8], d[8];
+    for(int k = 0; k < 8; k++) {
+      const uint16_t* p = src + (pixels[i + k] < 0 ? 0 : pixels[i + k]);
+      a[k] = p[0];
+      b[k] = p[1];
+      c[k] = p[width];
+      d[k] = p[width + 1];
+    }
+    const uint8x8x2_t w = vld2_u8(weights + 2 * i);
+    const uint16x8_t wx = vmovl_u8(w.val[0]), wx1 = vmovl_u8(vsub_u8(one, w.val[0]));
+    const uint16x8_t wy = vmovl_u8(w.val[1]), wy1 = vmovl_u8(vsub_u8(one, w.val[1]));
+    uint16x4_t r[2];
+    for(int h = 0; h < 2; h++) {
+      const uint16x4_t pa = vld1_u16(a + 4 * h), pb = vld1_u16(b + 4 * h);
+      const uint16x4_t pc = vld1_u16(c + 4 * h), pd = vld1_u16(d + 4 * h);
+      const uint16x4_t x = h ? vget_high_u16(wx) : vget_low_u16(wx);
+      const uint16x4_t x1 = h ? vget_high_u16(wx1) : vget_low_u16(wx1);
+      const uint16x4_t y = h ? vget_high_u16(wy) : vget_low_u16(wy);
+      const uint16x4_t y1 = h ? vget_high_u16(wy1) : vget_low_u16(wy1);
+      // below 2^23 per column, 2^30 in the sum
+      const uint32x4_t left = vmlal_u16(vmull_u16(pa, y1), pc, y);
+      const uint32x4_t right = vmlal_u16(vmull_u16(pb, y1), pd, y);
+      const uint32x4_t v = vmlaq_u32(vmulq_u32(left, vmovl_u16(x1)), right, vmovl_u16(x));
+      r[h] = vrshrn_n_u32(v, 2 * UP_WEIGHT_BITS);
+    }
+    vst1q_u16(dst + i, vandq_u16(vcombine_u16(r[0], r[1]), validMask8(pixels + i)));
+  }
+  remapBilinear<uint16_t, 1>(src, width, pixels + i, weights + 2 * i, n - i, dst + i);
+}
+#endif
+
+// n output pixels of the given source pixels and weights.
+static void remapTaps(TY_PIXEL_FORMAT format, const uint8_t* src, uint32_t width, uint32_t height,
+                      const int32_t* pixels, const uint8_t* weights, int n, uint8_t* dst)
+{
+  switch(format) {
+    case TY_PIXEL_FORMAT_DEPTH16:
+      remapNearest16((const uint16_t*)src, pixels, n, (uint16_t*)dst);
+      break;
+    case TY_PIXEL_FORMAT_MONO:
+#if defined(TY_UP_SSE2) || defined(TY_UP_NEON)
+      remapMono8(src, width, pixels, weights, n, dst);
+#else
+      remapBilinear<uint8_t, 1>(src, width, pixels, weights, n, dst);
+#endif
+      break;
+    case TY_PIXEL_FORMAT_RGB:
+    case TY_PIXEL_FORMAT_BGR:
+#if defined(TY_UP_SSE2) || defined(TY_UP_NEON)
+      remapColor8(src, width, height, pixels, weights, n, dst);
+#else
+      remapBilinear<uint8_t, 3>(src, width, pixels, weights, n, dst);
+#endif
+      break;
+    case TY_PIXEL_FORMAT_MONO16:
+#if defined(TY_UP_SSE2) || defined(TY_UP_NEON)
+      remapMono16((const uint16_t*)src, width, pixels, weights, n, (uint16_t*)dst);
+#else
+      remapBilinear<uint16_t, 1>((const uint16_t*)src, width, pixels, weights, n, (uint16_t*)dst);
+#endif
+      break;
+    default:
+      remapBilinear<uint16_t, 3>((const uint16_t*)src, width, pixels, weights, n, (uint16_t*)dst);
+      break;
+  }
+}
+
+void UndistortionPlan::bands(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const UndistortionPlan& self = *job.self;
+  const uint32_t W = self._width;
+  const size_t pixelSize = TYBitsPerPixel(self._format) / 8;
+  for(int band = begin; band < end; band++) {
+    const uint32_t v0 = band * UP_BAND_ROWS;
+    const uint32_t v1 = v0 + UP_BAND_ROWS < self._height ? v0 + UP_BAND_ROWS : self._height;
+    const size_t first = (size_t)v0 * W;
+    remapTaps(self._format, job.src, W, self._height, self._pixels + first, self._weights + 2 * first,
+              (int)((v1 - v0) * W), job.dst + first * pixelSize);
+  }
+}
+
+UndistortionPlan::UndistortionPlan()
+  : _width(0)
+  , _height(0)
+  , _format(TY_PIXEL_FORMAT_UNDEFINED)
+  , _threads(0)
+  , _pixels(NULL)
+  , _weights(NULL)
+{
+  memset(&_calib, 0, sizeof(_calib));
+  memset(&_intrinsic, 0, sizeof(_intrinsic));
+}
+
+TY_STATUS UndistortionPlan::init(const TY_CAMERA_CALIB_INFO* calib, uint32_t width, uint32_t height,
+                                 TY_PIXEL_FORMAT format, const TY_CAMERA_INTRINSIC* newIntrinsic,
+                                 const TableCache* cache)
+{
+  if(!calib) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(width < 2 || height < 2 || !calib->intrinsicWidth || !calib->intrinsicHeight || !supports(format)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  const float* K = calib->intrinsic.data;
+  const float sx = 1.0f * width / calib->intrinsicWidth;
+  const float sy = 1.0f * height / calib->intrinsicHeight;
+  TY_CAMERA_INTRINSIC out;
+  if(newIntrinsic) {
+    out = *newIntrinsic;
+  } else {
+    memset(&out, 0, sizeof(out));
+    out.data[0] = K[0] * sx;
+    out.data[2] = K[2] * sx;
+    out.data[4] = K[4] * sy;
+    out.data[5] = K[5] * sy;
+    out.data[8] = 1.f;
+  }
+  // the table does not depend on the format beyond nearest or bilinear
+  const uint32_t nearest = format == TY_PIXEL_FORMAT_DEPTH16;
+  if(_pixels && width == _width && height == _height && nearest == (_format == TY_PIXEL_FORMAT_DEPTH16)
+      && memcmp(calib, &_calib, sizeof(_calib)) == 0 && memcmp(&out, &_intrinsic, sizeof(out)) == 0) {
+    _format = format;
+    return TY_STATUS_OK;
+  }
+  _pixels = NULL;
+  _weights = NULL;
+  _table.clear();
+  _file.close();
+  if(K[0] == 0.f || K[4] == 0.f || out.data[0] == 0.f || out.data[4] == 0.f) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  const size_t count = (size_t)width * height;
+  const size_t tableSize = count * (sizeof(int32_t) + 2);
+  TableKey key("undistort", UP_TABLE_VERSION);
+  key.add(calib).add(width).add(height).add(nearest).add(&out, sizeof(out));
+  const void* payload = NULL;
+  size_t size = 0;
+  const uint8_t* table = NULL;
+  if(cache && cache->load(key, _file, &payload, &size) && size == tableSize) {
+    table = (const uint8_t*)payload;
+  } else {
+    _file.close();
+    _table.resize(tableSize);
+    int32_t* pixels = (int32_t*)&_table[0];
+    uint8_t* weights = &_table[count * sizeof(int32_t)];
+    const double fx = K[0] * sx, cx = K[2] * sx, fy = K[4] * sy, cy = K[5] * sy;
+    const float* k = calib->distortion.data;
+    for(uint32_t v = 0; v < height; v++) {
+      const double y = (v - out.data[5]) / out.data[4];
+      for(uint32_t u = 0; u < width; u++, pixels++, weights += 2) {
+        // output ray through the lens model, see TY_CAMERA_DISTORTION
+        const double x = (u - out.data[2]) / out.data[0];
+        const double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+        const double radial = (1 + k[0] * r2 + k[1] * r4 + k[4] * r6) / (1 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+        const double xd = x * radial + 2 * k[2] * x * y + k[3] * (r2 + 2 * x * x) + k[8] * r2 + k[9] * r4;
+        const double yd = y * radial + k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y + k[10] * r2 + k[11] * r4;
+        const double su = xd * fx + cx, sv = yd * fy + cy;
+        weights[0] = weights[1] = 0;
+        if(!(su >= 0 && sv >= 0 && su <= width - 1 && sv <= height - 1)) {
+          *pixels = -1;
+        } else if(nearest) {
+          *pixels = (int32_t)((uint32_t)(sv + 0.5) * width + (uint32_t)(su + 0.5));
+        } else {
+          // the last row and column interpolate from the one before
+          const uint32_t x0 = (uint32_t)su < width - 1 ? (uint32_t)su : width - 2;
+          const uint32_t y0 = (uint32_t)sv < height - 1 ? (uint32_t)sv : height - 2;
+          *pixels = (int32_t)(y0 * width + x0);
+          weights[0] = (uint8_t)floor((su - x0) * UP_WEIGHT_ONE + 0.5);
+          weights[1] = (uint8_t)floor((sv - y0) * UP_WEIGHT_ONE + 0.5);
+        }
+      }
+    }
+    if(cache && cache->enabled()) {
+      cache->store(key, &_table[0], tableSize);
+    }
+    table = &_table[0];
+  }
+
+  _pixels = (const int32_t*)table;
+  _weights = table + count * sizeof(int32_t);
+  _calib = *calib;
+  _intrinsic = out;
+  _width = width;
+  _height = height;
+  _format = format;
+  return TY_STATUS_OK;
+}
+
+TY_STATUS UndistortionPlan::execute(const void* src, void* dst) const
+{
+  if(!_pixels) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!src || !dst) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  Job job = {this, (const uint8_t*)src, (uint8_t*)dst};
+  TYParallelFor((int)((_height + UP_BAND_ROWS - 1) / UP_BAND_ROWS), _threads, bands, &job);
+  return TY_STATUS_OK;
+}
+
+TY_STATUS UndistortionPlan::remap(TY_PIXEL_FORMAT format, const void* src, const int32_t* outputPixels,
+                                  uint32_t count, void* dst) const
+{
+  if(!_pixels) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!src || !outputPixels || !dst) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!supports(format) || (format == TY_PIXEL_FORMAT_DEPTH16) != (_format == TY_PIXEL_FORMAT_DEPTH16)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  const size_t pixelSize = TYBitsPerPixel(format) / 8;
+  int32_t pixels[UP_GATHER_SIZE];
+  uint8_t weights[2 * UP_GATHER_SIZE];
+  for(uint32_t first = 0; first < count; first += UP_GATHER_SIZE) {
+    const int n = count - first < UP_GATHER_SIZE ? (int)(count - first) : UP_GATHER_SIZE;
+    for(int i = 0; i < n; i++) {
+      const int32_t p = outputPixels[first + i];
+      pixels[i] = p < 0 ? -1 : _pixels[p];
+      weights[2 * i] = p < 0 ? 0 : _weights[2 * p];
+      weights[2 * i + 1] = p < 0 ? 0 : _weights[2 * p + 1];
+    }
+    remapTaps(format, (const uint8_t*)src, _width, _height, pixels, weights, n, (uint8_t*)dst + first * pixelSize);
+  }
+  return TY_STATUS_OK;
+}
+
+TY_STATUS UndistortionPlan::nearestSource(const int32_t* outputPixels, uint32_t count, int32_t* sourcePixels) const
+{
+  if(!_pixels) {
+    return TY_STATUS_NOT_INITED;
+  }
+  if(!outputPixels || !sourcePixels) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  for(uint32_t i = 0; i < count; i++) {
+    const int32_t p = outputPixels[i];
+    const int32_t s = p < 0 ? -1 : _pixels[p];
+    if(s < 0 || _format == TY_PIXEL_FORMAT_DEPTH16) {
+      // nearest tables already hold the nearest pixel
+      sourcePixels[i] = s;
+      continue;
+    }
+    // bilinear tables keep the top left tap, x0 + 1 and y0 + 1 are inside
+    const int32_t dx = _weights[2 * p] >= UP_WEIGHT_ONE / 2 ? 1 : 0;
+    const int32_t dy = _weights[2 * p + 1] >= UP_WEIGHT_ONE / 2 ? (int32_t)_width : 0;
+    sourcePixels[i] = s + dx + dy;
+  }
+  return TY_STATUS_OK;
+}
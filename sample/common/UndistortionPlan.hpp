@@ -0,0 +1,97 @@
+#ifndef XYZ_UNDISTORTION_PLAN_HPP_
+#define XYZ_UNDISTORTION_PLAN_HPP_
+
+#include <vector>
+#include "TYCoordinateMapper.h"
+#include "TableCache.hpp"
+
+/// @brief Precomputed TYUndistortImage.
+///
+/// init() finds, once per calibration, size, pixel format and new intrinsic,
+/// the source position of every output pixel through the lens model and
+/// keeps it in fixed point. execute() is then a remap into a buffer of the
+/// caller, with no allocation: bilinear for MONO, MONO16, RGB, BGR, RGB48
+/// and BGR48, nearest for DEPTH16 so no depth is made up across edges. Row
+/// bands are spread over worker threads. MONO, RGB, BGR and MONO16 use SSE2
+/// or NEON where available and give the same values as the scalar code,
+/// RGB48 and BGR48 stay scalar. Output pixels that map outside of the
+/// source are 0.
+class UndistortionPlan
+{
+public:
+    UndistortionPlan();
+
+    /// @brief Build the remap table, kept as is if nothing changed.
+    /// @param  [in]  calib                 Calibration data of the image.
+    /// @param  [in]  width                 Width of the image, source and output.
+    /// @param  [in]  height                Height of the image.
+    /// @param  [in]  format                Pixel format, see above.
+    /// @param  [in]  newIntrinsic          Intrinsic of the output at width x height, NULL for the one of calib.
+    /// @param  [in]  cache                 Optional table cache, the table is mapped from it if present.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NULL_POINTER      calib is NULL.
+    /// @retval TY_STATUS_INVALID_PARAMETER Bad size, intrinsic or unsupported pixel format.
+    TY_STATUS init(const TY_CAMERA_CALIB_INFO* calib, uint32_t width, uint32_t height, TY_PIXEL_FORMAT format,
+                   const TY_CAMERA_INTRINSIC* newIntrinsic = NULL, const TableCache* cache = NULL);
+
+    /// @brief Worker threads used by execute(), 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Undistort one image.
+    /// @param  [in]  src                   Source image, width x height in the format of init().
+    /// @param  [out] dst                   Output image, same size and format, not src.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      src or dst is NULL.
+    TY_STATUS execute(const void* src, void* dst) const;
+
+    /// @brief Undistorted values of some output pixels only, e.g. those a registration lookup table hits.
+    /// @param  [in]  format                Pixel format of src and dst, DEPTH16 only if init() was.
+    /// @param  [in]  src                   Source image, width x height.
+    /// @param  [in]  outputPixels          Output pixel indices v * width + u, negative for none.
+    /// @param  [in]  count                 Number of indices.
+    /// @param  [out] dst                   count pixels, 0 for none.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      An input or output is NULL.
+    /// @retval TY_STATUS_INVALID_PARAMETER Unsupported format, or DEPTH16 against a bilinear table.
+    TY_STATUS remap(TY_PIXEL_FORMAT format, const void* src, const int32_t* outputPixels,
+                    uint32_t count, void* dst) const;
+
+    /// @brief Source pixel nearest to where some output pixels come from, for
+    ///        formats execute() does not handle, e.g. raw YUYV or BAYER8.
+    /// @param  [in]  outputPixels          Output pixel indices v * width + u, negative for none.
+    /// @param  [in]  count                 Number of indices.
+    /// @param  [out] sourcePixels          count source pixel indices, -1 for none or outside.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NOT_INITED        Table not built.
+    /// @retval TY_STATUS_NULL_POINTER      outputPixels or sourcePixels is NULL.
+    TY_STATUS nearestSource(const int32_t* outputPixels, uint32_t count, int32_t* sourcePixels) const;
+
+    /// @brief Whether execute() handles the format.
+    static bool supports(TY_PIXEL_FORMAT format);
+
+    bool            isValid() const { return _pixels != NULL; }
+    uint32_t        width()   const { return _width; }
+    uint32_t        height()  const { return _height; }
+    TY_PIXEL_FORMAT format()  const { return _format; }
+
+private:
+    UndistortionPlan(const UndistortionPlan&);
+    UndistortionPlan& operator=(const UndistortionPlan&);
+
+    struct Job;
+    static void bands(int begin, int end, void* arg);
+
+    uint32_t             _width, _height;
+    TY_PIXEL_FORMAT      _format;
+    int                  _threads;
+    TY_CAMERA_CALIB_INFO _calib;
+    TY_CAMERA_INTRINSIC  _intrinsic;    // of the output
+    const int32_t*       _pixels;       // top left source pixel per output pixel, -1 outside
+    const uint8_t*       _weights;      // x then y weight per output pixel, 1 / 128 steps
+    std::vector<uint8_t> _table;        // pixels then weights, or in _file
+    MappedFile           _file;
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include <string.h>
+#include <limits>
+#include <algorithm>
+#include "VoxelGrid.hpp"
+#include "TYThread.hpp"
+
+// points per task, tasks are spread over the worker threads
+#define VG_TASK_POINTS  (65536)
+// key bits sorted per radix pass
+#define VG_RADIX_BITS   (11)
+#define VG_RADIX_SIZE   (1 << VG_RADIX_BITS)
+
+static inline int bitLength(uint64_t v)
+{
+  int bits = 0;
+  while(v) {
+    bits++;
+    v >>= 1;
+  }
+  return bits;
+}
+
+static inline uint32_t taskCount(uint32_t n)
+{
+  return (n + VG_TASK_POINTS - 1) / VG_TASK_POINTS;
+}
+
+struct VoxelGrid::Job
+{
+  const VoxelGrid* self;
+  const TY_VECT_3F* points;
+  uint32_t n;                         // input points
+  uint32_t items;                     // sorted items, runs of valid points
+  const uint8_t* rgb;
+  TY_VECT_3F* out;
+  uint8_t* outRgb;
+  float* bounds;
+  uint32_t* offsets;
+  uint32_t* histogram;
+  uint8_t* runs;                      // run length at the first index of each run
+  const uint64_t* src;                // radix pass input
+  uint64_t* dst;                      // radix pass output
+  int shift;                          // first bit of the radix pass digit
+  int indexBits;
+  float origin[3];
+  float inv[3];
+  uint32_t dims[3];
+};
+
+static inline bool validPoint(const TY_VECT_3F& p)
+{
+  return p.x == p.x && p.y == p.y && p.z == p.z;
+}
+
+inline uint64_t VoxelGrid::voxelKey(const Job& job, const TY_VECT_3F& p)
+{
+  const uint32_t ix = std::min((uint32_t)((p.x - job.origin[0]) * job.inv[0]), job.dims[0] - 1);
+  const uint32_t iy = std::min((uint32_t)((p.y - job.origin[1]) * job.inv[1]), job.dims[1] - 1);
+  const uint32_t iz = std::min((uint32_t)((p.z - job.origin[2]) * job.inv[2]), job.dims[2] - 1);
+  return ((uint64_t)iz * job.dims[1] + iy) * job.dims[0] + ix;
+}
+
+VoxelGrid::VoxelGrid()
+  : _selection(VOXEL_CENTROID)
+  , _threads(0)
+{
+  _leaf[0] = _leaf[1] = _leaf[2] = 0.f;
+}
+
+void VoxelGrid::setLeafSize(float x, float y, float z)
+{
+  _leaf[0] = x;
+  _leaf[1] = y;
+  _leaf[2] = z;
+}
+
+// Per task bounds and number of valid points of the input.
+void VoxelGrid::boundsTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.n);
+    float lo[3], hi[3];
+    lo[0] = lo[1] = lo[2] = std::numeric_limits<float>::max();
+    hi[0] = hi[1] = hi[2] = -std::numeric_limits<float>::max();
+    uint32_t valid = 0;
+    for(uint32_t i = first; i < last; i++) {
+      const TY_VECT_3F& p = job.points[i];
+      if(!validPoint(p)) {
+        continue;
+      }
+      lo[0] = std::min(lo[0], p.x);
+      lo[1] = std::min(lo[1], p.y);
+      lo[2] = std::min(lo[2], p.z);
+      hi[0] = std::max(hi[0], p.x);
+      hi[1] = std::max(hi[1], p.y);
+      hi[2] = std::max(hi[2], p.z);
+      valid++;
+    }
+    memcpy(job.bounds + 6 * t, lo, sizeof(lo));
+    memcpy(job.bounds + 6 * t + 3, hi, sizeof(hi));
+    job.offsets[t] = valid;
+  }
+}
+
+// One item per run of consecutive input points in the same voxel, neighbour
+// pixels of an organized cloud mostly are, the sort gets several times fewer
+// items. Runs do not cross tasks and are at most 255 points. Items are
+// written from the first input index of the task, offsets get the number
+// written.
+void VoxelGrid::keyTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.n);
+    uint64_t* const start = job.dst + first;
+    uint64_t* item = start;
+    uint64_t prev = ~(uint64_t)0;
+    uint8_t* run = NULL;
+    for(uint32_t i = first; i < last; i++) {
+      const TY_VECT_3F& p = job.points[i];
+      if(!validPoint(p)) {
+        prev = ~(uint64_t)0;
+        continue;
+      }
+      const uint64_t key = voxelKey(job, p);
+      if(key != prev || *run == 255) {
+        *item++ = (key << job.indexBits) | i;
+        prev = key;
+        run = job.runs + i;
+        *run = 0;
+      }
+      ++*run;
+    }
+    job.offsets[t] = (uint32_t)(item - start);
+  }
+}
+
+void VoxelGrid::histogramTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.items);
+    uint32_t* h = job.histogram + (size_t)t * VG_RADIX_SIZE;
+    memset(h, 0, sizeof(uint32_t) * VG_RADIX_SIZE);
+    for(uint32_t i = first; i < last; i++) {
+      h[(job.src[i] >> job.shift) & (VG_RADIX_SIZE - 1)]++;
+    }
+  }
+}
+
+// Tasks scatter in item order to the positions their histogram rows were
+// turned into, the sort is stable.
+void VoxelGrid::scatterTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.items);
+    uint32_t* pos = job.histogram + (size_t)t * VG_RADIX_SIZE;
+    for(uint32_t i = first; i < last; i++) {
+      const uint64_t item = job.src[i];
+      job.dst[pos[(item >> job.shift) & (VG_RADIX_SIZE - 1)]++] = item;
+    }
+  }
+}
+
+// Voxels starting in each task.
+void VoxelGrid::countTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.items);
+    uint32_t voxels = 0;
+    for(uint32_t i = first; i < last; i++) {
+      voxels += i == 0 || (job.src[i] >> job.indexBits) != (job.src[i - 1] >> job.indexBits);
+    }
+    job.offsets[t] = voxels;
+  }
+}
+
+// One output point per voxel starting in the task, a voxel may run into
+// the next task.
+void VoxelGrid::voxelTasks(int begin, int end, void* arg)
+{
+  const Job& job = *(const Job*)arg;
+  const uint64_t* items = job.src;
+  const uint64_t mask = ((uint64_t)1 << job.indexBits) - 1;
+  const bool centroid = job.self->_selection == VOXEL_CENTROID;
+  for(int t = begin; t < end; t++) {
+    const uint32_t first = (uint32_t)t * VG_TASK_POINTS;
+    const uint32_t last = std::min<uint32_t>(first + VG_TASK_POINTS, job.items);
+    uint32_t i = first;
+    while(i < last && i > 0 && (items[i] >> job.indexBits) == (items[i - 1] >> job.indexBits)) {
+      i++;
+    }
+    uint32_t k = job.offsets[t];
+    while(i < last) {
+      const uint64_t key = items[i] >> job.indexBits;
+      uint32_t j = i + 1;
+      while(j < job.items && (items[j] >> job.indexBits) == key) {
+        j++;
+      }
+      // lowest index first, the sort kept the index order within a voxel
+      const TY_VECT_3F& p0 = job.points[items[i] & mask];
+      if(!centroid && !job.outRgb) {
+        job.out[k] = p0;
+      } else {
+        // offsets from the first point keep the sum precise far from the origin
+        float sx = 0.f, sy = 0.f, sz = 0.f;
+        uint32_t s[3] = {0, 0, 0};
+        uint32_t n = 0;
+        for(uint32_t m = i; m < j; m++) {
+          const uint32_t run = (uint32_t)(items[m] & mask);
+          for(uint32_t idx = run; idx < run + job.runs[run]; idx++) {
+            const TY_VECT_3F& p = job.points[idx];
+            sx += p.x - p0.x;
+            sy += p.y - p0.y;
+            sz += p.z - p0.z;
+            if(job.outRgb) {
+              const uint8_t* c = job.rgb + 3 * idx;
+              s[0] += c[0];
+              s[1] += c[1];
+              s[2] += c[2];
+            }
+            n++;
+          }
+        }
+        if(centroid) {
+          const float w = 1.f / n;
+          job.out[k].x = p0.x + sx * w;
+          job.out[k].y = p0.y + sy * w;
+          job.out[k].z = p0.z + sz * w;
+        } else {
+          job.out[k] = p0;
+        }
+        if(job.outRgb) {
+          for(int c = 0; c < 3; c++) {
+            job.outRgb[3 * k + c] = (uint8_t)((s[c] + n / 2) / n);
+          }
+        }
+      }
+      k++;
+      i = j;
+    }
+  }
+}
+
+TY_STATUS VoxelGrid::filter(const TY_VECT_3F* points, uint32_t n, const uint8_t* rgb,
+                            TY_VECT_3F* out, uint8_t* outRgb, uint32_t* count)
+{
+  if(!points || !out || !count) {
+    return TY_STATUS_NULL_POINTER;
+  }
+  if(!(_leaf[0] > 0.f && _leaf[1] > 0.f && _leaf[2] > 0.f)) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+  *count = 0;
+  if(!n) {
+    return TY_STATUS_OK;
+  }
+
+  Job job;
+  memset(&job, 0, sizeof(job));
+  job.self = this;
+  job.points = points;
+  job.n = n;
+  job.rgb = rgb;
+  job.out = out;
+  job.outRgb = rgb ? outRgb : NULL;
+
+  const uint32_t inputTasks = taskCount(n);
+  _bounds.resize(6 * inputTasks);
+  _offsets.resize(inputTasks + 1);
+  job.bounds = &_bounds[0];
+  job.offsets = &_offsets[0];
+  TYParallelFor(inputTasks, _threads, boundsTasks, &job);
+
+  float lo[3], hi[3];
+  lo[0] = lo[1] = lo[2] = std::numeric_limits<float>::max();
+  hi[0] = hi[1] = hi[2] = -std::numeric_limits<float>::max();
+  uint32_t valid = 0;
+  for(uint32_t t = 0; t < inputTasks; t++) {
+    for(int c = 0; c < 3; c++) {
+      lo[c] = std::min(lo[c], _bounds[6 * t + c]);
+      hi[c] = std::max(hi[c], _bounds[6 * t + 3 + c]);
+    }
+    valid += _offsets[t];
+  }
+  if(!valid) {
+    return TY_STATUS_OK;
+  }
+
+  // key = (iz * ny + iy) * nx + ix above the point index
+  double cells = 1.0;
+  for(int c = 0; c < 3; c++) {
+    const double d = (double(hi[c]) - lo[c]) / _leaf[c] + 1.0;
+    if(d >= 4294967295.0) {
+      return TY_STATUS_INVALID_PARAMETER;
+    }
+    job.origin[c] = lo[c];
+    job.inv[c] = 1.f / _leaf[c];
+    job.dims[c] = (uint32_t)d;
+    cells *= job.dims[c];
+  }
+  job.indexBits = bitLength(n - 1);
+  const int keyBits = std::max(1, bitLength((uint64_t)(cells - 1)));
+  if(cells > 9.0e18 || keyBits + job.indexBits > 64) {
+    return TY_STATUS_INVALID_PARAMETER;
+  }
+
+  _items[0].resize(n);
+  _items[1].resize(n);
+  _runs.resize(n);
+  job.dst = &_items[0][0];
+  job.runs = &_runs[0];
+  TYParallelFor(inputTasks, _threads, keyTasks, &job);
+  // close the gaps between the items of the tasks, in order
+  uint32_t runs = 0;
+  for(uint32_t t = 0; t < inputTasks; t++) {
+    memmove(&_items[0][runs], &_items[0][(size_t)t * VG_TASK_POINTS], _offsets[t] * sizeof(uint64_t));
+    runs += _offsets[t];
+  }
+  job.items = runs;
+
+  const uint32_t tasks = taskCount(runs);
+  _histogram.resize((size_t)tasks * VG_RADIX_SIZE);
+  _offsets.resize(tasks + 1);
+  job.histogram = &_histogram[0];
+  job.offsets = &_offsets[0];
+  int cur = 0;
+  for(int shift = 0; shift < keyBits; shift += VG_RADIX_BITS) {
+    job.src = &_items[cur][0];
+    job.dst = &_items[1 - cur][0];
+    job.shift = job.indexBits + shift;
+    TYParallelFor(tasks, _threads, histogramTasks, &job);
+    // digit major, task minor positions; skip the pass if one digit holds all
+    uint32_t pos = 0;
+    bool single = false;
+    for(uint32_t d = 0; d < VG_RADIX_SIZE && !single; d++) {
+      const uint32_t start = pos;
+      for(uint32_t t = 0; t < tasks; t++) {
+        uint32_t& h = _histogram[(size_t)t * VG_RADIX_SIZE + d];
+        const uint32_t m = h;
+        h = pos;
+        pos += m;
+      }
+      single = pos - start == runs;
+    }
+    if(single) {
+      continue;
+    }
+    TYParallelFor(tasks, _threads, scatterTasks, &job);
+    cur = 1 - cur;
+  }
+
+  job.src = &_items[cur][0];
+  TYParallelFor(tasks, _threads, countTasks, &job);
+  uint32_t voxels = 0;
+  for(uint32_t t = 0; t < tasks; t++) {
+    const uint32_t m = _offsets[t];
+    _offsets[t] = voxels;
+    voxels += m;
+  }
+  TYParallelFor(tasks, _threads, voxelTasks, &job);
+  *count = voxels;
+  return TY_STATUS_OK;
+}
@@ -0,0 +1,70 @@
+#ifndef XYZ_VOXEL_GRID_HPP_
+#define XYZ_VOXEL_GRID_HPP_
+
+#include <vector>
+#include "TYCoordinateMapper.h"
+
+/// @brief Voxel grid downsampling of TY_VECT_3F clouds, one point per occupied voxel.
+///
+/// Input may be organized (NaN points are skipped) or packed. Points get a
+/// voxel key, one (key, index) item per run of consecutive points in the
+/// same voxel is radix sorted with the work split into tasks over worker
+/// threads, runs of equal keys are then the voxels. No hash table, and
+/// memory is linear in the point count whatever the extent of the cloud.
+/// Buffers are kept between calls.
+class VoxelGrid
+{
+public:
+    enum Selection {
+        VOXEL_CENTROID,                 ///< Mean of the points in the voxel.
+        VOXEL_FIRST_POINT,              ///< Input point of lowest index in the voxel.
+    };
+
+    VoxelGrid();
+
+    /// @brief Voxel size, same unit as the points.
+    void setLeafSize(float size) { setLeafSize(size, size, size); }
+    void setLeafSize(float x, float y, float z);
+
+    void setSelection(Selection selection) { _selection = selection; }
+
+    /// @brief Worker threads, 0 for one per cpu.
+    void setThreadCount(int threads) { _threads = threads; }
+
+    /// @brief Downsample a cloud, output in voxel order.
+    /// @param  [in]  points                Input points.
+    /// @param  [in]  n                     Number of points.
+    /// @param  [in]  rgb                   Optional, 3 bytes per input point, averaged per voxel.
+    /// @param  [out] out                   Output points, room for the number of valid inputs.
+    /// @param  [out] outRgb                Optional, 3 bytes per output point, needs rgb.
+    /// @param  [out] count                 Number of output points.
+    /// @retval TY_STATUS_OK                Succeed.
+    /// @retval TY_STATUS_NULL_POINTER      points, out or count is NULL.
+    /// @retval TY_STATUS_INVALID_PARAMETER Leaf size not set, or too small for the extent of the cloud.
+    TY_STATUS filter(const TY_VECT_3F* points, uint32_t n, const uint8_t* rgb,
+                     TY_VECT_3F* out, uint8_t* outRgb, uint32_t* count);
+
+private:
+    VoxelGrid(const VoxelGrid&);
+    VoxelGrid& operator=(const VoxelGrid&);
+
+    struct Job;
+    static uint64_t voxelKey(const Job& job, const TY_VECT_3F& p);
+    static void boundsTasks(int begin, int end, void* arg);
+    static void keyTasks(int begin, int end, void* arg);
+    static void histogramTasks(int begin, int end, void* arg);
+    static void scatterTasks(int begin, int end, void* arg);
+    static void countTasks(int begin, int end, void* arg);
+    static void voxelTasks(int begin, int end, void* arg);
+
+    float                 _leaf[3];
+    Selection             _selection;
+    int                   _threads;
+    std::vector<uint64_t> _items[2];    // key << index bits | first index of the run
+    std::vector<uint8_t>  _runs;        // run length at the first index of each run
+    std::vector<uint32_t> _histogram;   // per task and digit
+    std::vector<float>    _bounds;      // per task min and max
+    std::vector<uint32_t> _offsets;     // per task
+};
+
+#endif
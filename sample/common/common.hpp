@@ -372,25 +372,26 @@ enum{
     PC_FILE_FORMAT_XYZ = 0,
 };
 
-static void writePC_XYZ(const cv::Point3f* pnts, const cv::Vec3b *color, size_t n, FILE* fp)
+// dense: pnts holds valid points only, as PointCloudGenerator::computeDense() writes
+static void writePC_XYZ(const cv::Point3f* pnts, const cv::Vec3b *color, size_t n, FILE* fp, bool dense = false)
 {
     if (color){
         for (size_t i = 0; i < n; i++){
-            if (!std::isnan(pnts[i].x)){
+            if (dense || !std::isnan(pnts[i].x)){
                 fprintf(fp, "%f %f %f %d %d %d\n", pnts[i].x, pnts[i].y, pnts[i].z, color[i][0], color[i][1], color[i][2]);
             }
         }
     }
     else{
         for (size_t i = 0; i < n; i++){
-            if (!std::isnan(pnts[i].x)){
+            if (dense || !std::isnan(pnts[i].x)){
                 fprintf(fp, "%f %f %f 0 0 0\n", pnts[i].x, pnts[i].y, pnts[i].z);
             }
         }
     }
 }
 
-static void writePointCloud(const cv::Point3f* pnts, const cv::Vec3b *color, size_t n, const char* file, int format)
+static void writePointCloud(const cv::Point3f* pnts, const cv::Vec3b *color, size_t n, const char* file, int format, bool dense = false)
 {
     FILE* fp = fopen(file, "w");
     if (!fp){
@@ -399,7 +400,7 @@ static void writePointCloud(const cv::Point3f* pnts, const cv::Vec3b *color, siz
 
     switch (format){
     case PC_FILE_FORMAT_XYZ:
-        writePC_XYZ(pnts, color, n, fp);
+        writePC_XYZ(pnts, color, n, fp, dense);
         break;
     default:
         break;
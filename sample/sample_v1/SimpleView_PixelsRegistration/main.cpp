@@ -1,5 +1,6 @@
 #include "common.hpp"
 #include "TYImageProc.h"
+#include "Registration.hpp"
 
 // The distance(mm) range defined by the macro is related to the camera model
 #define MIN_DEPTH			(400)
@@ -20,9 +21,12 @@ struct CallbackData {
 
   TY_CAMERA_CALIB_INFO depth_calib;
   TY_CAMERA_CALIB_INFO color_calib;
+
+  ColorPixelsToDepthPlan pixels_plan;
 };
 
-static void doRectRegister(const TY_CAMERA_CALIB_INFO& depth_calib
+static void doRectRegister(ColorPixelsToDepthPlan& plan
+                      , const TY_CAMERA_CALIB_INFO& depth_calib
                       , const TY_CAMERA_CALIB_INFO& color_calib
                       , cv::Mat& depth
                       , float f_scale_unit
@@ -43,16 +47,16 @@ static void doRectRegister(const TY_CAMERA_CALIB_INFO& depth_calib
   cv::medianBlur(depth, temp, 5);
   depth = temp;
 
-  ASSERT_OK(
-    TYMapRGBPixelsToDepthCoordinate(
-      &depth_calib,
-      depth.cols, depth.rows, depth.ptr<uint16_t>(),
-      &color_calib,
-      undistort_color.cols, undistort_color.rows, &src_rgb_data[0], src_rgb_data.size(),
-      MIN_DEPTH, MAX_DEPTH,
-      &dst_rgb_data[0], f_scale_unit
-    )
-  );
+  if(!plan.isValid()) {
+    ASSERT_OK(
+      plan.init(
+        &depth_calib, depth.cols, depth.rows,
+        &color_calib, undistort_color.cols, undistort_color.rows,
+        MIN_DEPTH, MAX_DEPTH, f_scale_unit
+      )
+    );
+  }
+  ASSERT_OK(plan.execute(depth.ptr<uint16_t>(), &src_rgb_data[0], src_rgb_data.size(), &dst_rgb_data[0]));
   
   int size = dst_rgb_data.size();
   for (int i = 0; i < dst_rgb_data.size(); i++) {
@@ -116,7 +120,7 @@ void handleFrame(TY_FRAME_DATA* frame, void* userdata)
       DEFAULT_RECT_WIDTH, DEFAULT_RECT_HEIGHT);
 
     std::vector<cv::Point> dst_pos(4);
-    doRectRegister(pData->depth_calib, pData->color_calib, depth, pData->scale_unit, undistort_color, roi_src, dst_pos);
+    doRectRegister(pData->pixels_plan, pData->depth_calib, pData->color_calib, depth, pData->scale_unit, undistort_color, roi_src, dst_pos);
 	
     cv::rectangle(undistort_color, roi_src, cv::Scalar(100, 100, 100), 2);
     cv::imshow("undistort color", undistort_color);
@@ -4,6 +4,8 @@
 #include "common.hpp"
 #include "../../cloud_viewer/cloud_viewer.hpp"
 #include "TYImageProc.h"
+#include "PointCloudGenerator.hpp"
+#include "Registration.hpp"
 
 struct CallbackData {
     int             index;
@@ -19,6 +21,9 @@ struct CallbackData {
     bool exit_main;
     int  fileIndex;
     bool map_depth_to_color;
+
+    PointCloudGenerator cloud;
+    DepthToColorPlan depth_to_color;
 };
 
 static CallbackData cb_data;
@@ -32,6 +37,7 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
     , cv::Mat& undistort_color
     , cv::Mat& out
     , bool map_depth_to_color
+    , DepthToColorPlan& depth_to_color
 )
 {
     // do undistortion
@@ -53,20 +59,13 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
 
     // do register
     if (map_depth_to_color) {
-        int outW = depth.cols;
-        int outH = depth.cols * undistort_color.rows / undistort_color.cols;
-        out = cv::Mat::zeros(cv::Size(outW, outH), CV_16U);
-        ASSERT_OK(
-            TYMapDepthImageToColorCoordinate(
-                &depth_calib,
-                depth.cols, depth.rows, depth.ptr<uint16_t>(),
-                &color_calib,
-                out.cols, out.rows, out.ptr<uint16_t>(), f_scale_unit
-            )
-        );
-        cv::Mat temp;
-        cv::resize(out, temp, undistort_color.size(), 0, 0, cv::INTER_NEAREST);
-        out = temp;
+        // straight to color resolution, the plan is built once for the run
+        if (!depth_to_color.isValid()) {
+            ASSERT_OK(depth_to_color.init(&depth_calib, depth.cols, depth.rows, &color_calib, undistort_color.cols, undistort_color.rows, f_scale_unit));
+            depth_to_color.setSplat(true);
+        }
+        out = cv::Mat(undistort_color.size(), CV_16U);
+        ASSERT_OK(depth_to_color.execute(depth.ptr<uint16_t>(), out.ptr<uint16_t>()));
     }
     else {
         out = cv::Mat::zeros(depth.size(), CV_8UC3);
@@ -84,6 +83,27 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
 }
 
 
+static void undistortDepth(const TY_CAMERA_CALIB_INFO& depth_calib, cv::Mat& depth)
+{
+    TY_IMAGE_DATA src;
+    src.width = depth.cols;
+    src.height = depth.rows;
+    src.size = depth.size().area() * 2;
+    src.pixelFormat = TY_PIXEL_FORMAT_DEPTH16;
+    src.buffer = depth.data;
+
+    cv::Mat undistort_depth = cv::Mat(depth.size(), CV_16U);
+    TY_IMAGE_DATA dst;
+    dst.width = depth.cols;
+    dst.height = depth.rows;
+    dst.size = undistort_depth.size().area() * 2;
+    dst.buffer = undistort_depth.data;
+    dst.pixelFormat = TY_PIXEL_FORMAT_DEPTH16;
+    ASSERT_OK(TYUndistortImage(&depth_calib, &src, NULL, &dst));
+
+    depth = undistort_depth;
+}
+
 static void handleFrame(TY_FRAME_DATA* frame, void* userdata) {
     //we only using Opencv Mat as data container.
     //you can allocate memory by yourself.
@@ -93,27 +113,9 @@ static void handleFrame(TY_FRAME_DATA* frame, void* userdata) {
     cv::Mat depth, color;
     parseFrame(*frame, &depth, NULL, NULL, &color, pData->isp_handle);
     if(!depth.empty()){
-        if (pData->isDepthDistortion)
-        {
-            TY_IMAGE_DATA src;
-            src.width = depth.cols;
-            src.height = depth.rows;
-            src.size = depth.size().area() * 2;
-            src.pixelFormat = TY_PIXEL_FORMAT_DEPTH16;
-            src.buffer = depth.data;
-
-            cv::Mat undistort_depth = cv::Mat(depth.size(), CV_16U);
-            TY_IMAGE_DATA dst;
-            dst.width = depth.cols;
-            dst.height = depth.rows;
-            dst.size = undistort_depth.size().area() * 2;
-            dst.buffer = undistort_depth.data;
-            dst.pixelFormat = TY_PIXEL_FORMAT_DEPTH16;
-            ASSERT_OK(TYUndistortImage(&cb_data.depth_calib, &src, NULL, &dst));
-
-            depth = undistort_depth.clone();
-        }
-
+        // depth stays distorted unless registration needs it undistorted,
+        // the ray table takes the lens distortion instead
+        bool rawDepth = pData->isDepthDistortion;
         std::vector<TY_VECT_3F> p3d;
         
         uint8_t *color_data = NULL;
@@ -139,7 +141,12 @@ static void handleFrame(TY_FRAME_DATA* frame, void* userdata) {
                     break;
                 }
 
-                doRegister(pData->depth_calib, pData->color_calib, depth, pData->f_depth_scale, color, color_data_mat, out, pData->map_depth_to_color);
+                if (rawDepth)
+                {
+                    undistortDepth(pData->depth_calib, depth);
+                    rawDepth = false;
+                }
+                doRegister(pData->depth_calib, pData->color_calib, depth, pData->f_depth_scale, color, color_data_mat, out, pData->map_depth_to_color, pData->depth_to_color);
                 cv::cvtColor(color_data_mat, color_data_mat, cv::COLOR_BGR2RGB);
                 color_data = color_data_mat.ptr<uint8_t>();
             }
@@ -148,26 +155,39 @@ static void handleFrame(TY_FRAME_DATA* frame, void* userdata) {
         if (pData->map_depth_to_color) {
             depth = out.clone();
             calib_data_ptr = &pData->color_calib;
+            rawDepth = false;
         }
         else
         {
             calib_data_ptr = &pData->depth_calib;
         }
+        // ray table is rebuilt only when calibration or size changes,
+        // zero depth pixels are dropped here once for all consumers
+        std::vector<uint32_t> index(depth.size().area());
+        uint32_t count = 0;
         p3d.resize(depth.size().area());
-        ASSERT_OK(TYMapDepthImageToPoint3d(calib_data_ptr, depth.cols, depth.rows
-                , (uint16_t*)depth.data, &p3d[0], pData->f_depth_scale));
+        ASSERT_OK(pData->cloud.init(calib_data_ptr, depth.cols, depth.rows, NULL, rawDepth));
+        ASSERT_OK(pData->cloud.computeDense((uint16_t*)depth.data, &p3d[0], &index[0], &count, pData->f_depth_scale));
+        p3d.resize(count);
+
+        std::vector<uint8_t> point_color;
+        if (color_data && count){
+            point_color.resize(count * 3);
+            PointCloudGenerator::gather(color_data, 3, &index[0], count, &point_color[0]);
+        }
+        color_data = point_color.empty() ? NULL : &point_color[0];
 
         if (pData->saveOneFramePoint3d){
             char file[32];
             sprintf(file, "points-%d.xyz", pData->fileIndex++);
-            writePointCloud((cv::Point3f*)&p3d[0], (const cv::Vec3b*)color_data_mat.data, p3d.size(), file, PC_FILE_FORMAT_XYZ);
+            writePointCloud((cv::Point3f*)p3d.data(), (const cv::Vec3b*)color_data, p3d.size(), file, PC_FILE_FORMAT_XYZ, true);
             pData->saveOneFramePoint3d = false;
         }
         for (int idx = 0; idx < p3d.size(); idx++){//we adjust coordinate for display
             p3d[idx].y = -p3d[idx].y;
             p3d[idx].z = -p3d[idx].z;
         }
-        GLPointCloudViewer::Update(p3d.size(), &p3d[0], color_data);
+        GLPointCloudViewer::Update(p3d.size(), p3d.data(), color_data, true);
     }
 }
 
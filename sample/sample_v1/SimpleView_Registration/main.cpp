@@ -1,5 +1,6 @@
 #include "common.hpp"
 #include "TYImageProc.h"
+#include "Registration.hpp"
 
 #define MAP_DEPTH_TO_COLOR  0
 
@@ -16,6 +17,8 @@ struct CallbackData {
   bool            isTof;
   TY_CAMERA_CALIB_INFO depth_calib;
   TY_CAMERA_CALIB_INFO color_calib;
+  ImageToDepthRegistration registration;
+  DepthToColorPlan depth_to_color;
 };
 
 cv::Mat tofundis_mapx, tofundis_mapy;
@@ -28,6 +31,8 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
                       , cv::Mat& undistort_color
                       , cv::Mat& out
                       , bool map_depth_to_color
+                      , ImageToDepthRegistration& registration
+                      , DepthToColorPlan& depth_to_color
                       )
 {
   int32_t         image_size;   
@@ -45,8 +50,8 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
     image_size = color.size().area() * 3;
     color_fmt = TY_PIXEL_FORMAT_RGB;
   }
-  // do undistortion
-  if (needUndistort) {
+  // do undistortion, color to depth reads the raw color through the registration instead
+  if (needUndistort && map_depth_to_color) {
     if(color_fmt == TY_PIXEL_FORMAT_MONO16)
       undistort_color = cv::Mat(color.size(), CV_16U);
     else if(color_fmt == TY_PIXEL_FORMAT_RGB48)
@@ -75,59 +80,35 @@ static void doRegister(const TY_CAMERA_CALIB_INFO& depth_calib
 
   // do register
   if (map_depth_to_color) {
-    int outW = depth.cols;
-    int outH = depth.cols * undistort_color.rows / undistort_color.cols;
-    out = cv::Mat::zeros(cv::Size(outW, outH), CV_16U);
-    ASSERT_OK(
-      TYMapDepthImageToColorCoordinate(
-        &depth_calib,
-        depth.cols, depth.rows, depth.ptr<uint16_t>(),
-        &color_calib,
-        out.cols, out.rows, out.ptr<uint16_t>(), f_scale_unit
-      )
-    );
-    cv::Mat temp;
-    cv::resize(out, temp, undistort_color.size(), 0, 0, cv::INTER_NEAREST);
-    out = temp;
+    // straight to color resolution, the plan is built once for the run
+    if (!depth_to_color.isValid()) {
+      ASSERT_OK(depth_to_color.init(&depth_calib, depth.cols, depth.rows, &color_calib, undistort_color.cols, undistort_color.rows, f_scale_unit));
+      depth_to_color.setSplat(true);
+    }
+    out = cv::Mat(undistort_color.size(), CV_16U);
+    ASSERT_OK(depth_to_color.execute(depth.ptr<uint16_t>(), out.ptr<uint16_t>()));
   }
   else {
+    // undistortion and registration are one lookup, built once as
+    // calibration and sizes stay the same for the whole run
+    if (!registration.isValid()) {
+      ASSERT_OK(registration.init(&depth_calib, depth.cols, depth.rows, &color_calib, color.cols, color.rows, f_scale_unit));
+      ASSERT_OK(registration.setDistortedSource(needUndistort));
+    }
+    ASSERT_OK(registration.update(depth.ptr<uint16_t>()));
     if(color_fmt == TY_PIXEL_FORMAT_MONO16)
     {
       out = cv::Mat::zeros(depth.size(), CV_16U);
-      ASSERT_OK(
-        TYMapMono16ImageToDepthCoordinate(
-          &depth_calib,
-          depth.cols, depth.rows, depth.ptr<uint16_t>(),
-          &color_calib,
-          undistort_color.cols, undistort_color.rows, undistort_color.ptr<uint16_t>(),
-          out.ptr<uint16_t>(), f_scale_unit
-        )
-      );
+      ASSERT_OK(registration.mapMono16(color.ptr<uint16_t>(), out.ptr<uint16_t>()));
     }
     else if(color_fmt == TY_PIXEL_FORMAT_RGB48)
     {
       out = cv::Mat::zeros(depth.size(), CV_16UC3);
-      ASSERT_OK(
-        TYMapRGB48ImageToDepthCoordinate(
-          &depth_calib,
-          depth.cols, depth.rows, depth.ptr<uint16_t>(),
-          &color_calib,
-          undistort_color.cols, undistort_color.rows, undistort_color.ptr<uint16_t>(),
-          out.ptr<uint16_t>(), f_scale_unit
-        )
-      );
+      ASSERT_OK(registration.mapRGB48(color.ptr<uint16_t>(), out.ptr<uint16_t>()));
     }
     else{
       out = cv::Mat::zeros(depth.size(), CV_8UC3);
-      ASSERT_OK(
-        TYMapRGBImageToDepthCoordinate(
-          &depth_calib,
-          depth.cols, depth.rows, depth.ptr<uint16_t>(),
-          &color_calib,
-          undistort_color.cols, undistort_color.rows, undistort_color.ptr<uint8_t>(),
-          out.ptr<uint8_t>(), f_scale_unit
-        )
-      );
+      ASSERT_OK(registration.mapRGB(color.ptr<uint8_t>(), out.ptr<uint8_t>()));
     }
   }
 }
@@ -170,13 +151,15 @@ void handleFrame(TY_FRAME_DATA* frame, void* userdata)
   if (!depth.empty() && !color.empty()) {
     cv::Mat undistort_color, out;
     if (pData->needUndistort || MAP_DEPTH_TO_COLOR) {
-      doRegister(pData->depth_calib, pData->color_calib, depth, pData->scale_unit, color, pData->needUndistort, undistort_color, out, MAP_DEPTH_TO_COLOR);
+      doRegister(pData->depth_calib, pData->color_calib, depth, pData->scale_unit, color, pData->needUndistort, undistort_color, out, MAP_DEPTH_TO_COLOR, pData->registration, pData->depth_to_color);
     }
     else {
       undistort_color = color;
       out = color;
     }
-    cv::imshow("undistort color", undistort_color);
+    if (MAP_DEPTH_TO_COLOR) {
+      cv::imshow("undistort color", undistort_color);
+    }
 
     cv::Mat tmp, gray8, bgr;
     if (MAP_DEPTH_TO_COLOR) {
@@ -1,5 +1,6 @@
 #include "common.hpp"
 #include "TYImageProc.h"
+#include "PointCloudFormat.hpp"
 
 
 void eventCallback(TY_EVENT_INFO *event_info, void *userdata)
@@ -17,8 +18,7 @@ void eventCallback(TY_EVENT_INFO *event_info, void *userdata)
 //Get depth data from XYZ48 frames
 static  void parseXYZ48(int16_t* xyz48, int16_t* depth, int width, int height)
 {
-    for (int pix = 0; pix < width*height; pix++)
-        depth[pix] =*(xyz48 + 3*pix + 2);
+    TYXYZ48ToDepth16(xyz48, width*height, (uint16_t*)depth);
 }
 
 //Estimate new calibration data
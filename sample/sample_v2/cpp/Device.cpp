@@ -1,3 +1,10 @@
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "Device.hpp"
 
 struct to_string
@@ -249,20 +256,281 @@ void FastCamera::close()
     if(device) device.reset();
 }
 
+static size_t pageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static uint8_t* pageAlloc(size_t size)
+{
+    const size_t page = pageSize();
+    size = (size + page - 1) / page * page;
+#ifdef _WIN32
+    return (uint8_t*)_aligned_malloc(size, page);
+#else
+    void* buffer = nullptr;
+    return posix_memalign(&buffer, page, size) == 0 ? (uint8_t*)buffer : nullptr;
+#endif
+}
+
+void FrameBufferPool::PageFree::operator()(uint8_t* buffer) const
+{
+#ifdef _WIN32
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+FrameBufferPool::FrameBufferPool(TY_DEV_HANDLE handle, uint32_t bufferSize, int queued, int maxCount)
+    : _handle(handle)
+    , _bufferSize(bufferSize)
+    , _active(true)
+    , _leased(0)
+    , _queued(0)
+    , _target(queued)
+    , _excess(0)
+    , _maxCount(maxCount)
+    , _periodMs(0.)
+    , _heldMs(0.)
+    , _quietWindows(0)
+{
+}
+
+TY_STATUS FrameBufferPool::doEnqueue(void* buffer)
+{
+    TY_STATUS status = TYEnqueueBuffer(_handle, buffer, _bufferSize);
+    if(status == TY_STATUS_OK) {
+        _queued++;
+    }
+    return status;
+}
+
+TY_STATUS FrameBufferPool::doKeepQueued()
+{
+    while(_queued < _target && (int)_buffers.size() < _maxCount) {
+        page_buffer buffer(pageAlloc(_bufferSize));
+        if(!buffer) {
+            return TY_STATUS_NO_BUFFER;
+        }
+        TY_STATUS status = doEnqueue(buffer.get());
+        if(status != TY_STATUS_OK) {
+            std::cout << "Enqueue buffer failed with error code: " << TY_ERROR(status) << std::endl;
+            return status;
+        }
+        _buffers.push_back(std::move(buffer));
+    }
+    return TY_STATUS_OK;
+}
+
+void FrameBufferPool::setTarget(int target)
+{
+    //a lower target frees as many buffers as they come back, a higher one
+    //first keeps those still to be freed
+    _excess += _target - target;
+    _excess = _excess < 0 ? 0 : _excess;
+    _target = target;
+    const int over = (int)_buffers.size() - _maxCount;
+    _excess = over > _excess ? over : _excess;
+}
+
+TY_STATUS FrameBufferPool::setLimits(int queued, int maxCount)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _maxCount = maxCount;
+    setTarget(queued);
+    return _active ? doKeepQueued() : TY_STATUS_IDLE;
+}
+
+TY_STATUS FrameBufferPool::keepQueued()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _active ? doKeepQueued() : TY_STATUS_IDLE;
+}
+
+void FrameBufferPool::fetched()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _queued--;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if(_lastFetch.time_since_epoch().count()) {
+        const double ms = std::chrono::duration<double, std::milli>(now - _lastFetch).count();
+        _periodMs = _periodMs > 0. ? 0.9 * _periodMs + 0.1 * ms : ms;
+    }
+    _lastFetch = now;
+}
+
+TY_STATUS FrameBufferPool::enqueue(void* buffer)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    if(!_active) {
+        return TY_STATUS_IDLE;
+    }
+    //one spare over the target and the leases, so a lease fetched and
+    //released each frame does not allocate and free a buffer each time
+    const bool spare = (int)_buffers.size() > _target + _leased + 1;
+    if((_excess == 0 && !spare) || (int)_buffers.size() <= 1) {
+        return doEnqueue(buffer);
+    }
+    //the target went down or the leases are back, give the memory back instead
+    _excess = _excess > 0 ? _excess - 1 : 0;
+    for(size_t i = 0; i < _buffers.size(); i++) {
+        if(_buffers[i].get() == buffer) {
+            _buffers.erase(_buffers.begin() + i);
+            break;
+        }
+    }
+    return TY_STATUS_OK;
+}
+
+void FrameBufferPool::release(void* buffer, double heldMs)
+{
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        _leased--;
+        _heldMs = heldMs > _heldMs ? heldMs : _heldMs;
+    }
+    //stopped meanwhile, the buffer is freed with the pool
+    TY_STATUS status = enqueue(buffer);
+    if(status != TY_STATUS_IDLE) {
+        CHECK_RET(status);
+    }
+}
+
+void FrameBufferPool::shutdown()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _active = false;
+}
+
+void FrameBufferPool::held(double ms)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    _heldMs = ms > _heldMs ? ms : _heldMs;
+}
+
+TY_STATUS FrameBufferPool::adapt(uint64_t dropped)
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    if(!_active) {
+        return TY_STATUS_IDLE;
+    }
+    //frames arriving while the consumer holds one, plus the one it waits for
+    int need = _target;
+    if(_periodMs > 0.) {
+        need = (int)ceil(_heldMs / _periodMs) + 1;
+    }
+    int target = _target;
+    if(dropped) {
+        target = _target + 1 > need ? _target + 1 : need;
+        _quietWindows = 0;
+    } else if(need > _target) {
+        target = need;
+        _quietWindows = 0;
+    } else if(need < _target && ++_quietWindows >= 3) {
+        //shrink slowly, one buffer per three quiet windows
+        target = _target - 1;
+        _quietWindows = 0;
+    }
+    setTarget(target < 1 ? 1 : (target > _maxCount ? _maxCount : target));
+    _heldMs = 0.;
+    return doKeepQueued();
+}
+
+int FrameBufferPool::bufferCount()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return (int)_buffers.size();
+}
+
+int FrameBufferPool::leasedCount()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _leased;
+}
+
+int FrameBufferPool::queuedCount()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _queued;
+}
+
+int FrameBufferPool::target()
+{
+    std::unique_lock<std::mutex> lock(_lock);
+    return _target;
+}
+
 std::shared_ptr<TYFrame> FastCamera::fetchFrames(uint32_t timeout_ms)
 {
+    if(!_pool) {
+        std::cout << "Device is not started!" << std::endl;
+        return std::shared_ptr<TYFrame>();
+    }
+
+    //in copy mode the consumer held the last frame until now
+    const std::chrono::steady_clock::time_point enter = std::chrono::steady_clock::now();
+    if(_active_mode == frame_copy && _last_fetch.time_since_epoch().count()) {
+        _pool->held(std::chrono::duration<double, std::milli>(enter - _last_fetch).count());
+    }
+
     TY_FRAME_DATA tyframe;
     TY_STATUS status = TYFetchFrame(handle(), &tyframe, timeout_ms);
     if(status != TY_STATUS_OK) {
         std::cout << "Frame fetch failed with err code: " << status << "(" << TYErrorString(status) << ")."<< std::endl;
         return std::shared_ptr<TYFrame>();
     }
-    
-    std::shared_ptr<TYFrame> frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe));
-    CHECK_RET(TYEnqueueBuffer(handle(), tyframe.userBuffer, tyframe.bufferSize));
+    _last_fetch = std::chrono::steady_clock::now();
+    _pool->fetched();
+
+    std::shared_ptr<TYFrame> frame;
+    if(_active_mode == frame_lease) {
+        //the frame keeps the pool alive, its buffer goes back when it is gone
+        std::shared_ptr<FrameBufferPool> pool = _pool;
+        void* buffer = tyframe.userBuffer;
+        std::chrono::steady_clock::time_point leased = _last_fetch;
+        pool->lease();
+        frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe, [pool, buffer, leased]() {
+            pool->release(buffer, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - leased).count());
+        }));
+    } else {
+        frame = std::shared_ptr<TYFrame>(new TYFrame(tyframe));
+        CHECK_RET(_pool->enqueue(tyframe.userBuffer));
+    }
+
+    if(_adaptive && ++_fetched >= BUF_ADAPT_FRAMES) {
+        uint64_t dropped = 0;
+        TY_CAMERA_STATISTICS st;
+        if(_has_statistics && TY_STATUS_OK == TYGetStruct(handle(), TY_COMPONENT_DEVICE, TY_STRUCT_CAM_STATISTICS, &st, sizeof(st))) {
+            dropped = st.imageDropped - _dropped;
+            _dropped = st.imageDropped;
+        }
+        _fetched = 0;
+        CHECK_RET(_pool->adapt(dropped));
+    } else {
+        //leased buffers are out, keep the driver fed
+        CHECK_RET(_pool->keepQueued());
+    }
     return frame;
 }
 
+TY_STATUS FastCamera::setBufferCount(int count, int maxCount)
+{
+    if(count < 1 || maxCount < count) {
+        return TY_STATUS_INVALID_PARAMETER;
+    }
+    std::unique_lock<std::mutex> lock(_dev_lock);
+    _buffer_count = count;
+    _buffer_max = maxCount;
+    return _pool ? _pool->setLimits(count, maxCount) : TY_STATUS_OK;
+}
+
 static TY_COMPONENT_ID StreamIdx2CompID(FastCamera::stream_idx idx)
 {
     TY_COMPONENT_ID comp = 0;
@@ -322,14 +590,33 @@ TY_STATUS FastCamera::start()
         return TY_STATUS_DEVICE_ERROR;
     }
 
-    for(int i = 0; i < BUF_CNT; i++) {
-        stream_buffer[i].resize(stream_buffer_size);
-        TYEnqueueBuffer(handle(), &stream_buffer[i][0], stream_buffer_size);
+    _pool = std::shared_ptr<FrameBufferPool>(new FrameBufferPool(handle(), stream_buffer_size, _buffer_count, _buffer_max));
+    status = _pool->keepQueued();
+    if(TY_STATUS_OK != status) {
+        _pool.reset();
+        TYClearBufferQueue(handle());
+        return status;
+    }
+
+    _active_mode = _frame_mode;
+
+    //drops are counted from here, not all devices report them
+    _fetched = 0;
+    _dropped = 0;
+    _last_fetch = std::chrono::steady_clock::time_point();
+    TY_CAMERA_STATISTICS st;
+    _has_statistics = false;
+    TYHasFeature(handle(), TY_COMPONENT_DEVICE, TY_STRUCT_CAM_STATISTICS, &_has_statistics);
+    if(_has_statistics && TY_STATUS_OK == TYGetStruct(handle(), TY_COMPONENT_DEVICE, TY_STRUCT_CAM_STATISTICS, &st, sizeof(st))) {
+        _dropped = st.imageDropped;
     }
 
     status = TYStartCapture(handle());
     if(TY_STATUS_OK != status) {
         std::cout << "Start capture failed with error code: " << TY_ERROR(status) << std::endl;
+        _pool->shutdown();
+        TYClearBufferQueue(handle());
+        _pool.reset();
         return status;
     }
 
@@ -356,10 +643,10 @@ TY_STATUS FastCamera::doStop()
     }
     //Stop will stop receive, need TYClearBufferQueue any way
     //Ignore TYClearBufferQueue ret val
+    //leased frames still out free their buffers with the pool
+    _pool->shutdown();
     TYClearBufferQueue(handle());
-    for(int i = 0; i < BUF_CNT; i++) {
-        stream_buffer[i].clear();
-    }
+    _pool.reset();
 
     return status;
 }
@@ -2,6 +2,7 @@
 
 #include "Frame.hpp"
 #include "TYImageProc.h"
+#include "PointCloudFormat.hpp"
 
 namespace percipio_layer {
 
@@ -133,14 +134,10 @@ int ImageProcesser::parse(const std::shared_ptr<TYImage>& image)
         }
         case TY_PIXEL_FORMAT_XYZ48:
         {
-            std::vector<int16_t> depth_data(image->width() * image->height());
-            int16_t* src = static_cast<int16_t*>(image->buffer());
-            for (int pix = 0; pix < image->width()*image->height(); pix++) {
-                depth_data[pix] = *(src + 3*pix + 2);
-            }
-
-            _image = std::shared_ptr<TYImage>(new TYImage(image->width(), image->height(), image->componentID(), TY_PIXEL_FORMAT_DEPTH16, depth_data.size() * sizeof(int16_t)));
-            memcpy(_image->buffer(), depth_data.data(), image->size());
+            //z plane straight into the depth image
+            const int32_t pixels = image->width() * image->height();
+            _image = std::shared_ptr<TYImage>(new TYImage(image->width(), image->height(), image->componentID(), TY_PIXEL_FORMAT_DEPTH16, pixels * sizeof(uint16_t)));
+            TYXYZ48ToDepth16(static_cast<const int16_t*>(image->buffer()), pixels, static_cast<uint16_t*>(_image->buffer()));
             return 0;
         }
         default:
@@ -209,46 +206,59 @@ int ImageProcesser::DepthImageRender()
 
 TY_STATUS ImageProcesser::doUndistortion()
 {
-    int ret = 0;
-    if(ret == 0) {
-        if(!_calib_data) {
-            std::cout << "Calib data is empty!" << std::endl;
-            return TY_STATUS_ERROR;
-        }
+    if(!_calib_data) {
+        std::cout << "Calib data is empty!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    if(!_image) {
+        return TY_STATUS_ERROR;
+    }
 
-        int32_t         image_size = _image->size();
-        TY_PIXEL_FORMAT image_fmt = _image->pixelFormat();
-        TY_COMPONENT_ID comp_id = _image->componentID();
-
-        std::vector<uint8_t> undistort_image(image_size);
-
-        TY_IMAGE_DATA src;
-        src.width = _image->width();
-        src.height = _image->height();
-        src.size = image_size;
-        src.pixelFormat = image_fmt;
-        src.buffer = _image->buffer();
-
-        TY_IMAGE_DATA dst;
-        dst.width = _image->width();
-        dst.height = _image->height();
-        dst.size = image_size;
-        dst.pixelFormat = image_fmt;
-        dst.buffer = undistort_image.data();
-
-        TY_STATUS status = TYUndistortImage(&*_calib_data, &src, NULL, &dst);
-        if(status != TY_STATUS_OK) {
-            std::cout << "Do image undistortion failed!" << std::endl;
-            return status;
-        }
+    int32_t         image_size = _image->size();
+    TY_PIXEL_FORMAT image_fmt = _image->pixelFormat();
+    TY_COMPONENT_ID comp_id = _image->componentID();
+
+    //the remap table is only rebuilt when calibration, size or format change
+    TY_STATUS status = undistortion.init(&*_calib_data, _image->width(), _image->height(), image_fmt);
+    if(status != TY_STATUS_OK) {
+        std::cout << "Do image undistortion failed!" << std::endl;
+        return status;
+    }
+
+    //the output of the frame before is reused unless somebody still holds it
+    if(!undistorted || undistorted.use_count() > 1 || undistorted->size() != image_size ||
+            undistorted->width() != _image->width() || undistorted->pixelFormat() != image_fmt ||
+            undistorted->componentID() != comp_id) {
+        undistorted = std::shared_ptr<TYImage>(new TYImage(_image->width(), _image->height(), comp_id, image_fmt, image_size));
+    }
+    status = undistortion.execute(_image->buffer(), undistorted->buffer());
+    if(status != TY_STATUS_OK) {
+        std::cout << "Do image undistortion failed!" << std::endl;
+        return status;
+    }
+
+    _image.swap(undistorted);
+    return TY_STATUS_OK;
+}
 
-        _image = std::shared_ptr<TYImage>(new TYImage(_image->width(), _image->height(), comp_id, image_fmt, image_size));
-        memcpy(_image->buffer(), undistort_image.data(), image_size);
-        return TY_STATUS_OK;
-    } else {
-        std::cout << "Image decoding failed." << std::endl;
+TY_STATUS ImageProcesser::undistortPixels(const uint32_t* pixels, uint32_t count, std::shared_ptr<TYImage>& out)
+{
+    if(!_calib_data) {
+        std::cout << "Calib data is empty!" << std::endl;
+        return TY_STATUS_ERROR;
+    }
+    if(!_image) {
         return TY_STATUS_ERROR;
     }
+
+    TY_PIXEL_FORMAT image_fmt = _image->pixelFormat();
+    TY_STATUS status = undistortion.init(&*_calib_data, _image->width(), _image->height(), image_fmt);
+    if(status != TY_STATUS_OK) {
+        return status;
+    }
+
+    out = std::shared_ptr<TYImage>(new TYImage(count, 1, _image->componentID(), image_fmt, count * TYBitsPerPixel(image_fmt) / 8));
+    return undistortion.remap(image_fmt, _image->buffer(), reinterpret_cast<const int32_t*>(pixels), count, out->buffer());
 }
 
 int ImageProcesser::show()
@@ -316,7 +326,18 @@ TYFrame::TYFrame(const TY_FRAME_DATA& frame)
     bufferSize = frame.bufferSize;
     userBuffer.resize(bufferSize);
     memcpy(userBuffer.data(), frame.userBuffer, bufferSize);
+    setImages(frame, userBuffer.data());
+}
 
+TYFrame::TYFrame(const TY_FRAME_DATA& frame, std::function<void()> release) :
+    _release(release)
+{
+    bufferSize = frame.bufferSize;
+    setImages(frame, frame.userBuffer);
+}
+
+void TYFrame::setImages(const TY_FRAME_DATA& frame, void* buffer)
+{
 #define TY_IMAGE_MOVE(src, dst, from, to) do { \
     (to) = (from); \
     (to.buffer) = reinterpret_cast<void*>((std::intptr_t(dst)) + (std::intptr_t(from.buffer) - std::intptr_t(src)));\
@@ -328,22 +349,22 @@ TYFrame::TYFrame(const TY_FRAME_DATA& frame)
     
         // get depth image
         if (frame.image[i].componentID == TY_COMPONENT_DEPTH_CAM) {  
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
             _images[TY_COMPONENT_DEPTH_CAM] = std::shared_ptr<TYImage>(new TYImage(img));
         }
         // get left ir image
         if (frame.image[i].componentID == TY_COMPONENT_IR_CAM_LEFT) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
             _images[TY_COMPONENT_IR_CAM_LEFT] = std::shared_ptr<TYImage>(new TYImage(img));
         }
         // get right ir image
         if (frame.image[i].componentID == TY_COMPONENT_IR_CAM_RIGHT) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
             _images[TY_COMPONENT_IR_CAM_RIGHT] = std::shared_ptr<TYImage>(new TYImage(img));
         }
         // get color image
         if (frame.image[i].componentID == TY_COMPONENT_RGB_CAM) {
-            TY_IMAGE_MOVE(frame.userBuffer, userBuffer.data(), frame.image[i], img);
+            TY_IMAGE_MOVE(frame.userBuffer, buffer, frame.image[i], img);
             _images[TY_COMPONENT_RGB_CAM] = std::shared_ptr<TYImage>(new TYImage(img));
         }
     }
@@ -351,7 +372,9 @@ TYFrame::TYFrame(const TY_FRAME_DATA& frame)
 
 TYFrame::~TYFrame()
 {
-
+    if(_release) {
+        _release();
+    }
 }
 
 
@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "Fusion.hpp"
+#include "TYThread.hpp"
+
+namespace percipio_layer {
+
+PointCloudFusion::PointCloudFusion()
+    : _leafSize(0.f)
+    , _shared(std::make_shared<Clouds>())
+    , _sequence(0)
+{
+}
+
+int PointCloudFusion::addCamera(const TY_CAMERA_CALIB_INFO& calib, const TY_CAMERA_EXTRINSIC& pose, float scaleUnit)
+{
+    Camera camera;
+    camera.calib = calib;
+    camera.scaleUnit = scaleUnit;
+    camera.generator.reset(new PointCloudGenerator());
+    camera.generator->setPose(&pose, 1);
+    camera.depth = nullptr;
+    camera.width = camera.height = 0;
+    camera.offset = camera.count = 0;
+    camera.status = TY_STATUS_OK;
+    _cameras.push_back(std::move(camera));
+    return (int)_cameras.size() - 1;
+}
+
+struct PointCloudFusion::Job
+{
+    Camera*     cameras;
+    TY_VECT_3F* points;
+};
+
+void PointCloudFusion::cameraTasks(int begin, int end, void* arg)
+{
+    const Job& job = *(const Job*)arg;
+    for(int i = begin; i < end; i++) {
+        Camera& camera = job.cameras[i];
+        camera.count = 0;
+        if(!camera.depth) {
+            camera.status = TY_STATUS_OK;
+            continue;
+        }
+        //the table is kept as long as calibration and size do not change,
+        //frames come as captured so the rays take the lens distortion
+        camera.status = camera.generator->init(&camera.calib, camera.width, camera.height, nullptr, true);
+        if(camera.status == TY_STATUS_OK) {
+            camera.status = camera.generator->computeDense(camera.depth, job.points + camera.offset, nullptr,
+                                                           &camera.count, camera.scaleUnit);
+        }
+    }
+}
+
+TY_STATUS PointCloudFusion::fuse(const std::vector<std::shared_ptr<TYImage>>& depths)
+{
+    const int n = (int)_cameras.size();
+    if(!n || depths.size() != _cameras.size()) {
+        return TY_STATUS_INVALID_PARAMETER;
+    }
+
+    uint32_t total = 0;
+    for(int i = 0; i < n; i++) {
+        Camera& camera = _cameras[i];
+        const std::shared_ptr<TYImage>& depth = depths[i];
+        camera.offset = total;
+        camera.depth = nullptr;
+        if(!depth) {
+            continue;
+        }
+        if(depth->pixelFormat() != TY_PIXEL_FORMAT_DEPTH16) {
+            return TY_STATUS_INVALID_PARAMETER;
+        }
+        camera.depth = static_cast<const uint16_t*>(depth->buffer());
+        camera.width = depth->width();
+        camera.height = depth->height();
+        total += camera.width * camera.height;
+    }
+
+    //the cloud not handed out, once its last reader is gone
+    Clouds& shared = *_shared;
+    int back;
+    {
+        std::unique_lock<std::mutex> lock(shared.lock);
+        back = shared.front < 0 ? 0 : 1 - shared.front;
+        shared.released.wait(lock, [&shared, back] { return shared.readers[back] == 0; });
+    }
+    FusedCloud& cloud = shared.clouds[back];
+
+    const bool dedup = _leafSize > 0.f;
+    std::vector<TY_VECT_3F>& merged = dedup ? _merged : cloud.buffer;
+    if(merged.size() < total) {
+        merged.resize(total);
+    }
+
+    //one worker per camera, the cpus left are shared by their generators
+    const int threads = TYThreadHardwareConcurrency() / n;
+    for(int i = 0; i < n; i++) {
+        _cameras[i].generator->setThreadCount(threads > 1 ? threads : 1);
+    }
+    Job job = {_cameras.data(), merged.data()};
+    TYParallelFor(n, n, cameraTasks, &job);
+
+    //pack the per camera outputs, in camera order
+    uint32_t count = 0;
+    cloud.cameraCount.resize(n);
+    for(int i = 0; i < n; i++) {
+        const Camera& camera = _cameras[i];
+        if(camera.status != TY_STATUS_OK) {
+            return camera.status;
+        }
+        if(camera.count && camera.offset != count) {
+            memmove(merged.data() + count, merged.data() + camera.offset, sizeof(TY_VECT_3F) * camera.count);
+        }
+        cloud.cameraCount[i] = camera.count;
+        count += camera.count;
+    }
+
+    if(dedup) {
+        if(cloud.buffer.size() < count) {
+            cloud.buffer.resize(count);
+        }
+        _voxelGrid.setLeafSize(_leafSize);
+        TY_STATUS status = _voxelGrid.filter(merged.data(), count, nullptr, cloud.buffer.data(), nullptr, &count);
+        if(status != TY_STATUS_OK) {
+            return status;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(shared.lock);
+    cloud.count = count;
+    cloud.sequence = ++_sequence;
+    shared.front = back;
+    return TY_STATUS_OK;
+}
+
+std::shared_ptr<const FusedCloud> PointCloudFusion::acquire()
+{
+    std::shared_ptr<Clouds> shared = _shared;
+    std::unique_lock<std::mutex> lock(shared->lock);
+    if(shared->front < 0) {
+        return std::shared_ptr<const FusedCloud>();
+    }
+    const int index = shared->front;
+    shared->readers[index]++;
+    //the deleter gives the buffer back and keeps the clouds alive until then
+    return std::shared_ptr<const FusedCloud>(&shared->clouds[index], [shared, index](const FusedCloud*) {
+        std::unique_lock<std::mutex> lock(shared->lock);
+        shared->readers[index]--;
+        shared->released.notify_all();
+    });
+}
+
+}
@@ -8,6 +8,7 @@
 #include <queue>
 #include <thread>
 #include <condition_variable>
+#include <chrono>
 #include <stdint.h>
 
 #include "Frame.hpp"
@@ -182,6 +183,74 @@ class TYCamInterface
         std::vector<TY_INTERFACE_INFO> ifaces;
 };
 
+/// Driver frame buffers of a started FastCamera.
+///
+/// Shared by the camera and the frames leasing a buffer, so a leased frame
+/// may outlive stop() or the camera itself: its buffer is then freed with
+/// the pool instead of going back to the driver. Buffers are page aligned.
+///
+/// The pool keeps a target count of buffers enqueued with the driver,
+/// growing up to a max count. Lowering the target, or leases coming back
+/// after the pool grew for them, frees buffers as they are handed back,
+/// which is how the pool shrinks; the driver queue itself can only be
+/// cleared as a whole.
+class FrameBufferPool
+{
+    public:
+        FrameBufferPool(TY_DEV_HANDLE handle, uint32_t bufferSize, int queued, int maxCount);
+        FrameBufferPool(FrameBufferPool const&) = delete;
+        void operator=(FrameBufferPool const&) = delete;
+
+        TY_STATUS setLimits(int queued, int maxCount);  //new target and max, grows now if needed
+        TY_STATUS keepQueued();                 //grow until the target is with the driver
+        void      fetched();                    //a buffer came out of the driver
+        TY_STATUS enqueue(void* buffer);        //back to the driver, unless shut down or in excess
+        void      lease()                       { std::unique_lock<std::mutex> lock(_lock); _leased++; }
+        void      release(void* buffer, double heldMs);   //end of a lease
+        void      shutdown();                   //capture stopped, nothing is enqueued any more
+
+        //adaptive sizing: hold times of the consumer and drops of the device,
+        //adapt() moves the target once per window of fetched frames
+        void      held(double ms);
+        TY_STATUS adapt(uint64_t dropped);
+
+        int       bufferCount();
+        int       leasedCount();
+        int       queuedCount();
+        int       target();
+
+    private:
+        struct PageFree
+        {
+            void operator()(uint8_t* buffer) const;
+        };
+        typedef std::unique_ptr<uint8_t, PageFree> page_buffer;
+
+        void      setTarget(int target);
+        TY_STATUS doKeepQueued();
+        TY_STATUS doEnqueue(void* buffer);
+
+        std::mutex      _lock;
+        TY_DEV_HANDLE   _handle;
+        uint32_t        _bufferSize;
+        bool            _active;
+        int             _leased;
+        int             _queued;            //with the driver
+        int             _target;
+        int             _excess;            //buffers to free when handed back
+        int             _maxCount;
+        std::vector<page_buffer> _buffers;
+
+        std::chrono::steady_clock::time_point _lastFetch;
+        double          _periodMs;          //between frames, moving average
+        double          _heldMs;            //longest hold of the window
+        int             _quietWindows;      //windows in a row that could do with less
+};
+
+#define BUF_CNT         (3)
+#define BUF_CNT_MAX     (16)
+#define BUF_ADAPT_FRAMES (30)   //frames per adaptation window
+
 class FastCamera
 {
     public:
@@ -192,6 +261,11 @@ class FastCamera
         stream_ir_left = 0x4,
         stream_ir_right = 0x8,
         stream_ir = stream_ir_left
+    };
+    enum frame_mode
+    {
+        frame_copy = 0,     //frames own a copy, the driver buffer is enqueued at once
+        frame_lease = 1,    //frames hold the driver buffer until they are gone
     };
         friend class TYFrame;
         FastCamera();
@@ -211,6 +285,24 @@ class FastCamera
 
         std::shared_ptr<TYFrame> tryGetFrames(uint32_t timeout_ms);
 
+        //takes effect at the next start(), copy is the default. Leased frames
+        //save the copy of every frame, the pool then grows with the frames
+        //held so the buffer count stays with the driver, up to the max count.
+        //Consumers that keep frames for long should stay on copy.
+        void setFrameMode(frame_mode mode) { _frame_mode = mode; }
+        frame_mode frameMode() const { return _frame_mode; }
+
+        //driver buffers enqueued, BUF_CNT by default, and the most the pool
+        //may allocate, BUF_CNT_MAX by default. Applied at once if started.
+        TY_STATUS setBufferCount(int count, int maxCount = BUF_CNT_MAX);
+        int bufferCount() const { return _buffer_count; }
+
+        //let the enqueued count follow the consumer, from its hold time per
+        //frame against the frame period and from the drop counter of
+        //TY_STRUCT_CAM_STATISTICS, between 1 and the max count
+        void setAdaptiveBuffers(bool enable) { _adaptive = enable; }
+        bool adaptiveBuffers() const { return _adaptive; }
+
         TY_DEV_HANDLE handle() {return device->_handle; }
 
         void RegisterOfflineEventCallback(EventCallback cb, void* data) { device->registerEventCallback(TY_EVENT_DEVICE_OFFLINE, data, cb); }
@@ -220,14 +312,22 @@ class FastCamera
         std::mutex      _dev_lock;
 
         TY_COMPONENT_ID components = 0;
-#define BUF_CNT      (3)
 
         bool isRuning = false;
         std::shared_ptr<TYFrame> fetchFrames(uint32_t timeout_ms);
         TY_STATUS doStop();
 
         std::shared_ptr<TYDevice> device;
-        std::vector<uint8_t> stream_buffer[BUF_CNT];
+        frame_mode _frame_mode = frame_copy;
+        frame_mode _active_mode = frame_copy;   //_frame_mode latched by start()
+        int _buffer_count = BUF_CNT;
+        int _buffer_max = BUF_CNT_MAX;
+        bool _adaptive = false;
+        bool _has_statistics = false;
+        uint64_t _dropped = 0;                  //drop counter at the last adaptation
+        int _fetched = 0;                       //frames since the last adaptation
+        std::chrono::steady_clock::time_point _last_fetch;
+        std::shared_ptr<FrameBufferPool> _pool;
 };
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <functional>
 
 #include <mutex>
 #include <queue>
@@ -8,6 +9,7 @@
 #include <condition_variable>
 
 #include "common.hpp"
+#include "UndistortionPlan.hpp"
 
 namespace percipio_layer {
 
@@ -48,15 +50,24 @@ class TYFrame
     void operator=(TYFrame const&) = delete;
     TYFrame(TYFrame const&) = delete;
     TYFrame(const TY_FRAME_DATA& frame);
+    //leased frame: the images stay in the driver buffer, release is called
+    //once the frame is gone to give it back
+    TYFrame(const TY_FRAME_DATA& frame, std::function<void()> release);
  
     std::shared_ptr<TYImage> depthImage()        { return _images[TY_COMPONENT_DEPTH_CAM];}
     std::shared_ptr<TYImage> colorImage()        { return _images[TY_COMPONENT_RGB_CAM];}
     std::shared_ptr<TYImage> leftIRImage()       { return _images[TY_COMPONENT_IR_CAM_LEFT];}
     std::shared_ptr<TYImage> rightIRImage()      { return _images[TY_COMPONENT_IR_CAM_RIGHT];}
 
+    //images point into the frame buffer, they are valid as long as the frame is
+    bool leased() const { return _release != nullptr; }
+
   private:
     int32_t               bufferSize = 0;
-    std::vector<uint8_t>  userBuffer;
+    std::vector<uint8_t>  userBuffer;           //copy of the driver buffer, empty if leased
+    std::function<void()> _release;
+
+    void setImages(const TY_FRAME_DATA& frame, void* buffer);
 
     typedef std::map<TY_COMPONENT_ID, std::shared_ptr<TYImage>> ty_image;
     ty_image              _images;
@@ -71,6 +82,8 @@ class ImageProcesser
     virtual int parse(const std::shared_ptr<TYImage>& image);
     int DepthImageRender();
     TY_STATUS doUndistortion();
+    //undistorted values of some pixels of the image only, as a count x 1 image
+    TY_STATUS undistortPixels(const uint32_t* pixels, uint32_t count, std::shared_ptr<TYImage>& out);
     int show();
     void clear();
 
@@ -86,6 +99,9 @@ protected:
     TY_ISP_HANDLE color_isp_handle;
     std::shared_ptr<TY_CAMERA_CALIB_INFO> _calib_data;
     bool hasWin;
+
+    UndistortionPlan undistortion;
+    std::shared_ptr<TYImage> undistorted;   //spare output buffer
 };
 
 
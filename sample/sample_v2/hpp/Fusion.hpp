@@ -0,0 +1,105 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include "Frame.hpp"
+#include "PointCloudGenerator.hpp"
+#include "VoxelGrid.hpp"
+
+namespace percipio_layer {
+
+/// A fused cloud, the first count points of buffer.
+struct FusedCloud
+{
+    std::vector<TY_VECT_3F> buffer;
+    uint32_t                count = 0;
+    uint64_t                sequence = 0;       // 1 for the first fused cloud
+    std::vector<uint32_t>   cameraCount;        // points per camera, before deduplication
+
+    const TY_VECT_3F* points() const { return buffer.data(); }
+};
+
+/// Depth frames of several cameras to one cloud in a common frame.
+///
+/// Each camera has a PointCloudGenerator with its pose to the common frame,
+/// fuse() runs them on one worker per camera and merges the packed outputs,
+/// optionally through a VoxelGrid so overlapping views do not double the
+/// points. Two clouds are kept: fuse() builds one while acquire() hands out
+/// the last finished one, a consumer thread can read it meanwhile.
+class PointCloudFusion
+{
+  public:
+    PointCloudFusion();
+    PointCloudFusion(PointCloudFusion const&) = delete;
+    void operator=(PointCloudFusion const&) = delete;
+
+    /// @brief Add a camera, the index of depth images in fuse() is the order of the calls.
+    /// @param  [in]  calib                 Calibration data of the depth camera.
+    /// @param  [in]  pose                  Depth camera frame to the common frame.
+    /// @param  [in]  scaleUnit             TY_FLOAT_SCALE_UNIT of the depth stream.
+    /// @return Index of the camera.
+    int addCamera(const TY_CAMERA_CALIB_INFO& calib, const TY_CAMERA_EXTRINSIC& pose, float scaleUnit = 1.f);
+    int cameraCount() const { return (int)_cameras.size(); }
+
+    /// @brief Generator of a camera, e.g. to set a crop box in the common frame.
+    PointCloudGenerator& generator(int camera) { return *_cameras[camera].generator; }
+
+    /// @brief Voxel size of the deduplication, same unit as the points, 0 (default) to keep all points.
+    void setLeafSize(float size) { _leafSize = size; }
+
+    /// @brief Generate, transform and merge one depth image per camera.
+    ///
+    /// Only one thread may call it. If a consumer still holds the cloud
+    /// acquired before the last one, it waits for its release.
+    /// @param  [in]  depths                DEPTH16 images as captured, distorted, in camera order, NULL
+    ///                                     to leave a camera out.
+    /// @retval TY_STATUS_OK                Succeed, acquire() returns the new cloud.
+    /// @retval TY_STATUS_INVALID_PARAMETER Not one image per camera, or not DEPTH16.
+    /// @retval Other                       Error of PointCloudGenerator or VoxelGrid, no new cloud.
+    TY_STATUS fuse(const std::vector<std::shared_ptr<TYImage>>& depths);
+
+    /// @brief Last fused cloud, NULL before the first one.
+    ///
+    /// Holding it past the next fuse() makes the one after wait for its release.
+    /// The cloud stays valid after the fusion is destroyed.
+    std::shared_ptr<const FusedCloud> acquire();
+
+  private:
+    struct Camera
+    {
+        TY_CAMERA_CALIB_INFO calib;
+        float                scaleUnit;
+        std::unique_ptr<PointCloudGenerator> generator;
+        const uint16_t*      depth;
+        uint32_t             width, height;
+        uint32_t             offset;        // into the merge buffer
+        uint32_t             count;
+        TY_STATUS            status;
+    };
+
+    struct Job;
+    static void cameraTasks(int begin, int end, void* arg);
+
+    std::vector<Camera>     _cameras;
+    float                   _leafSize;
+    VoxelGrid               _voxelGrid;
+    std::vector<TY_VECT_3F> _merged;        // input of the voxel grid
+
+    //shared with the clouds handed out, so a reader may outlive the fusion
+    struct Clouds
+    {
+        FusedCloud              clouds[2];
+        int                     readers[2] = {0, 0};
+        int                     front = -1; // -1 before the first cloud
+        std::mutex              lock;
+        std::condition_variable released;
+    };
+
+    std::shared_ptr<Clouds> _shared;
+    uint64_t                _sequence;
+};
+
+}
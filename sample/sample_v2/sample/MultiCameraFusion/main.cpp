@@ -0,0 +1,124 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+
+#include "Device.hpp"
+#include "Fusion.hpp"
+
+using namespace percipio_layer;
+
+//4x4 row major depth camera to common frame, e.g. from a hand-eye or board calibration
+static bool loadExtrinsic(const std::string& file, TY_CAMERA_EXTRINSIC& extrinsic)
+{
+    std::ifstream in(file);
+    if(!in) {
+        return false;
+    }
+    for(int i = 0; i < 16; i++) {
+        if(!(in >> extrinsic.data[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> list;
+    float leaf = 0.f;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-leaf") == 0 && i + 1 < argc) {
+            leaf = (float)atof(argv[++i]);
+        } else if(strcmp(argv[i], "-list") == 0) {
+            while(i + 1 < argc && argv[i + 1][0] != '-') {
+                list.push_back(argv[++i]);
+            }
+        } else if(strcmp(argv[i], "-h") == 0) {
+            std::cout << "Usage: " << argv[0] << "   [-h] [-leaf <voxel size>] [-list <sn1 sn2 sn3>]" << std::endl;
+            std::cout << "    <sn>.txt holds the 4x4 pose of a camera in the common frame, identity if missing" << std::endl;
+            return 0;
+        }
+    }
+
+    if(!list.size()) {
+        std::cout << "no device select!" << std::endl;
+        return 0;
+    }
+
+    PointCloudFusion fusion;
+    fusion.setLeafSize(leaf);
+    std::vector<std::unique_ptr<FastCamera>> cams;
+    for(size_t i = 0; i < list.size(); i++) {
+        std::unique_ptr<FastCamera> cam(new FastCamera());
+        if(TY_STATUS_OK != cam->open(list[i].c_str())) {
+            std::cout << "open camera " << list[i] << " failed!" << std::endl;
+            return -1;
+        }
+        cam->stream_enable(FastCamera::stream_depth);
+        //frames only live for one fuse(), no need to copy them
+        cam->setFrameMode(FastCamera::frame_lease);
+        //several cameras on one host, only keep the buffers fuse() really needs
+        cam->setAdaptiveBuffers(true);
+
+        TY_CAMERA_CALIB_INFO calib;
+        float scale_unit = 1.f;
+        ASSERT_OK(TYGetStruct(cam->handle(), TY_COMPONENT_DEPTH_CAM, TY_STRUCT_CAM_CALIB_DATA, &calib, sizeof(calib)));
+        ASSERT_OK(TYGetFloat(cam->handle(), TY_COMPONENT_DEPTH_CAM, TY_FLOAT_SCALE_UNIT, &scale_unit));
+
+        TY_CAMERA_EXTRINSIC pose = {{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}};
+        if(!loadExtrinsic(list[i] + ".txt", pose)) {
+            std::cout << "no pose for " << list[i] << ", using identity" << std::endl;
+        }
+        fusion.addCamera(calib, pose, scale_unit);
+        cams.push_back(std::move(cam));
+    }
+
+    for(size_t i = 0; i < cams.size(); i++) {
+        if(TY_STATUS_OK != cams[i]->start()) {
+            std::cout << "stream start failed!" << std::endl;
+            return -1;
+        }
+    }
+
+    //reads the previous cloud while the next one is fused
+    std::atomic<bool> process_exit(false);
+    std::thread consumer([&]() {
+        uint64_t last = 0;
+        while(!process_exit) {
+            auto cloud = fusion.acquire();
+            if(!cloud || cloud->sequence == last) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                continue;
+            }
+            last = cloud->sequence;
+            std::cout << "fused cloud " << cloud->sequence << " : " << cloud->count << " points" << std::endl;
+        }
+    });
+
+    std::vector<std::shared_ptr<TYFrame>> frames(cams.size());
+    std::vector<std::shared_ptr<TYImage>> depths(cams.size());
+    for(int n = 0; n < 100; n++) {
+        for(size_t i = 0; i < cams.size(); i++) {
+            frames[i] = cams[i]->tryGetFrames(2000);
+            depths[i] = frames[i] ? frames[i]->depthImage() : nullptr;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        TY_STATUS status = fusion.fuse(depths);
+        auto end = std::chrono::steady_clock::now();
+        if(status != TY_STATUS_OK) {
+            std::cout << "fuse failed: " << status << std::endl;
+            break;
+        }
+        std::cout << "fuse " << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+    }
+
+    process_exit = true;
+    consumer.join();
+    for(size_t i = 0; i < cams.size(); i++) {
+        cams[i]->stop();
+    }
+    std::cout << "Main done!" << std::endl;
+    return 0;
+}
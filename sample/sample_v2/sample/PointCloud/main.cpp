@@ -6,6 +6,9 @@
 
 #include "Device.hpp"
 #include "TYImageProc.h"
+#include "PointCloudGenerator.hpp"
+#include "PointCloudFormat.hpp"
+#include "Registration.hpp"
 
 #if _WIN32
 #include <conio.h>
@@ -57,12 +60,16 @@ class P3DCamera : public FastCamera
         TY_CAMERA_CALIB_INFO depth_calib, color_calib;
         std::shared_ptr<ImageProcesser> depth_processer;
         std::shared_ptr<ImageProcesser> color_processer;
-        void savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::shared_ptr<TYImage>& color, const char* fileName);
-        void processDepth16(const std::shared_ptr<TYImage>&  depth, std::vector<TY_VECT_3F>& p3d);
+        PointCloudGenerator depth_cloud, color_cloud;
+        DepthToColorPlan depth_to_color;
+        //p3d holds valid points only, index[i] is the pixel of p3d[i]
+        void savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::vector<uint32_t>& index, const std::shared_ptr<TYImage>& color, const char* fileName);
+        void processDepth16(const std::shared_ptr<TYImage>&  depth, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index);
         void processXYZ48(const std::shared_ptr<TYImage>&  depth, std::vector<TY_VECT_3F>& p3d);
 
-        void processDepth16ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d,  std::shared_ptr<TYImage>& registration_color);
-        void processXYZ48ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d,  std::shared_ptr<TYImage>& registration_color);
+        void processDepth16ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index, std::shared_ptr<TYImage>& registration_color);
+        void processXYZ48ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index, std::shared_ptr<TYImage>& registration_color);
+        void densePoints(PointCloudGenerator& cloud, const uint16_t* depth, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index);
 };
 
 TY_STATUS P3DCamera::Init()
@@ -93,9 +100,9 @@ TY_STATUS P3DCamera::Init()
 }
 
 
-void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::shared_ptr<TYImage>& color, const char* fileName)
+void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::vector<uint32_t>& index, const std::shared_ptr<TYImage>& color, const char* fileName)
 {
-    int   pointsCnt = 0;
+    int   pointsCnt = p3d.size();
     const TY_VECT_3F *point = p3d.data();
     std::stringstream ss;
     if(color) {
@@ -106,11 +113,9 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
             {
                 uint8_t* mono8 = pixels;
                 for(int i = 0; i < p3d.size(); i++) {
-                    if(!std::isnan(point->z)) {
-                        ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
-                            (uint32_t)mono8[i] << " " << (uint32_t)mono8[i] << " " << (uint32_t)mono8[i] << std::endl;
-                        pointsCnt++;
-                    }
+                    const uint32_t pix = index[i];
+                    ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
+                        (uint32_t)mono8[pix] << " " << (uint32_t)mono8[pix] << " " << (uint32_t)mono8[pix] << std::endl;
                     point++;
                 }
                 break;
@@ -119,11 +124,9 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
             {
                 uint16_t* mono16 = (uint16_t*)pixels;
                 for(int i = 0; i < p3d.size(); i++) {
-                    if(!std::isnan(point->z)) {
-                        ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
-                            (uint32_t)(mono16[i] >> 8) << " " << (uint32_t)(mono16[i] >> 8) << " " << (uint32_t)(mono16[i] >> 8) << std::endl;
-                        pointsCnt++;
-                    }
+                    const uint32_t pix = index[i];
+                    ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
+                        (uint32_t)(mono16[pix] >> 8) << " " << (uint32_t)(mono16[pix] >> 8) << " " << (uint32_t)(mono16[pix] >> 8) << std::endl;
                     point++;
                 }
                 break;
@@ -132,11 +135,9 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
             {   
                 uint8_t* bgr = pixels;
                 for(int i = 0; i < p3d.size(); i++) {
-                    if(!std::isnan(point->z)) {
-                        ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
-                            (uint32_t)bgr[3*i] << " " << (uint32_t)bgr[3*i + 1] << " " << (uint32_t)bgr[3*i + 2] << std::endl;
-                        pointsCnt++;
-                    }
+                    const uint32_t pix = index[i];
+                    ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
+                        (uint32_t)bgr[3*pix] << " " << (uint32_t)bgr[3*pix + 1] << " " << (uint32_t)bgr[3*pix + 2] << std::endl;
                     point++;
                 }
                 break;
@@ -145,11 +146,9 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
             {
                 uint16_t* bgr16 = (uint16_t*)pixels;
                 for(int i = 0; i < p3d.size(); i++) {
-                    if(!std::isnan(point->z)) {
-                        ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
-                            (uint32_t)(bgr16[3*i] >> 8) << " " << (uint32_t)(bgr16[3*i + 1] >> 8) << " " << (uint32_t)(bgr16[3*i + 2] >> 8) << std::endl;
-                        pointsCnt++;
-                    }
+                    const uint32_t pix = index[i];
+                    ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << " " << 
+                        (uint32_t)(bgr16[3*pix] >> 8) << " " << (uint32_t)(bgr16[3*pix + 1] >> 8) << " " << (uint32_t)(bgr16[3*pix + 2] >> 8) << std::endl;
                     point++;
                 }
                 break;
@@ -158,10 +157,7 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
             {
                 std::cout << "Unsupported RGB format!" << std::endl;
                 for(int i = 0; i < p3d.size(); i++) {
-                    if(!std::isnan(point->z)) {
-                        ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << std::endl;
-                        pointsCnt++;
-                    }
+                    ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << std::endl;
                     point++;
                 }
                 break;
@@ -169,10 +165,7 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
         }
     } else {
         for(int i = 0; i < p3d.size(); i++) {
-            if(!std::isnan(point->z)) {
-                ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << std::endl;
-                pointsCnt++;
-            }
+            ss << (point->x)/1000 << " " << (point->y)/1000 << " " << (point->z)/1000 << std::endl;
             point++;
         }
     }
@@ -195,13 +188,24 @@ void P3DCamera::savePointsToPly(const std::vector<TY_VECT_3F>& p3d, const std::s
     fclose(fp);
 }
 
-void P3DCamera::processDepth16(const std::shared_ptr<TYImage>&  depth, std::vector<TY_VECT_3F>& p3d)
+void P3DCamera::densePoints(PointCloudGenerator& cloud, const uint16_t* depth, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index)
+{
+    uint32_t count = 0;
+    p3d.resize(cloud.width() * cloud.height());
+    index.resize(p3d.size());
+    cloud.computeDense(depth, p3d.data(), index.data(), &count, f_depth_scale_unit);
+    p3d.resize(count);
+    index.resize(count);
+}
+
+void P3DCamera::processDepth16(const std::shared_ptr<TYImage>&  depth, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index)
 {
     if(!depth) return;
 
     if(depth->pixelFormat() == TY_PIXEL_FORMAT_DEPTH16) {
-        p3d.resize(depth->width() * depth->height());
-        TYMapDepthImageToPoint3d(&depth_calib, depth->width(), depth->height(), (uint16_t*)depth->buffer(), &p3d[0], f_depth_scale_unit);
+        //raw depth, the rays undo the lens distortion instead of resampling the image
+        depth_cloud.init(&depth_calib, depth->width(), depth->height(), nullptr, depth_needUndistort);
+        densePoints(depth_cloud, (uint16_t*)depth->buffer(), p3d, index);
     }
 }
 
@@ -210,57 +214,52 @@ void P3DCamera::processXYZ48(const std::shared_ptr<TYImage>&  depth, std::vector
     if(!depth) return;
 
     if(depth->pixelFormat() == TY_PIXEL_FORMAT_XYZ48) {
-        int16_t* src = static_cast<int16_t*>(depth->buffer());
+        //points without depth come out NaN, as for depth16
         p3d.resize(depth->width() * depth->height());
-        for (int pix = 0; pix < p3d.size(); pix++) {
-            p3d[pix].x = *(src + 3*pix + 0) * f_depth_scale_unit;
-            p3d[pix].y = *(src + 3*pix + 1) * f_depth_scale_unit;
-            p3d[pix].z = *(src + 3*pix + 2) * f_depth_scale_unit;
-        }
+        TYXYZ48ToPoints(static_cast<const int16_t*>(depth->buffer()), p3d.size(), f_depth_scale_unit, p3d.data());
     }
 }
 
-void P3DCamera::processDepth16ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::shared_ptr<TYImage>& registration_color)
+void P3DCamera::processDepth16ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index, std::shared_ptr<TYImage>& registration_color)
 {
     if(!depth) return;
 
     depth_processer->parse(depth);
-    if(depth_needUndistort)
-        depth_processer->doUndistortion();
-        
-    if(color) {
-        color_processer->parse(color);
-        if(TY_STATUS_OK == color_processer->doUndistortion()) {
-            //do rgbd registration
-            const std::shared_ptr<TYImage>& depth_image = depth_processer->image();
-            const std::shared_ptr<TYImage>& color_image = color_processer->image();
-            int dstW = depth_image->width();
-            int dstH = depth_image->width() * color_image->height() / color_image->width();
-            std::shared_ptr<TYImage> registration_depth = std::shared_ptr<TYImage>(new TYImage(dstW, dstH, 
-                                                                depth_image->componentID(), 
-                                                                TY_PIXEL_FORMAT_DEPTH16, 
-                                                                sizeof(uint16_t) * dstW * dstH));
-
-            TYMapDepthImageToColorCoordinate(
-                &depth_calib,
-                depth_image->width(), depth_image->height(), static_cast<const uint16_t*>(depth_image->buffer()),
-                &color_calib,
-                registration_depth->width(), registration_depth->height(), static_cast<uint16_t*>(registration_depth->buffer()), f_depth_scale_unit
-            );
-            registration_depth->resize(color_image->width(), color_image->height());
-            registration_color = color_image;
-            p3d.resize(registration_depth->width() * registration_depth->height());
-            TYMapDepthImageToPoint3d(&color_calib, registration_depth->width(), registration_depth->height()
-                , (uint16_t*)registration_depth->buffer(), &p3d[0], f_depth_scale_unit);
-        } else {
-            processDepth16(depth_processer->image(), p3d);
+    if(color && color_processer && 0 == color_processer->parse(color)) {
+        //do rgbd registration, the SDK mapping takes an undistorted depth image
+        if(depth_needUndistort)
+            depth_processer->doUndistortion();
+        const std::shared_ptr<TYImage>& depth_image = depth_processer->image();
+        const std::shared_ptr<TYImage>& color_image = color_processer->image();
+        //straight to color resolution, the plan is rebuilt only if a size changes
+        if(!depth_to_color.isValid() ||
+                depth_to_color.depthWidth() != (uint32_t)depth_image->width() || depth_to_color.depthHeight() != (uint32_t)depth_image->height() ||
+                depth_to_color.mappedWidth() != (uint32_t)color_image->width() || depth_to_color.mappedHeight() != (uint32_t)color_image->height()) {
+            depth_to_color.init(&depth_calib, depth_image->width(), depth_image->height(),
+                                &color_calib, color_image->width(), color_image->height(), f_depth_scale_unit);
+            depth_to_color.setSplat(true);
+        }
+        std::shared_ptr<TYImage> registration_depth = std::shared_ptr<TYImage>(new TYImage(color_image->width(), color_image->height(), 
+                                                            depth_image->componentID(), 
+                                                            TY_PIXEL_FORMAT_DEPTH16, 
+                                                            sizeof(uint16_t) * color_image->width() * color_image->height()));
+        depth_to_color.execute(static_cast<const uint16_t*>(depth_image->buffer()), static_cast<uint16_t*>(registration_depth->buffer()));
+        color_cloud.init(&color_calib, registration_depth->width(), registration_depth->height());
+        densePoints(color_cloud, (uint16_t*)registration_depth->buffer(), p3d, index);
+
+        //the undistorted color of each point straight from the raw image,
+        //the whole color image is never undistorted
+        if(TY_STATUS_OK == color_processer->undistortPixels(index.data(), index.size(), registration_color)) {
+            for(size_t i = 0; i < index.size(); i++) {
+                index[i] = i;
+            }
         }
     } else {
-        processDepth16(depth_processer->image(), p3d);
+        processDepth16(depth_processer->image(), p3d, index);
     }
 }
 
-void P3DCamera::processXYZ48ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::shared_ptr<TYImage>& registration_color)
+void P3DCamera::processXYZ48ToPoint3D(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color, std::vector<TY_VECT_3F>& p3d, std::vector<uint32_t>& index, std::shared_ptr<TYImage>& registration_color)
 {
     if(!depth) return;
     
@@ -269,28 +268,34 @@ void P3DCamera::processXYZ48ToPoint3D(const std::shared_ptr<TYImage>&  depth, co
         if(TY_STATUS_OK == color_processer->doUndistortion()) {
             registration_color = color_processer->image();
 
-            processXYZ48(depth, p3d);
-
+            //unpack straight into the color camera frame
             TY_CAMERA_EXTRINSIC extri_inv;
             TYInvertExtrinsic(&color_calib.extrinsic, &extri_inv);
-            TYMapPoint3dToPoint3d(&extri_inv, p3d.data(), p3d.size(), p3d.data());
+            p3d.resize(depth->width() * depth->height());
+            TYXYZ48ToPoints(static_cast<const int16_t*>(depth->buffer()), p3d.size(), f_depth_scale_unit, &extri_inv, p3d.data());
 
             std::vector<uint16_t> mappedDepth(registration_color->width() * registration_color->height());
             TYMapPoint3dToDepthImage(&color_calib, p3d.data(), depth->width() * depth->height(),  registration_color->width(), registration_color->height(), mappedDepth.data(), f_depth_scale_unit);
-            p3d.resize(registration_color->width() * registration_color->height());
-            TYMapDepthImageToPoint3d(&color_calib, registration_color->width(), registration_color->height()
-                , mappedDepth.data(), &p3d[0], f_depth_scale_unit);
+            color_cloud.init(&color_calib, registration_color->width(), registration_color->height());
+            densePoints(color_cloud, mappedDepth.data(), p3d, index);
+            return;
         } else {
             processXYZ48(depth, p3d);
         }
     } else {
         processXYZ48(depth, p3d);
     }
+
+    index.resize(p3d.size());
+    uint32_t count = PointCloudGenerator::compact(p3d.data(), p3d.size(), p3d.data(), index.data());
+    p3d.resize(count);
+    index.resize(count);
 }
 
 int P3DCamera::process(const std::shared_ptr<TYImage>&  depth, const std::shared_ptr<TYImage>&  color)
 {
     std::vector<TY_VECT_3F> p3d;
+    std::vector<uint32_t> index;
     std::shared_ptr<TYImage> registration_color = nullptr;
     if(!depth) {
         std::cout << "depth image is empty!" << std::endl;
@@ -299,9 +304,9 @@ int P3DCamera::process(const std::shared_ptr<TYImage>&  depth, const std::shared
 
     TY_PIXEL_FORMAT fmt = depth->pixelFormat();
     if(fmt == TY_PIXEL_FORMAT_DEPTH16)
-        processDepth16ToPoint3D(depth, color, p3d, registration_color);
+        processDepth16ToPoint3D(depth, color, p3d, index, registration_color);
     else if(fmt == TY_PIXEL_FORMAT_XYZ48)
-        processXYZ48ToPoint3D(depth, color, p3d, registration_color);
+        processXYZ48ToPoint3D(depth, color, p3d, index, registration_color);
     else {
         std::cout << "Invalid depth image format!" << std::endl;
         return -1;
@@ -319,7 +324,7 @@ int P3DCamera::process(const std::shared_ptr<TYImage>&  depth, const std::shared
         struct tm* p = std::localtime(&now_time);
         sprintf(file, "%d.%d.%d %02d_%02d_%02d.ply", 1900 + p->tm_year, 1+p->tm_mon, p->tm_mday, p->tm_hour, p->tm_min, p->tm_sec);
         std::cout << "Save : " << file << std::endl;
-        savePointsToPly(p3d, registration_color,  file);
+        savePointsToPly(p3d, index, registration_color,  file);
         std::cout << file << "Saved!" << std::endl;
         break;
     }
@@ -354,6 +359,8 @@ int main(int argc, char* argv[])
     }
 
     _3dcam.Init();
+    //each frame is processed before the next one is fetched, no need to copy it
+    _3dcam.setFrameMode(FastCamera::frame_lease);
     if(TY_STATUS_OK != _3dcam.start()) {
         std::cout << "stream start failed!" << std::endl;
         return -1;
@@ -1,5 +1,6 @@
 #include "Device.hpp"
 #include "TYCoordinateMapper.h"
+#include "Registration.hpp"
 
 #define MAP_DEPTH_TO_COLOR  1
 
@@ -115,20 +116,26 @@ class Dep2RGBParser: public RegistrationParser {
 public:
     int doRegistration(const std::shared_ptr<TYImage>& depth, const std::shared_ptr<TYImage>& color)
     {
-        int dstW = depth->width();
-        int dstH = depth->width() * color->height() / color->width();
+        //straight to color resolution, the plan is rebuilt only if a size changes
+        if(!plan.isValid() || plan.depthWidth() != (uint32_t)depth->width() || plan.depthHeight() != (uint32_t)depth->height() ||
+                plan.mappedWidth() != (uint32_t)color->width() || plan.mappedHeight() != (uint32_t)color->height()) {
+            if(TY_STATUS_OK != plan.init(&depth_calib, depth->width(), depth->height(),
+                                         &color_calib, color->width(), color->height(), f_depth_scale_unit)) {
+                return -1;
+            }
+            plan.setSplat(true);
+        }
+        int dstW = color->width();
+        int dstH = color->height();
         std::shared_ptr<TYImage> dst;
         dst = std::shared_ptr<TYImage>(new TYImage(dstW, dstH, depth->componentID(), TY_PIXEL_FORMAT_DEPTH16, sizeof(uint16_t) * dstW * dstH));
-        TYMapDepthImageToColorCoordinate(
-                  &depth_calib,
-                  depth->width(), depth->height(), static_cast<const uint16_t*>(depth->buffer()),
-                  &color_calib,
-                  dstW, dstH, static_cast<uint16_t*>(dst->buffer()),
-                  f_depth_scale_unit);
-        dst->resize(color->width(), color->height());
+        plan.execute(static_cast<const uint16_t*>(depth->buffer()), static_cast<uint16_t*>(dst->buffer()));
         stream[TY_COMPONENT_DEPTH_CAM]->parse(dst);
         return 0;
     }
+
+private:
+    DepthToColorPlan plan;
 };
 
 class RGBDRegistrationCamera : public FastCamera
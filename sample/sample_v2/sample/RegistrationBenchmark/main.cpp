@@ -0,0 +1,184 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "TYCoordinateMapper.h"
+#include "Registration.hpp"
+
+// Offline comparison of the float and fixed point depth to color kernels
+// of DepthToColorPlan, on synthetic frames, no camera needed.
+
+static const uint32_t DEPTH_W = 640;
+static const uint32_t DEPTH_H = 480;
+static const uint32_t COLOR_W = 1280;
+static const uint32_t COLOR_H = 960;
+
+static void make_calib(TY_CAMERA_CALIB_INFO& depth, TY_CAMERA_CALIB_INFO& color)
+{
+    memset(&depth, 0, sizeof(depth));
+    memset(&color, 0, sizeof(color));
+
+    const float kd[9] = {1050.3f, 0, 641.7f, 0, 1049.1f, 478.2f, 0, 0, 1};
+    const float ed[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    depth.intrinsicWidth = 1280;
+    depth.intrinsicHeight = 960;
+    memcpy(depth.intrinsic.data, kd, sizeof(kd));
+    memcpy(depth.extrinsic.data, ed, sizeof(ed));
+
+    // color camera 25mm aside, slightly rotated
+    const float a = 0.02f, b = -0.015f;
+    const float kc[9] = {1380.5f, 0, 955.2f, 0, 1379.9f, 541.3f, 0, 0, 1};
+    const float ec[16] = { cosf(a),       0,        sinf(a),  -25.3f,
+                           0,             cosf(b), -sinf(b),    1.7f,
+                          -sinf(a), sinf(b), cosf(a) * cosf(b), 3.1f,
+                           0,             0,        0,          1};
+    color.intrinsicWidth = 1920;
+    color.intrinsicHeight = 1080;
+    memcpy(color.intrinsic.data, kc, sizeof(kc));
+    memcpy(color.extrinsic.data, ec, sizeof(ec));
+}
+
+// 0: slanted plane, 1: boxes in front of a wall, 2: far range with holes
+static void make_depth(int scene, std::vector<uint16_t>& depth)
+{
+    depth.resize(DEPTH_W * DEPTH_H);
+    srand(scene + 1);
+    for(uint32_t v = 0; v < DEPTH_H; v++) {
+        for(uint32_t u = 0; u < DEPTH_W; u++) {
+            int d = 0;
+            switch(scene) {
+            case 0:
+                d = 500 + u * 2 + v;
+                break;
+            case 1:
+                d = 1500;
+                if((u / 80) % 2 && (v / 60) % 2) d = 700 + (u % 80) + (v % 60);
+                break;
+            default:
+                d = 3000 + (int)(2000 * sinf(u * 0.01f) * cosf(v * 0.013f)) + rand() % 16;
+                if(rand() % 20 == 0) d = 0;
+                break;
+            }
+            depth[v * DEPTH_W + u] = (uint16_t)d;
+        }
+    }
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ms(const bench_clock::time_point& start, int loops)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count() / loops;
+}
+
+int main(int argc, char* argv[])
+{
+    int loops = 20;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-loop") == 0 && i + 1 < argc) {
+            loops = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            std::cout << "Usage: " << argv[0] << "   [-h] [-loop <N>]" << std::endl;
+            return 0;
+        }
+    }
+    if(loops <= 0) loops = 1;
+
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    make_calib(depth_calib, color_calib);
+
+    DepthToColorPlan fplan, xplan;
+    if(fplan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H) != TY_STATUS_OK
+            || xplan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H) != TY_STATUS_OK) {
+        std::cout << "plan init failed!" << std::endl;
+        return -1;
+    }
+    if(xplan.setKernel(DepthToColorPlan::KERNEL_FIXED) != TY_STATUS_OK) {
+        std::cout << "calibration out of fixed point range!" << std::endl;
+        return -1;
+    }
+
+    // projection alone, the hole filling both paths end with is timed apart
+    DepthToColorPlan pplan;
+    pplan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H);
+    pplan.setHoleFilling(false);
+
+    std::vector<uint16_t> depth;
+    std::vector<uint16_t> sdk(COLOR_W * COLOR_H), fout(COLOR_W * COLOR_H), xout(COLOR_W * COLOR_H);
+    std::vector<uint16_t> pout(COLOR_W * COLOR_H), holes(COLOR_W * COLOR_H);
+    std::vector<TY_PIXEL_DESC> flut(DEPTH_W * DEPTH_H), xlut(DEPTH_W * DEPTH_H);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "depth " << DEPTH_W << "x" << DEPTH_H << " -> color " << COLOR_W << "x" << COLOR_H
+              << ", " << loops << " loops, float kernel " << DepthToColorPlan::instructionSet() << std::endl;
+    for(int scene = 0; scene < 3; scene++) {
+        make_depth(scene, depth);
+
+        bench_clock::time_point t = bench_clock::now();
+        for(int i = 0; i < loops; i++)
+            TYMapDepthImageToColorCoordinate(&depth_calib, DEPTH_W, DEPTH_H, &depth[0],
+                    &color_calib, COLOR_W, COLOR_H, &sdk[0]);
+        double sdk_ms = elapsed_ms(t, loops);
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) fplan.execute(&depth[0], &fout[0]);
+        double float_ms = elapsed_ms(t, loops);
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) xplan.execute(&depth[0], &xout[0]);
+        double fixed_ms = elapsed_ms(t, loops);
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) pplan.execute(&depth[0], &pout[0]);
+        double project_ms = elapsed_ms(t, loops);
+
+        double fill_ms = 0;
+        for(int i = 0; i < loops; i++) {
+            holes = pout;
+            t = bench_clock::now();
+            TYDepthImageFillEmptyRegion(&holes[0], COLOR_W, COLOR_H);
+            fill_ms += elapsed_ms(t, loops);
+        }
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) fplan.createLookupTable(&depth[0], &flut[0]);
+        double float_lut_ms = elapsed_ms(t, loops);
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) xplan.createLookupTable(&depth[0], &xlut[0]);
+        double fixed_lut_ms = elapsed_ms(t, loops);
+
+        // accuracy of fixed against float, per table entry; in the depth
+        // image a moved point may also win or lose a z-buffer fight
+        uint32_t image_diff = 0, lut_diff = 0, coord_diff = 0, depth_diff = 0;
+        for(size_t i = 0; i < fout.size(); i++) {
+            if(fout[i] != xout[i]) image_diff++;
+        }
+        for(size_t i = 0; i < flut.size(); i++) {
+            int du = abs(flut[i].x - xlut[i].x);
+            int dv = abs(flut[i].y - xlut[i].y);
+            int dd = abs(flut[i].depth - xlut[i].depth);
+            if(du || dv || dd) lut_diff++;
+            coord_diff = std::max<uint32_t>(coord_diff, std::max(du, dv));
+            depth_diff = std::max<uint32_t>(depth_diff, dd);
+        }
+
+        std::cout << "scene " << scene << std::endl;
+        std::cout << "\tmap depth image   sdk " << sdk_ms << " ms, float " << float_ms
+                  << " ms, fixed " << fixed_ms << " ms" << std::endl;
+        std::cout << "\t  of which         float projection " << project_ms << " ms, hole filling "
+                  << fill_ms << " ms" << std::endl;
+        std::cout << "\tlookup table      float " << float_lut_ms << " ms, fixed " << fixed_lut_ms << " ms" << std::endl;
+        std::cout << "\tfixed vs float    table entries differ " << 100.0 * lut_diff / flut.size()
+                  << "%, max coordinate diff " << coord_diff << " px, max depth diff " << depth_diff << std::endl;
+        std::cout << "\t                  image pixels differ " << 100.0 * image_diff / fout.size() << "%" << std::endl;
+    }
+
+    std::cout << "Main done!" << std::endl;
+    return 0;
+}
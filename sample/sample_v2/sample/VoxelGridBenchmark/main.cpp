@@ -0,0 +1,118 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+
+#include "TYCoordinateMapper.h"
+#include "TYThread.hpp"
+#include "PointCloudGenerator.hpp"
+#include "VoxelGrid.hpp"
+
+// Offline timing of VoxelGrid on the cloud of a synthetic 1280x960 depth
+// frame, no camera needed.
+
+static const uint32_t DEPTH_W = 1280;
+static const uint32_t DEPTH_H = 960;
+
+static void make_calib(TY_CAMERA_CALIB_INFO& depth)
+{
+    memset(&depth, 0, sizeof(depth));
+    const float kd[9] = {1050.3f, 0, 641.7f, 0, 1049.1f, 478.2f, 0, 0, 1};
+    const float ed[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    depth.intrinsicWidth = 1280;
+    depth.intrinsicHeight = 960;
+    memcpy(depth.intrinsic.data, kd, sizeof(kd));
+    memcpy(depth.extrinsic.data, ed, sizeof(ed));
+}
+
+// boxes on a table in front of a wall, a few holes
+static void make_depth(std::vector<uint16_t>& depth)
+{
+    depth.resize(DEPTH_W * DEPTH_H);
+    srand(1);
+    for(uint32_t v = 0; v < DEPTH_H; v++) {
+        for(uint32_t u = 0; u < DEPTH_W; u++) {
+            int d = v < DEPTH_H / 2 ? 1800 : 1800 - (int)(v - DEPTH_H / 2) * 2;
+            if((u / 160) % 2 && v > DEPTH_H / 3 && (v / 120) % 2) d = 900 + (u % 160) + rand() % 4;
+            if(rand() % 50 == 0) d = 0;
+            depth[v * DEPTH_W + u] = (uint16_t)d;
+        }
+    }
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ms(const bench_clock::time_point& start, int loops)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count() / loops;
+}
+
+int main(int argc, char* argv[])
+{
+    int loops = 20;
+    int threads = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-loop") == 0 && i + 1 < argc) {
+            loops = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "-h") == 0) {
+            std::cout << "Usage: " << argv[0] << "   [-h] [-loop <N>] [-threads <N>]" << std::endl;
+            return 0;
+        }
+    }
+    if(loops <= 0) loops = 1;
+
+    TY_CAMERA_CALIB_INFO depth_calib;
+    make_calib(depth_calib);
+    std::vector<uint16_t> depth;
+    make_depth(depth);
+
+    PointCloudGenerator cloud;
+    cloud.init(&depth_calib, DEPTH_W, DEPTH_H);
+    std::vector<TY_VECT_3F> points(DEPTH_W * DEPTH_H);
+    cloud.compute(&depth[0], &points[0]);
+
+    std::vector<uint8_t> rgb(3 * points.size());
+    for(size_t i = 0; i < rgb.size(); i++) {
+        rgb[i] = (uint8_t)(i * 37);
+    }
+
+    std::vector<TY_VECT_3F> out(points.size());
+    std::vector<uint8_t> out_rgb(rgb.size());
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "organized cloud " << DEPTH_W << "x" << DEPTH_H << ", "
+              << (threads > 0 ? threads : TYThreadHardwareConcurrency()) << " threads, "
+              << loops << " loops" << std::endl;
+    const float leafs[] = {2.f, 5.f, 10.f};
+    for(size_t l = 0; l < sizeof(leafs) / sizeof(leafs[0]); l++) {
+        VoxelGrid grid;
+        grid.setLeafSize(leafs[l]);
+        grid.setThreadCount(threads);
+        uint32_t count = 0;
+
+        bench_clock::time_point t = bench_clock::now();
+        for(int i = 0; i < loops; i++) grid.filter(&points[0], points.size(), NULL, &out[0], NULL, &count);
+        double centroid_ms = elapsed_ms(t, loops);
+
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) grid.filter(&points[0], points.size(), &rgb[0], &out[0], &out_rgb[0], &count);
+        double color_ms = elapsed_ms(t, loops);
+
+        grid.setSelection(VoxelGrid::VOXEL_FIRST_POINT);
+        t = bench_clock::now();
+        for(int i = 0; i < loops; i++) grid.filter(&points[0], points.size(), NULL, &out[0], NULL, &count);
+        double first_ms = elapsed_ms(t, loops);
+
+        std::cout << "leaf " << leafs[l] << " mm, " << count << " voxels" << std::endl;
+        std::cout << "\tcentroid " << centroid_ms << " ms, centroid and color " << color_ms
+                  << " ms, first point " << first_ms << " ms" << std::endl;
+    }
+
+    std::cout << "Main done!" << std::endl;
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "TYCoordinateMapper.h"
+#include "NormalEstimator.hpp"
+
+// NormalEstimator against a per pixel PCA of the same window, computed
+// directly with a Jacobi eigen solver, on a tilted plane and on a sphere,
+// both with holes. Normals must also match the true surface normal.
+
+static const uint32_t CLOUD_W = 320;
+static const uint32_t CLOUD_H = 240;
+static const float    FOCAL = 300.f;
+static const int      WINDOW = 7;
+
+static const float SPHERE_C[3] = {50.f, -30.f, 1200.f};
+static const float SPHERE_R = 500.f;
+
+// ray of pixel (u, v) through the camera origin
+static void pixel_ray(uint32_t u, uint32_t v, double* ray)
+{
+    ray[0] = (u - CLOUD_W * 0.5) / FOCAL;
+    ray[1] = (v - CLOUD_H * 0.5) / FOCAL;
+    ray[2] = 1.0;
+}
+
+// z = 1000 + 0.3 x - 0.2 y, normal faces the camera
+static void make_plane(std::vector<TY_VECT_3F>& points, std::vector<TY_VECT_3F>& truth)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const double n[3] = {0.3, -0.2, -1.0};
+    const double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    points.resize(CLOUD_W * CLOUD_H);
+    truth.resize(points.size());
+    srand(1);
+    for(uint32_t v = 0; v < CLOUD_H; v++) {
+        for(uint32_t u = 0; u < CLOUD_W; u++) {
+            const size_t i = v * CLOUD_W + u;
+            double ray[3];
+            pixel_ray(u, v, ray);
+            const double z = 1000.0 / (1.0 - 0.3 * ray[0] + 0.2 * ray[1]);
+            points[i].x = (float)(ray[0] * z);
+            points[i].y = (float)(ray[1] * z);
+            points[i].z = (float)z;
+            if(rand() % 9 == 0) points[i].x = points[i].y = points[i].z = nan;
+            truth[i].x = (float)(n[0] / len);
+            truth[i].y = (float)(n[1] / len);
+            truth[i].z = (float)(n[2] / len);
+        }
+    }
+}
+
+// front of the sphere, NaN where the ray misses it
+static void make_sphere(std::vector<TY_VECT_3F>& points, std::vector<TY_VECT_3F>& truth)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    points.resize(CLOUD_W * CLOUD_H);
+    truth.resize(points.size());
+    srand(2);
+    for(uint32_t v = 0; v < CLOUD_H; v++) {
+        for(uint32_t u = 0; u < CLOUD_W; u++) {
+            const size_t i = v * CLOUD_W + u;
+            double ray[3];
+            pixel_ray(u, v, ray);
+            // |t ray - c|^2 = r^2, nearest root
+            const double a = ray[0] * ray[0] + ray[1] * ray[1] + ray[2] * ray[2];
+            const double b = ray[0] * SPHERE_C[0] + ray[1] * SPHERE_C[1] + ray[2] * SPHERE_C[2];
+            const double c = SPHERE_C[0] * SPHERE_C[0] + SPHERE_C[1] * SPHERE_C[1]
+                           + SPHERE_C[2] * SPHERE_C[2] - SPHERE_R * SPHERE_R;
+            const double disc = b * b - a * c;
+            if(disc <= 0 || rand() % 13 == 0) {
+                points[i].x = points[i].y = points[i].z = nan;
+                truth[i] = points[i];
+                continue;
+            }
+            const double t = (b - sqrt(disc)) / a;
+            points[i].x = (float)(ray[0] * t);
+            points[i].y = (float)(ray[1] * t);
+            points[i].z = (float)(ray[2] * t);
+            truth[i].x = (points[i].x - SPHERE_C[0]) / SPHERE_R;
+            truth[i].y = (points[i].y - SPHERE_C[1]) / SPHERE_R;
+            truth[i].z = (points[i].z - SPHERE_C[2]) / SPHERE_R;
+        }
+    }
+}
+
+// eigenvector of the smallest eigenvalue of the symmetric 3x3 a, by cyclic Jacobi rotations
+static void jacobi_smallest(double a[3][3], double* n)
+{
+    double e[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    for(int sweep = 0; sweep < 50; sweep++) {
+        const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+        if(off < 1e-30) break;
+        for(int p = 0; p < 2; p++) {
+            for(int q = p + 1; q < 3; q++) {
+                if(a[p][q] == 0) continue;
+                const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                const double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                const double c = 1 / sqrt(t * t + 1), s = t * c;
+                for(int k = 0; k < 3; k++) {
+                    const double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for(int k = 0; k < 3; k++) {
+                    const double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for(int k = 0; k < 3; k++) {
+                    const double ekp = e[k][p], ekq = e[k][q];
+                    e[k][p] = c * ekp - s * ekq;
+                    e[k][q] = s * ekp + c * ekq;
+                }
+            }
+        }
+    }
+    int m = 0;
+    for(int k = 1; k < 3; k++) {
+        if(a[k][k] < a[m][m]) m = k;
+    }
+    for(int k = 0; k < 3; k++) n[k] = e[k][m];
+}
+
+// PCA normal of the clipped window of pixel i, facing the origin; false if too few points
+static bool pca_normal(const std::vector<TY_VECT_3F>& points, uint32_t u, uint32_t v, double* n)
+{
+    const int R = WINDOW / 2;
+    double mean[3] = {0, 0, 0};
+    std::vector<const TY_VECT_3F*> window;
+    for(int y = std::max(0, (int)v - R); y < std::min((int)CLOUD_H, (int)v + R + 1); y++) {
+        for(int x = std::max(0, (int)u - R); x < std::min((int)CLOUD_W, (int)u + R + 1); x++) {
+            const TY_VECT_3F& p = points[y * CLOUD_W + x];
+            if(p.z != p.z) continue;
+            window.push_back(&p);
+            mean[0] += p.x;
+            mean[1] += p.y;
+            mean[2] += p.z;
+        }
+    }
+    if(window.size() < 3) return false;
+    for(int k = 0; k < 3; k++) mean[k] /= window.size();
+    double C[3][3] = {{0}};
+    for(size_t j = 0; j < window.size(); j++) {
+        const double d[3] = {window[j]->x - mean[0], window[j]->y - mean[1], window[j]->z - mean[2]};
+        for(int r = 0; r < 3; r++) {
+            for(int c = 0; c < 3; c++) C[r][c] += d[r] * d[c] / window.size();
+        }
+    }
+    jacobi_smallest(C, n);
+    const TY_VECT_3F& p = points[v * CLOUD_W + u];
+    if(n[0] * p.x + n[1] * p.y + n[2] * p.z > 0) {
+        for(int k = 0; k < 3; k++) n[k] = -n[k];
+    }
+    return true;
+}
+
+static double angle_deg(const double* a, const TY_VECT_3F& b)
+{
+    const double d = a[0] * b.x + a[1] * b.y + a[2] * b.z;
+    return acos(std::max(-1.0, std::min(1.0, d))) * 180.0 / M_PI;
+}
+
+// Angles in degrees. The integral images sum in double relative to a point
+// of the strip, a few hundredths of a degree from the direct PCA. max_truth
+// bounds the angle to the true normal where the surface faces the camera,
+// the window of a curved surface tilts the PCA normal a little.
+static int check(const char* name, const std::vector<TY_VECT_3F>& points,
+                 const std::vector<TY_VECT_3F>& truth, int threads, double max_truth)
+{
+    NormalEstimator estimator;
+    estimator.setWindowSize(WINDOW);
+    estimator.setThreadCount(threads);
+    std::vector<TY_VECT_3F> normals(points.size());
+    if(estimator.compute(&points[0], CLOUD_W, CLOUD_H, &normals[0]) != TY_STATUS_OK) {
+        std::cout << name << ": compute failed" << std::endl;
+        return 1;
+    }
+
+    double pca_err = 0, truth_err = 0;
+    uint32_t checked = 0, mismatched = 0;
+    for(uint32_t v = 0; v < CLOUD_H; v++) {
+        for(uint32_t u = 0; u < CLOUD_W; u++) {
+            const size_t i = v * CLOUD_W + u;
+            const bool has_point = points[i].z == points[i].z;
+            double n[3];
+            const bool expect = has_point && pca_normal(points, u, v, n);
+            const bool got = normals[i].z == normals[i].z;
+            if(expect != got) {
+                mismatched++;
+                continue;
+            }
+            if(!expect) continue;
+            const double t[3] = {truth[i].x, truth[i].y, truth[i].z};
+            pca_err = std::max(pca_err, angle_deg(n, normals[i]));
+            // grazing parts of the sphere rim get one sided windows
+            const TY_VECT_3F& p = points[i];
+            const double facing = -(t[0] * p.x + t[1] * p.y + t[2] * p.z) / sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+            if(facing > 0.5) truth_err = std::max(truth_err, angle_deg(t, normals[i]));
+            checked++;
+        }
+    }
+
+    std::cout << name << ", " << threads << " threads: " << checked << " normals, max "
+              << pca_err << " deg from PCA, " << truth_err << " deg from the surface, "
+              << mismatched << " NaN mismatches" << std::endl;
+    if(!checked || mismatched || pca_err > 0.1 || truth_err > max_truth) {
+        std::cout << "\tnormal estimator departs from the PCA normal" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    int failed = 0;
+    std::vector<TY_VECT_3F> points, truth;
+
+    make_plane(points, truth);
+    for(int threads = 1; threads <= 4; threads += 3) {
+        failed += check("plane", points, truth, threads, 0.05);
+    }
+
+    make_sphere(points, truth);
+    for(int threads = 1; threads <= 4; threads += 3) {
+        failed += check("sphere", points, truth, threads, 2.0);
+    }
+
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? 1 : 0;
+}
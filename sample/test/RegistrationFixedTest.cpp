@@ -0,0 +1,153 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "TYCoordinateMapper.h"
+#include "Registration.hpp"
+
+// The fixed point kernel of DepthToColorPlan, SIMD (NEON on ARM) against
+// its scalar reference and against the float kernel.
+
+static const uint32_t DEPTH_W = 640;
+static const uint32_t DEPTH_H = 480;
+static const uint32_t COLOR_W = 1280;
+static const uint32_t COLOR_H = 960;
+
+static void make_calib(TY_CAMERA_CALIB_INFO& depth, TY_CAMERA_CALIB_INFO& color)
+{
+    memset(&depth, 0, sizeof(depth));
+    memset(&color, 0, sizeof(color));
+
+    const float kd[9] = {1050.3f, 0, 641.7f, 0, 1049.1f, 478.2f, 0, 0, 1};
+    const float ed[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    depth.intrinsicWidth = 1280;
+    depth.intrinsicHeight = 960;
+    memcpy(depth.intrinsic.data, kd, sizeof(kd));
+    memcpy(depth.extrinsic.data, ed, sizeof(ed));
+
+    const float a = 0.02f, b = -0.015f;
+    const float kc[9] = {1380.5f, 0, 955.2f, 0, 1379.9f, 541.3f, 0, 0, 1};
+    const float ec[16] = { cosf(a),       0,        sinf(a),  -25.3f,
+                           0,             cosf(b), -sinf(b),    1.7f,
+                          -sinf(a), sinf(b), cosf(a) * cosf(b), 3.1f,
+                           0,             0,        0,          1};
+    color.intrinsicWidth = 1920;
+    color.intrinsicHeight = 1080;
+    memcpy(color.intrinsic.data, kc, sizeof(kc));
+    memcpy(color.extrinsic.data, ec, sizeof(ec));
+}
+
+// near to far range, odd widths of valid runs so the SIMD tails are hit
+static void make_depth(int scene, std::vector<uint16_t>& depth)
+{
+    depth.resize(DEPTH_W * DEPTH_H);
+    srand(scene + 1);
+    for(uint32_t v = 0; v < DEPTH_H; v++) {
+        for(uint32_t u = 0; u < DEPTH_W; u++) {
+            int d = 0;
+            switch(scene) {
+            case 0:
+                d = 200 + u * 2 + v;
+                break;
+            case 1:
+                d = 3000 + (int)(2000 * sinf(u * 0.01f) * cosf(v * 0.013f)) + rand() % 16;
+                if(rand() % 7 == 0) d = 0;
+                break;
+            default:
+                d = rand() % 65536;
+                break;
+            }
+            depth[v * DEPTH_W + u] = (uint16_t)d;
+        }
+    }
+}
+
+struct LutDiff
+{
+    uint32_t entries;       // entries that differ at all
+    int      coord;         // max coordinate difference, px
+    int      depth;         // max depth difference
+};
+
+// entries that land in the color image, far off it the 1 px bound does not hold
+static LutDiff compare(const std::vector<TY_PIXEL_DESC>& a, const std::vector<TY_PIXEL_DESC>& b)
+{
+    LutDiff r = {0, 0, 0};
+    for(size_t i = 0; i < a.size(); i++) {
+        if(a[i].x < 0 || a[i].y < 0 || a[i].x >= (int)COLOR_W || a[i].y >= (int)COLOR_H) continue;
+        int du = abs(a[i].x - b[i].x);
+        int dv = abs(a[i].y - b[i].y);
+        int dd = abs(a[i].depth - b[i].depth);
+        if(du || dv || dd) r.entries++;
+        r.coord = std::max(r.coord, std::max(du, dv));
+        r.depth = std::max(r.depth, dd);
+    }
+    return r;
+}
+
+int main()
+{
+    TY_CAMERA_CALIB_INFO depth_calib, color_calib;
+    make_calib(depth_calib, color_calib);
+
+    DepthToColorPlan fplan, xplan, splan;
+    if(fplan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H) != TY_STATUS_OK
+            || xplan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H) != TY_STATUS_OK
+            || splan.init(&depth_calib, DEPTH_W, DEPTH_H, &color_calib, COLOR_W, COLOR_H) != TY_STATUS_OK) {
+        std::cout << "plan init failed!" << std::endl;
+        return -1;
+    }
+    if(xplan.setKernel(DepthToColorPlan::KERNEL_FIXED) != TY_STATUS_OK
+            || splan.setKernel(DepthToColorPlan::KERNEL_FIXED_SCALAR) != TY_STATUS_OK) {
+        std::cout << "calibration out of fixed point range!" << std::endl;
+        return -1;
+    }
+    std::cout << "float kernel " << DepthToColorPlan::instructionSet() << std::endl;
+
+    int failed = 0;
+    std::vector<uint16_t> depth;
+    std::vector<TY_PIXEL_DESC> flut(DEPTH_W * DEPTH_H), xlut(DEPTH_W * DEPTH_H), slut(DEPTH_W * DEPTH_H);
+    std::vector<uint16_t> xout(COLOR_W * COLOR_H), sout(COLOR_W * COLOR_H);
+    for(int scene = 0; scene < 3; scene++) {
+        make_depth(scene, depth);
+        fplan.createLookupTable(&depth[0], &flut[0]);
+        xplan.createLookupTable(&depth[0], &xlut[0]);
+        splan.createLookupTable(&depth[0], &slut[0]);
+        xplan.execute(&depth[0], &xout[0]);
+        splan.execute(&depth[0], &sout[0]);
+
+        // same integer transform, only the reciprocal may round differently;
+        // its NEON estimate is good to about 2^-16, a few coordinates in a
+        // thousand cross a pixel border
+        LutDiff simd = compare(xlut, slut);
+        LutDiff flt = compare(flut, xlut);
+        uint32_t image_diff = 0;
+        for(size_t i = 0; i < xout.size(); i++) {
+            if(xout[i] != sout[i]) image_diff++;
+        }
+
+        std::cout << "scene " << scene << ": fixed vs scalar fixed " << simd.entries << " entries, max "
+                  << simd.coord << " px, depth " << simd.depth << ", " << image_diff << " image pixels; "
+                  << "fixed vs float " << flt.entries << " entries, max " << flt.coord << " px, depth "
+                  << flt.depth << std::endl;
+        if(simd.coord > 1 || simd.depth != 0 || simd.entries > flut.size() / 100) {
+            std::cout << "\tfixed kernel departs from its scalar reference" << std::endl;
+            failed++;
+        }
+        if(image_diff > xout.size() / 100) {
+            std::cout << "\tfixed kernel image departs from its scalar reference" << std::endl;
+            failed++;
+        }
+        // within 1/32 px of float, so at most one entry in 16 may move
+        if(flt.coord > 1 || flt.depth > 1 || flt.entries > flut.size() / 16) {
+            std::cout << "\tfixed kernel departs from the float kernel" << std::endl;
+            failed++;
+        }
+    }
+
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? 1 : 0;
+}
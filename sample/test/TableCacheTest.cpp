@@ -0,0 +1,255 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+#include "TYCoordinateMapper.h"
+#include "TableCache.hpp"
+
+// TableCache rejects damaged files and keys that only share the hash, and
+// concurrent store()s of one table leave a valid table and no temporary
+// files behind.
+
+static const uint32_t PAYLOAD_SIZE = 100000;
+static const int      WRITERS = 4;
+static const int      READERS = 2;
+static const int      STORES = 50;
+
+static std::string make_dir()
+{
+#ifdef _WIN32
+    char base[MAX_PATH];
+    GetTempPathA(MAX_PATH, base);
+    std::string dir = std::string(base) + "ty_table_cache_test_" + std::to_string(GetCurrentProcessId());
+    CreateDirectoryA(dir.c_str(), NULL);
+    return dir;
+#else
+    char dir[] = "/tmp/ty_table_cache_test_XXXXXX";
+    return mkdtemp(dir) ? std::string(dir) : std::string();
+#endif
+}
+
+static std::vector<std::string> list_dir(const std::string& dir)
+{
+    std::vector<std::string> names;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "\\*").c_str(), &data);
+    if(find != INVALID_HANDLE_VALUE) {
+        do {
+            if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(data.cFileName);
+        } while(FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    DIR* d = opendir(dir.c_str());
+    if(d) {
+        while(struct dirent* e = readdir(d)) {
+            if(e->d_name[0] != '.') names.push_back(e->d_name);
+        }
+        closedir(d);
+    }
+#endif
+    return names;
+}
+
+static void remove_dir(const std::string& dir)
+{
+    std::vector<std::string> names = list_dir(dir);
+    for(size_t i = 0; i < names.size(); i++) {
+        remove((dir + "/" + names[i]).c_str());
+    }
+#ifdef _WIN32
+    RemoveDirectoryA(dir.c_str());
+#else
+    rmdir(dir.c_str());
+#endif
+}
+
+static void make_payload(uint32_t seed, std::vector<uint32_t>& payload)
+{
+    payload.resize(PAYLOAD_SIZE / 4);
+    for(size_t i = 0; i < payload.size(); i++) {
+        payload[i] = seed * 2654435761u + (uint32_t)i;
+    }
+}
+
+// payload written by one make_payload() call, whole
+static bool intact(const void* data, size_t size)
+{
+    if(size != PAYLOAD_SIZE) return false;
+    const uint32_t* p = (const uint32_t*)data;
+    for(size_t i = 1; i < size / 4; i++) {
+        if(p[i] != p[0] + (uint32_t)i) return false;
+    }
+    return true;
+}
+
+static bool load_matches(const TableCache& cache, const TableKey& key, const std::vector<uint32_t>& payload)
+{
+    MappedFile file;
+    const void* data = NULL;
+    size_t size = 0;
+    return cache.load(key, file, &data, &size) && size == PAYLOAD_SIZE
+        && memcmp(data, &payload[0], size) == 0;
+}
+
+static bool flip_byte(const std::string& path, long offset)
+{
+    FILE* fp = fopen(path.c_str(), "r+b");
+    if(!fp) return false;
+    bool ok = fseek(fp, offset, offset < 0 ? SEEK_END : SEEK_SET) == 0;
+    int c = ok ? fgetc(fp) : EOF;
+    ok = c != EOF && fseek(fp, -1, SEEK_CUR) == 0 && fputc(c ^ 0x5a, fp) != EOF;
+    return (fclose(fp) == 0) && ok;
+}
+
+// A key of the same kind and hash as other, different bytes. The crc32 of
+// a message of fixed length is affine in its bits, so the last 4 bytes
+// solving for the hash of other are found by elimination over GF(2).
+static TableKey colliding_key(const TableKey& other)
+{
+    struct Key
+    {
+        static TableKey with(uint32_t tail)
+        {
+            TableKey k("collide", 1);
+            k.add(2u).add(tail);
+            return k;
+        }
+    };
+    const uint32_t base = Key::with(0).hash();
+    uint32_t column[32];
+    for(int b = 0; b < 32; b++) {
+        column[b] = Key::with(1u << b).hash() ^ base;
+    }
+    // rows of [column bits | tail bit], reduced to the identity
+    uint32_t target = other.hash() ^ base;
+    uint32_t rows[32][2];
+    for(int r = 0; r < 32; r++) {
+        rows[r][0] = 0;
+        for(int b = 0; b < 32; b++) rows[r][0] |= ((column[b] >> r) & 1u) << b;
+        rows[r][1] = (target >> r) & 1u;
+    }
+    for(int b = 0; b < 32; b++) {
+        int pivot = b;
+        while(pivot < 32 && !((rows[pivot][0] >> b) & 1u)) pivot++;
+        if(pivot == 32) continue;
+        std::swap(rows[b][0], rows[pivot][0]);
+        std::swap(rows[b][1], rows[pivot][1]);
+        for(int r = 0; r < 32; r++) {
+            if(r != b && ((rows[r][0] >> b) & 1u)) {
+                rows[r][0] ^= rows[b][0];
+                rows[r][1] ^= rows[b][1];
+            }
+        }
+    }
+    uint32_t tail = 0;
+    for(int b = 0; b < 32; b++) tail |= rows[b][1] << b;
+    return Key::with(tail);
+}
+
+int main()
+{
+    const std::string dir = make_dir();
+    if(dir.empty()) {
+        std::cout << "can not create the cache directory!" << std::endl;
+        return -1;
+    }
+    TableCache cache(dir);
+    int failed = 0;
+
+    TableKey key("collide", 1);
+    key.add(1u).add(7u);
+    std::vector<uint32_t> payload, other_payload;
+    make_payload(1, payload);
+    make_payload(2, other_payload);
+
+    // damaged payload, then truncated file, are missing tables
+    bool round_trip = cache.store(key, &payload[0], PAYLOAD_SIZE) == TY_STATUS_OK && load_matches(cache, key, payload);
+    bool crc_rejected = flip_byte(cache.path(key), -100) && !load_matches(cache, key, payload);
+    std::vector<uint8_t> head(64);
+    FILE* fp = fopen(cache.path(key).c_str(), "wb");
+    const bool truncated = fp && fwrite(&head[0], 1, head.size(), fp) == head.size() && fclose(fp) == 0;
+    crc_rejected = crc_rejected && truncated && !load_matches(cache, key, payload);
+    round_trip = round_trip && cache.store(key, &payload[0], PAYLOAD_SIZE) == TY_STATUS_OK
+              && load_matches(cache, key, payload);
+    std::cout << "round trip " << (round_trip ? "ok" : "failed") << ", damaged files "
+              << (crc_rejected ? "rejected" : "accepted") << std::endl;
+    if(!round_trip || !crc_rejected) {
+        std::cout << "\ttable cache does not check its files" << std::endl;
+        failed++;
+    }
+
+    // a different key with the same file name must miss, and replace it
+    TableKey twin = colliding_key(key);
+    const bool collides = twin.hash() == key.hash() && cache.path(twin) == cache.path(key)
+                       && twin.bytes() != key.bytes();
+    const bool twin_missed = !load_matches(cache, twin, payload);
+    const bool twin_stored = cache.store(twin, &other_payload[0], PAYLOAD_SIZE) == TY_STATUS_OK
+                          && load_matches(cache, twin, other_payload) && !load_matches(cache, key, other_payload)
+                          && !load_matches(cache, key, payload);
+    std::cout << "hash collision " << std::hex << key.hash() << std::dec << (collides ? " forged" : " not forged")
+              << ", other key " << (twin_missed ? "missed" : "hit") << std::endl;
+    if(!collides || !twin_missed || !twin_stored) {
+        std::cout << "\ttable cache mixes keys of equal hash" << std::endl;
+        failed++;
+    }
+
+    // writers replace the table while readers load it
+    std::atomic<int> store_errors(0), torn(0), hits(0);
+    std::atomic<bool> writing(true);
+    std::vector<std::thread> threads;
+    for(int w = 0; w < WRITERS; w++) {
+        threads.push_back(std::thread([&, w]() {
+            std::vector<uint32_t> data;
+            for(int s = 0; s < STORES; s++) {
+                make_payload(100 + w * STORES + s, data);
+                if(cache.store(key, &data[0], PAYLOAD_SIZE) != TY_STATUS_OK) store_errors++;
+            }
+        }));
+    }
+    for(int r = 0; r < READERS; r++) {
+        threads.push_back(std::thread([&]() {
+            while(writing) {
+                MappedFile file;
+                const void* data = NULL;
+                size_t size = 0;
+                if(cache.load(key, file, &data, &size)) {
+                    hits++;
+                    if(!intact(data, size)) torn++;
+                }
+            }
+        }));
+    }
+    for(int w = 0; w < WRITERS; w++) threads[w].join();
+    writing = false;
+    for(size_t t = WRITERS; t < threads.size(); t++) threads[t].join();
+
+    MappedFile file;
+    const void* data = NULL;
+    size_t size = 0;
+    const bool final_valid = cache.load(key, file, &data, &size) && intact(data, size);
+    file.close();
+    const std::vector<std::string> names = list_dir(dir);
+    std::cout << "concurrent stores: " << store_errors << " errors, " << hits << " loads, " << torn
+              << " torn, " << names.size() << " files left" << std::endl;
+    if(store_errors || torn || !final_valid || names.size() != 1) {
+        std::cout << "\tconcurrent stores corrupt the table" << std::endl;
+        failed++;
+    }
+
+    remove_dir(dir);
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? 1 : 0;
+}
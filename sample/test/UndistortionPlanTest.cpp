@@ -0,0 +1,146 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "TYImageProc.h"
+#include "UndistortionPlan.hpp"
+
+// UndistortionPlan against TYUndistortImage for MONO8, RGB8, MONO16 and
+// DEPTH16, 1 and 4 threads. Bilinear formats may differ by the 1/128
+// weight steps of the plan, DEPTH16 by the choice of the nearest pixel.
+
+static const uint32_t IMAGE_W = 640;
+static const uint32_t IMAGE_H = 480;
+
+static void make_calib(TY_CAMERA_CALIB_INFO& calib)
+{
+    memset(&calib, 0, sizeof(calib));
+    const float k[9] = {1100.f, 0, 650.f, 0, 1100.f, 470.f, 0, 0, 1};
+    const float d[12] = {-0.12f, 0.05f, 0.001f, -0.0005f, 0.01f, 0, 0, 0, 0, 0, 0, 0};
+    calib.intrinsicWidth = 1280;
+    calib.intrinsicHeight = 960;
+    memcpy(calib.intrinsic.data, k, sizeof(k));
+    memcpy(calib.distortion.data, d, sizeof(d));
+}
+
+// smooth 8 and 16 bit images; depth is two ramps, 1 to 3 per pixel, with
+// a step of about 2000 between them
+static void make_image(TY_PIXEL_FORMAT format, std::vector<uint8_t>& image)
+{
+    const int channels = format == TY_PIXEL_FORMAT_RGB ? 3 : 1;
+    const int bytes = TYBitsPerPixel(format) / 8 / channels;
+    image.resize(IMAGE_W * IMAGE_H * channels * bytes);
+    for(uint32_t v = 0; v < IMAGE_H; v++) {
+        for(uint32_t u = 0; u < IMAGE_W; u++) {
+            for(int c = 0; c < channels; c++) {
+                const size_t i = (v * IMAGE_W + u) * channels + c;
+                const double wave = sin(u * 0.05 + c) * cos(v * 0.04);
+                if(bytes == 1) {
+                    image[i] = (uint8_t)(128 + 100 * wave);
+                    continue;
+                }
+                uint16_t value;
+                if(format == TY_PIXEL_FORMAT_DEPTH16) {
+                    value = (uint16_t)(u < IMAGE_W / 2 ? 1000 + u + 2 * v : 3000 + u);
+                } else {
+                    value = (uint16_t)(32768 + 30000 * wave);
+                }
+                memcpy(&image[2 * i], &value, 2);
+            }
+        }
+    }
+}
+
+static int value(const std::vector<uint8_t>& image, size_t i, int bytes)
+{
+    if(bytes == 1) return image[i];
+    uint16_t v;
+    memcpy(&v, &image[2 * i], 2);
+    return v;
+}
+
+struct Case
+{
+    const char*     name;
+    TY_PIXEL_FORMAT format;
+    int             maxDiff;        // any value
+    uint32_t        maxFar;         // values off by more than nearDiff
+    int             nearDiff;
+};
+
+int main()
+{
+    TY_CAMERA_CALIB_INFO calib;
+    make_calib(calib);
+
+    // 16 bit waves change up to 1500 a pixel, 1/128 of it is about 12; depth
+    // may take a neighbour, up to 3 off on the ramps and across the step at
+    // most once a row
+    const Case cases[] = {
+        {"MONO8",   TY_PIXEL_FORMAT_MONO,    1,    0,       1},
+        {"RGB8",    TY_PIXEL_FORMAT_RGB,     1,    0,       1},
+        {"MONO16",  TY_PIXEL_FORMAT_MONO16,  16,   0,       16},
+        {"DEPTH16", TY_PIXEL_FORMAT_DEPTH16, 2100, IMAGE_H, 3},
+    };
+
+    int failed = 0;
+    for(size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        const Case& t = cases[k];
+        const int channels = t.format == TY_PIXEL_FORMAT_RGB ? 3 : 1;
+        const int bytes = TYBitsPerPixel(t.format) / 8 / channels;
+        std::vector<uint8_t> src, expect, got;
+        make_image(t.format, src);
+        expect.resize(src.size());
+
+        TY_IMAGE_DATA src_image, dst_image;
+        memset(&src_image, 0, sizeof(src_image));
+        src_image.width = IMAGE_W;
+        src_image.height = IMAGE_H;
+        src_image.pixelFormat = t.format;
+        src_image.size = (int32_t)src.size();
+        src_image.buffer = &src[0];
+        dst_image = src_image;
+        dst_image.buffer = &expect[0];
+        if(TYUndistortImage(&calib, &src_image, NULL, &dst_image) != TY_STATUS_OK) {
+            std::cout << t.name << ": TYUndistortImage failed" << std::endl;
+            failed++;
+            continue;
+        }
+
+        for(int threads = 1; threads <= 4; threads += 3) {
+            UndistortionPlan plan;
+            plan.setThreadCount(threads);
+            got.assign(src.size(), 0);
+            if(plan.init(&calib, IMAGE_W, IMAGE_H, t.format) != TY_STATUS_OK
+                    || plan.execute(&src[0], &got[0]) != TY_STATUS_OK) {
+                std::cout << t.name << ": plan failed" << std::endl;
+                failed++;
+                continue;
+            }
+
+            int max_diff = 0;
+            uint32_t far = 0, holes = 0;
+            for(size_t i = 0; i < src.size() / bytes; i++) {
+                const int a = value(expect, i, bytes), b = value(got, i, bytes);
+                // 0 is no depth, both must agree on where there is none
+                if((a == 0) != (b == 0) && t.format == TY_PIXEL_FORMAT_DEPTH16) holes++;
+                const int d = abs(a - b);
+                max_diff = std::max(max_diff, d);
+                if(d > t.nearDiff) far++;
+            }
+            std::cout << t.name << ", " << threads << " threads: max difference " << max_diff << ", "
+                      << far << " values off by more than " << t.nearDiff << ", " << holes
+                      << " hole mismatches" << std::endl;
+            if(max_diff > t.maxDiff || far > t.maxFar || holes) {
+                std::cout << "\tundistortion plan departs from TYUndistortImage" << std::endl;
+                failed++;
+            }
+        }
+    }
+
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+
+#include "TYCoordinateMapper.h"
+#include "VoxelGrid.hpp"
+
+// VoxelGrid against a brute force per voxel average, on an organized cloud
+// with holes and on long runs of points in a single voxel, which are split
+// in runs of at most 255 points before the sort.
+
+static const uint32_t CLOUD_W = 640;
+static const uint32_t CLOUD_H = 480;
+
+struct Voxel
+{
+    double   sum[3];
+    uint32_t rgb[3];
+    uint32_t n;
+    uint32_t first;
+};
+
+// same voxel indices as VoxelGrid, keyed in its output order
+static void brute_force(const std::vector<TY_VECT_3F>& points, const std::vector<uint8_t>& rgb,
+                        float leaf, std::map<uint64_t, Voxel>& voxels)
+{
+    float lo[3], hi[3];
+    lo[0] = lo[1] = lo[2] = std::numeric_limits<float>::max();
+    hi[0] = hi[1] = hi[2] = -std::numeric_limits<float>::max();
+    for(size_t i = 0; i < points.size(); i++) {
+        const float* p = &points[i].x;
+        if(p[0] != p[0] || p[1] != p[1] || p[2] != p[2]) continue;
+        for(int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], p[c]);
+            hi[c] = std::max(hi[c], p[c]);
+        }
+    }
+    uint32_t dims[3];
+    for(int c = 0; c < 3; c++) {
+        dims[c] = (uint32_t)((double(hi[c]) - lo[c]) / leaf + 1.0);
+    }
+    const float inv = 1.f / leaf;
+
+    voxels.clear();
+    for(size_t i = 0; i < points.size(); i++) {
+        const float* p = &points[i].x;
+        if(p[0] != p[0] || p[1] != p[1] || p[2] != p[2]) continue;
+        uint32_t idx[3];
+        for(int c = 0; c < 3; c++) {
+            idx[c] = std::min((uint32_t)((p[c] - lo[c]) * inv), dims[c] - 1);
+        }
+        const uint64_t key = ((uint64_t)idx[2] * dims[1] + idx[1]) * dims[0] + idx[0];
+        std::map<uint64_t, Voxel>::iterator it = voxels.find(key);
+        if(it == voxels.end()) {
+            Voxel v;
+            memset(&v, 0, sizeof(v));
+            v.first = (uint32_t)i;
+            it = voxels.insert(std::make_pair(key, v)).first;
+        }
+        Voxel& v = it->second;
+        for(int c = 0; c < 3; c++) {
+            v.sum[c] += p[c];
+            v.rgb[c] += rgb[3 * i + c];
+        }
+        v.n++;
+    }
+}
+
+// wavy wall 1 to 2 m away, with holes
+static void make_organized(std::vector<TY_VECT_3F>& points, std::vector<uint8_t>& rgb)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    points.resize(CLOUD_W * CLOUD_H);
+    rgb.resize(3 * points.size());
+    srand(1);
+    for(uint32_t v = 0; v < CLOUD_H; v++) {
+        for(uint32_t u = 0; u < CLOUD_W; u++) {
+            const size_t i = v * CLOUD_W + u;
+            const float z = 1500.f + 400.f * sinf(u * 0.01f) * cosf(v * 0.02f);
+            points[i].x = (u - 320.f) * z / 525.f;
+            points[i].y = (v - 240.f) * z / 525.f;
+            points[i].z = z;
+            if(rand() % 11 == 0) points[i].x = points[i].y = points[i].z = nan;
+            for(int c = 0; c < 3; c++) rgb[3 * i + c] = (uint8_t)(rand() % 256);
+        }
+    }
+}
+
+// a few voxels, each fed by runs far longer than 255 points, the first
+// one across the task boundary of the key pass
+static void make_runs(std::vector<TY_VECT_3F>& points, std::vector<uint8_t>& rgb)
+{
+    const uint32_t lengths[] = {70000, 256, 255, 1000, 1, 3000};
+    const uint32_t count = sizeof(lengths) / sizeof(lengths[0]);
+    points.clear();
+    rgb.clear();
+    srand(2);
+    for(uint32_t r = 0; r < count; r++) {
+        // voxels 0, 1, 2, 0, 1, 2 so runs of one voxel are sorted together
+        const float base = 100.f * (r % 3);
+        for(uint32_t i = 0; i < lengths[r]; i++) {
+            TY_VECT_3F p;
+            p.x = base + (rand() % 1000) * 0.05f;
+            p.y = (rand() % 1000) * 0.05f;
+            p.z = 1000.f + (rand() % 1000) * 0.05f;
+            points.push_back(p);
+            for(int c = 0; c < 3; c++) rgb.push_back((uint8_t)(rand() % 256));
+        }
+    }
+}
+
+static int check(const char* name, const std::vector<TY_VECT_3F>& points, const std::vector<uint8_t>& rgb,
+                 float leaf, int threads, VoxelGrid::Selection selection)
+{
+    std::map<uint64_t, Voxel> voxels;
+    brute_force(points, rgb, leaf, voxels);
+
+    VoxelGrid grid;
+    grid.setLeafSize(leaf);
+    grid.setThreadCount(threads);
+    grid.setSelection(selection);
+    std::vector<TY_VECT_3F> out(points.size());
+    std::vector<uint8_t> out_rgb(3 * points.size());
+    uint32_t count = 0;
+    if(grid.filter(&points[0], (uint32_t)points.size(), &rgb[0], &out[0], &out_rgb[0], &count) != TY_STATUS_OK) {
+        std::cout << name << ": filter failed" << std::endl;
+        return 1;
+    }
+
+    double max_err = 0.0;
+    uint32_t rgb_diff = 0;
+    uint32_t k = 0;
+    for(std::map<uint64_t, Voxel>::const_iterator it = voxels.begin(); it != voxels.end() && k < count; ++it, k++) {
+        const Voxel& v = it->second;
+        const float* q = &out[k].x;
+        for(int c = 0; c < 3; c++) {
+            const double expect = selection == VoxelGrid::VOXEL_CENTROID ? v.sum[c] / v.n : (&points[v.first].x)[c];
+            max_err = std::max(max_err, fabs(q[c] - expect));
+            if(out_rgb[3 * k + c] != (v.rgb[c] + v.n / 2) / v.n) rgb_diff++;
+        }
+    }
+
+    std::cout << name << ", " << threads << " threads: " << count << " voxels (" << voxels.size()
+              << " expected), max error " << max_err << ", " << rgb_diff << " colors differ" << std::endl;
+    // float sums over offsets from the first point of the voxel
+    if(count != voxels.size() || max_err > 1e-3 * leaf || rgb_diff) {
+        std::cout << "\tvoxel grid departs from the brute force average" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    int failed = 0;
+    std::vector<TY_VECT_3F> points;
+    std::vector<uint8_t> rgb;
+
+    make_organized(points, rgb);
+    for(int threads = 1; threads <= 4; threads += 3) {
+        failed += check("organized centroid", points, rgb, 20.f, threads, VoxelGrid::VOXEL_CENTROID);
+        failed += check("organized first point", points, rgb, 20.f, threads, VoxelGrid::VOXEL_FIRST_POINT);
+    }
+
+    make_runs(points, rgb);
+    for(int threads = 1; threads <= 4; threads += 3) {
+        failed += check("long runs centroid", points, rgb, 64.f, threads, VoxelGrid::VOXEL_CENTROID);
+        failed += check("long runs first point", points, rgb, 64.f, threads, VoxelGrid::VOXEL_FIRST_POINT);
+    }
+
+    std::cout << (failed ? "FAILED" : "PASSED") << std::endl;
+    return failed ? 1 : 0;
+}